@@ -31,7 +31,7 @@ class IAppxBlockMapInternal : public IUnknown
 {
 public:
     virtual std::vector<std::string> GetFileNames() = 0;
-    virtual std::vector<MSIX::Block> GetBlocks(const std::string& fileName) = 0;
+    virtual MSIX::BlockView GetBlocks(const std::string& fileName) = 0;
     virtual MSIX::ComPtr<IAppxBlockMapFile> GetFile(const std::string& fileName) = 0;
 };
 MSIX_INTERFACE(IAppxBlockMapInternal, 0x67fed21a,0x70ef,0x4175,0x8f,0x12,0x41,0x5b,0x21,0x3a,0xb6,0xd2);
@@ -41,28 +41,31 @@ namespace MSIX {
     class AppxBlockMapBlock final : public MSIX::ComClass<AppxBlockMapBlock, IAppxBlockMapBlock>
     {
     public:
-        AppxBlockMapBlock(IMsixFactory* factory, Block* block) :
+        AppxBlockMapBlock(IMsixFactory* factory, const SHA256::Hash* hash, std::uint64_t compressedSize) :
             m_factory(factory),
-            m_block(block)
+            m_hash(hash),
+            m_compressedSize(compressedSize)
         {}
 
         // IAppxBlockMapBlock
         HRESULT STDMETHODCALLTYPE GetHash(UINT32* bufferSize, BYTE** buffer) noexcept override try
         {
-            ThrowHrIfFailed(m_factory->MarshalOutBytes(m_block->hash, bufferSize, buffer));
+            std::vector<std::uint8_t> hash(m_hash->begin(), m_hash->end());
+            ThrowHrIfFailed(m_factory->MarshalOutBytes(hash, bufferSize, buffer));
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
 
         HRESULT STDMETHODCALLTYPE GetCompressedSize(UINT32* size) noexcept override try
         {
             ThrowErrorIf(Error::InvalidParameter, (size == nullptr), "bad pointer");
-            *size = static_cast<UINT32>(m_block->compressedSize);
+            *size = static_cast<UINT32>(m_compressedSize);
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
 
     private:
-        IMsixFactory* m_factory;
-        Block*        m_block;
+        IMsixFactory*       m_factory;
+        const SHA256::Hash* m_hash;
+        std::uint64_t       m_compressedSize;
     };
 
     class AppxBlockMapFile final : public MSIX::ComClass<AppxBlockMapFile, IAppxBlockMapFile, IAppxBlockMapFileUtf8 >
@@ -70,7 +73,7 @@ namespace MSIX {
     public:
         AppxBlockMapFile(
             IMsixFactory* factory,
-            std::vector<Block>* blocks,
+            const BlockView& blocks,
             std::uint32_t localFileHeaderSize,
             const std::string& name,
             std::uint64_t uncompressedSize
@@ -88,15 +91,11 @@ namespace MSIX {
         {
             ThrowErrorIf(Error::InvalidParameter, (blocks == nullptr || *blocks != nullptr), "bad pointer.");
             if (m_blockMapBlocks.empty())
-            {   m_blockMapBlocks.reserve(m_blocks->size());
-                std::transform(
-                    m_blocks->begin(),
-                    m_blocks->end(),
-                    std::back_inserter(m_blockMapBlocks),
-                    [&](auto& item){
-                        return ComPtr<IAppxBlockMapBlock>::Make<AppxBlockMapBlock>(m_factory, &item);
-                    }
-                );
+            {   m_blockMapBlocks.reserve(m_blocks.size());
+                for (std::size_t index = 0; index < m_blocks.size(); index++)
+                {   m_blockMapBlocks.push_back(ComPtr<IAppxBlockMapBlock>::Make<AppxBlockMapBlock>(
+                        m_factory, &m_blocks.Hash(index), m_blocks.CompressedSize(index)));
+                }
             }
             *blocks = ComPtr<IAppxBlockMapBlocksEnumerator>::
                 Make<EnumeratorCom<IAppxBlockMapBlocksEnumerator, IAppxBlockMapBlock>>(m_blockMapBlocks).Detach();
@@ -137,7 +136,7 @@ namespace MSIX {
 
     private:
         std::vector<ComPtr<IAppxBlockMapBlock>> m_blockMapBlocks;
-        std::vector<Block>* m_blocks;
+        BlockView           m_blocks;
         IMsixFactory*       m_factory;
         std::uint32_t       m_localFileHeaderSize;
         std::string         m_name;
@@ -164,14 +163,35 @@ namespace MSIX {
 
         // IAppxBlockMapInternal methods
         std::vector<std::string>        GetFileNames() override;
-        std::vector<Block>              GetBlocks(const std::string& fileName) override;
+        BlockView                       GetBlocks(const std::string& fileName) override;
         MSIX::ComPtr<IAppxBlockMapFile> GetFile(const std::string& fileName) override;
 
         // IAppxBlockMapReaderUtf8
         HRESULT STDMETHODCALLTYPE GetFile(LPCSTR filename, IAppxBlockMapFile **file) noexcept override;
 
     protected:
-        std::map<std::string, std::vector<Block>>        m_blockMap;
+        // Blocks of all files are stored back to back, each file owns a range of these arrays.
+        struct FileBlocks
+        {
+            std::size_t   first;
+            std::size_t   count;
+            std::uint64_t size;
+            std::uint32_t localFileHeaderSize;
+        };
+
+        bool ParseStream(IXmlStreamFactory* xmlStreamFactory, const ComPtr<IStream>& stream);
+        void ParseDom(IXmlFactory* xmlFactory, const ComPtr<IStream>& stream);
+        FileBlocks StartFile(const std::string& name, std::uint64_t size, std::uint32_t localFileHeaderSize);
+        SHA256::Hash& AddBlock(std::uint64_t size);
+        void EndFile(const std::string& name, FileBlocks& file);
+
+        BlockView GetBlockView(const FileBlocks& file) const
+        {   return BlockView(m_hashes.data() + file.first, m_blockSizes.data() + file.first, file.count, file.size);
+        }
+
+        std::vector<SHA256::Hash>                        m_hashes;
+        std::vector<std::uint64_t>                       m_blockSizes; // Size attribute of each block or BlockView::NoSize
+        std::map<std::string, FileBlocks>                m_blockMap;
         std::map<std::string, ComPtr<IAppxBlockMapFile>> m_blockMapFiles;
         IMsixFactory*   m_factory;
         ComPtr<IStream> m_stream;
@@ -6,6 +6,7 @@
 
 #include "XmlWriter.hpp"
 #include "ComHelper.hpp"
+#include "Crypto.hpp"
 
 #include <vector>
 
@@ -20,6 +21,7 @@ namespace MSIX {
 
         void AddFile(const std::string& name, std::uint64_t uncompressedSize, std::uint32_t lfh);
         void AddBlock(const std::vector<std::uint8_t>& block, ULONG size, bool isCompressed);
+        void AddBlock(const SHA256::Hash& hash, ULONG size, bool isCompressed);
         void CloseFile();
         void Close();
         ComPtr<IStream> GetStream() { return m_xmlWriter.GetStream(); }
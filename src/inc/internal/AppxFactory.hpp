@@ -39,7 +39,7 @@ namespace MSIX {
         APPXSIGNATURE_P7X,
     };
 
-    class AppxFactory final : public ComClass<AppxFactory, IMsixFactory, IAppxFactory, IXmlFactory, IAppxBundleFactory, IMsixFactoryOverrides, IAppxFactoryUtf8>
+    class AppxFactory final : public ComClass<AppxFactory, IMsixFactory, IAppxFactory, IXmlFactory, IXmlStreamFactory, IAppxBundleFactory, IMsixFactoryOverrides, IAppxFactoryUtf8>
     {
     public:
         AppxFactory(MSIX_VALIDATION_OPTION validationOptions, MSIX_APPLICABILITY_OPTIONS applicability, COTASKMEMALLOC* memalloc, COTASKMEMFREE* memfree ) : 
@@ -79,6 +79,25 @@ namespace MSIX {
             return m_xmlFactory->CreateDomFromStream(footPrintType, stream);
         }
 
+        // IXmlStreamFactory
+        bool ParseStream(XmlContentType footPrintType, const ComPtr<IStream>& stream, IXmlStreamHandler& handler) override
+        {
+            ComPtr<IXmlStreamFactory> streamFactory;
+            if (FAILED(m_xmlFactory->QueryInterface(UuidOfImpl<IXmlStreamFactory>::iid, reinterpret_cast<void**>(&streamFactory))))
+            {   return false;
+            }
+            return streamFactory->ParseStream(footPrintType, stream, handler);
+        }
+
+        bool ScanStream(XmlContentType footPrintType, const ComPtr<IStream>& stream, IXmlStreamHandler& handler) override
+        {
+            ComPtr<IXmlStreamFactory> streamFactory;
+            if (FAILED(m_xmlFactory->QueryInterface(UuidOfImpl<IXmlStreamFactory>::iid, reinterpret_cast<void**>(&streamFactory))))
+            {   return false;
+            }
+            return streamFactory->ScanStream(footPrintType, stream, handler);
+        }
+
         // IMsixFactoryOverrides
         HRESULT STDMETHODCALLTYPE SpecifyExtension(MSIX_FACTORY_EXTENSION name, IUnknown* extension) noexcept override;
         HRESULT STDMETHODCALLTYPE GetCurrentSpecifiedExtension(MSIX_FACTORY_EXTENSION name, IUnknown** extension) noexcept override;
@@ -299,7 +299,9 @@ namespace MSIX {
         std::string m_packageFamilyName;
     };
 
-    // Object backed by AppxManifest.xml
+    // Object backed by AppxManifest.xml. The values returned by the getters are read from the DOM once, at
+    // construction. With MSIX_VALIDATION_OPTION_RELEASEMANIFESTDOM the DOM is released afterwards and only
+    // parsed again if GetDocumentElement is called.
     class AppxManifestObject final : public ComClass<AppxManifestObject, ChainInterfaces<IAppxManifestReader4, IAppxManifestReader3, IAppxManifestReader2, IAppxManifestReader>,
                                                     IAppxManifestReader5, IVerifierObject, IAppxManifestObject, IMsixDocumentElement>
     {
@@ -345,6 +347,13 @@ namespace MSIX {
         HRESULT STDMETHODCALLTYPE GetDocumentElement(IMsixElement** documentElement) noexcept override;
 
     protected:
+        ComPtr<IXmlDom> CreateDom();
+        void ParseProperties();
+        void ParsePackageDependencies();
+        void ParseResources();
+        void ParseApplications();
+        void ParseMainPackageDependencies();
+        void ParseCapabilities();
         std::vector<std::string> GetCapabilities(APPX_CAPABILITY_CLASS_TYPE capabilityClass);
 
         ComPtr<IMsixFactory> m_factory;
@@ -352,6 +361,15 @@ namespace MSIX {
         ComPtr<IAppxManifestPackageId> m_packageId;
         MSIX_PLATFORMS m_platform = MSIX_PLATFORM_NONE;
         std::vector<ComPtr<IAppxManifestTargetDeviceFamily>> m_tdf;
+        ComPtr<IAppxManifestProperties> m_properties;
+        std::vector<ComPtr<IAppxManifestPackageDependency>> m_packageDependencies;
+        std::vector<std::string> m_resources;
+        std::vector<ComPtr<IAppxManifestApplication>> m_applications;
+        ComPtr<IAppxManifestOptionalPackageInfo> m_optionalPackageInfo;
+        std::vector<ComPtr<IAppxManifestMainPackageDependency>> m_mainPackageDependencies;
+        // General, restricted and windows capabilities in document order
+        std::vector<std::pair<APPX_CAPABILITY_CLASS_TYPE, std::string>> m_capabilities;
+        std::vector<std::string> m_customCapabilities;
         ComPtr<IXmlDom> m_dom;
     };
 }
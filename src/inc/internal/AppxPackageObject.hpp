@@ -25,6 +25,19 @@
 #include "AppxManifestObject.hpp"
 #include "DirectoryObject.hpp"
 
+namespace MSIX {
+    // A payload file or block that didn't match the blockmap, found by IPackage::Verify
+    struct VerificationFailure
+    {
+        std::string     fileName;
+        std::uint32_t   blockIndex; // MSIX_VERIFICATION_FILE when it isn't about a single block
+        HRESULT         error;
+    };
+
+    // Reads the identity of a package or bundle from the start of its manifest, see GetPackageIdentityFromStream.
+    ComPtr<IAppxManifestPackageId> GetPackageIdentity(IMsixFactory* factory, const ComPtr<IStream>& stream);
+}
+
 // internal interface
 // {51b2c456-aaa9-46d6-8ec9-298220559189}
 #ifndef WIN32
@@ -38,6 +51,9 @@ class IPackage : public IUnknown
 public:
     virtual void Unpack(MSIX_PACKUNPACK_OPTION options, const MSIX::ComPtr<IDirectoryObject>& to) = 0;
     virtual std::vector<std::string>& GetFootprintFiles() = 0;
+    virtual void Verify(std::uint32_t threadCount, std::vector<MSIX::VerificationFailure>& failures) = 0;
+    // Null unless the package was read from a zip file.
+    virtual MSIX::ComPtr<IZipReader> GetZipReader() = 0;
 };
 MSIX_INTERFACE(IPackage, 0x51b2c456,0xaaa9,0x46d6,0x8e,0xc9,0x29,0x82,0x20,0x55,0x91,0x89);
 
@@ -108,6 +124,8 @@ namespace MSIX {
         // internal IPackage methods
         void Unpack(MSIX_PACKUNPACK_OPTION options, const ComPtr<IDirectoryObject>& to) override;
         std::vector<std::string>& GetFootprintFiles() override { return m_footprintFiles; }
+        void Verify(std::uint32_t threadCount, std::vector<VerificationFailure>& failures) override;
+        ComPtr<IZipReader> GetZipReader() override { return m_zipReader; }
 
         // IAppxPackageReader
         HRESULT STDMETHODCALLTYPE GetBlockMap(IAppxBlockMapReader** blockMapReader) noexcept override;
@@ -138,6 +156,7 @@ namespace MSIX {
     protected:
         // Helper methods
         void VerifyFile(const ComPtr<IStream>& stream, const std::string& fileName, const ComPtr<IAppxBlockMapInternal>& blockMapInternal);
+        void VerifyBundlePackages(std::uint32_t threadCount, std::vector<VerificationFailure>& failures);
         ComPtr<IAppxFile> GetAppxFile(const std::string& fileName);
 
         std::map<std::string, ComPtr<IAppxFile>> m_files;
@@ -149,6 +168,7 @@ namespace MSIX {
         ComPtr<IVerifierObject>     m_appxManifest;
         ComPtr<IVerifierObject>     m_appxBundleManifest;
         ComPtr<IStorageObject>      m_container;
+        ComPtr<IZipReader>          m_zipReader; // only set when the container is a zip file
         
         std::vector<std::string>    m_payloadFiles;
         std::vector<std::string>    m_footprintFiles;
@@ -8,11 +8,14 @@
 #include "ComHelper.hpp"
 #include "DirectoryObject.hpp"
 #include "AppxBlockMapWriter.hpp"
+#include "BlockMapStream.hpp"
 #include "ContentTypeWriter.hpp"
 #include "ZipObjectWriter.hpp"
+#include "CompressionObjectPool.hpp"
 
 #include <map>
 #include <memory>
+#include <set>
 #include <future>
 
 // internal interface
@@ -26,21 +29,32 @@ class IPackageWriter : public IUnknown
 #endif
 {
 public:
-    // TODO: add options if needed
-    virtual void PackPayloadFiles(const MSIX::ComPtr<IDirectoryObject>& from) = 0;
+    // compressionOption applies to the files that the content type of their extension says to compress.
+    virtual void PackPayloadFiles(const MSIX::ComPtr<IDirectoryObject>& from, APPX_COMPRESSION_OPTION compressionOption) = 0;
+    // When set, payload files added afterwards that would be compressed are stored instead if a sample of
+    // their content barely compresses.
+    virtual void SetStoreIncompressibleFiles(bool store) = 0;
+    // Adds the payload files of a package read from a zip file as they are in it. Their data isn't inflated,
+    // deflated or hashed, the blocks of their File elements come from the blockmap of the package. Files
+    // whose name is in excluded, with either separator and in any case, are left out.
+    virtual void CopyPayloadFiles(const MSIX::ComPtr<IAppxPackageReader>& from, const std::set<std::string>& excluded) = 0;
 };
 MSIX_INTERFACE(IPackageWriter, 0x32e89da5,0x7cbb,0x4443,0x8c,0xf0,0xb8,0x4e,0xed,0xb5,0x1d,0x0a);
 
 namespace MSIX {
+    class BlockCompressionPool;
+
     class AppxPackageWriter final : public ComClass<AppxPackageWriter, IPackageWriter, IAppxPackageWriter,
         IAppxPackageWriterUtf8, IAppxPackageWriter3, IAppxPackageWriter3Utf8>
     {
     public:
         AppxPackageWriter(IMsixFactory* factory, const ComPtr<IZipWriter>& zip);
-        ~AppxPackageWriter() {};
+        ~AppxPackageWriter();
 
         // IPackageWriter
-        void PackPayloadFiles(const ComPtr<IDirectoryObject>& from) override;
+        void PackPayloadFiles(const ComPtr<IDirectoryObject>& from, APPX_COMPRESSION_OPTION compressionOption) override;
+        void SetStoreIncompressibleFiles(bool store) override { m_storeIncompressibleFiles = store; }
+        void CopyPayloadFiles(const ComPtr<IAppxPackageReader>& from, const std::set<std::string>& excluded) override;
 
         // IAppxPackageWriter
         HRESULT STDMETHODCALLTYPE AddPayloadFile(LPCWSTR fileName, LPCWSTR contentType,
@@ -68,19 +82,54 @@ namespace MSIX {
         }
         WriterState;
 
+        struct PayloadFile
+        {
+            std::string             name;
+            ComPtr<IStream>         stream;
+            std::string             contentType;
+            APPX_COMPRESSION_OPTION compressionOpt = APPX_COMPRESSION_OPTION_NONE;
+            std::uint64_t           size = 0;
+        };
+
         void ValidateAndAddPayloadFile(const std::string& name, IStream* stream,
             APPX_COMPRESSION_OPTION compressionOpt, const char* contentType);
 
-        void AddFileToPackage(const std::string& name, IStream* stream, bool toCompress,
+        void ValidatePayloadFile(const std::string& name, APPX_COMPRESSION_OPTION compressionOpt);
+
+        void AddPayloadFilesInParallel(std::vector<PayloadFile>& files, UINT64 memoryLimit);
+
+        void AddFileToPackage(const std::string& name, IStream* stream, APPX_COMPRESSION_OPTION compressionOpt,
             bool addToBlockMap, const char* contentType, bool forceContentTypeOverride = false);
 
+        ComPtr<IStream> StartFile(const std::string& name, std::uint64_t uncompressedSize, APPX_COMPRESSION_OPTION compressionOpt,
+            bool addToBlockMap, const char* contentType, bool forceContentTypeOverride = false);
+        void EndFile(const ComPtr<IStream>& zipFileStream, std::uint32_t crc, std::uint64_t uncompressedSize, bool addToBlockMap);
+
+        void CopyFileToPackage(const std::string& name, IStream* rawStream, std::uint32_t crc, std::uint64_t uncompressedSize,
+            const BlockView& blocks, const char* contentType);
+
+        std::uint32_t AddBlocks(IStream* stream, std::uint64_t size, const ComPtr<IStream>& zipFileStream,
+            APPX_COMPRESSION_OPTION compressionOpt, bool addToBlockMap);
+        std::uint32_t AddBlocksInParallel(IStream* stream, std::uint64_t size, const ComPtr<IStream>& zipFileStream,
+            APPX_COMPRESSION_OPTION compressionOpt, bool addToBlockMap);
+
         void ValidateCompressionOption(APPX_COMPRESSION_OPTION compressionOpt);
+        APPX_COMPRESSION_OPTION SampleCompression(IStream* stream, std::uint64_t size, APPX_COMPRESSION_OPTION compressionOpt);
+
+        std::vector<std::uint8_t> GetBlockBuffer();
+        void RecycleBlockBuffer(std::vector<std::uint8_t>&& buffer);
 
         WriterState m_state;
         ComPtr<IMsixFactory> m_factory;
         ComPtr<IZipWriter> m_zipWriter;
         BlockMapWriter m_blockMapWriter;
         ContentTypeWriter m_contentTypeWriter;
+        bool m_storeIncompressibleFiles = false;
+        CompressionObjectPool m_deflatePool; // shared by DeflateStream and m_compressionPool, which must go first
+        std::unique_ptr<BlockCompressionPool> m_compressionPool; // created for the first file with more than one block
+        std::vector<std::uint8_t> m_readBuffer;     // blocks read for DeflateStream
+        std::vector<std::uint8_t> m_deflateBuffer;  // output of DeflateStream
+        std::vector<std::vector<std::uint8_t>> m_freeBlockBuffers; // blocks read for the pool
     };
 }
 
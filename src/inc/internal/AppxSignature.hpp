@@ -8,6 +8,27 @@
 #include "VerifierObject.hpp"
 #include "StreamBase.hpp"
 #include "AppxFactory.hpp"
+#include "ZipObjectReader.hpp"
+
+// internal interface
+// {e3b6f0d2-5c47-4a8e-b1d9-0a6c2f4e8d31}
+#ifndef WIN32
+interface IZipDigestVerifier : public IUnknown
+#else
+#include "Unknwn.h"
+#include "Objidl.h"
+class IZipDigestVerifier : public IUnknown
+#endif
+// Verifies the digests that cover the zip structure of the package instead of individual parts.
+{
+public:
+    // Verifies the central directory digest (AXCD) and starts computing the file records digest (AXPC)
+    // from the reads done on the package.
+    virtual void ValidateCentralDirectory(const MSIX::ComPtr<IZipReader>& zip) = 0;
+    // Verifies the file records digest once the package has been read. Whatever wasn't read is read now.
+    virtual void ValidateFileRecords(const MSIX::ComPtr<IZipReader>& zip) = 0;
+};
+MSIX_INTERFACE(IZipDigestVerifier, 0xe3b6f0d2,0x5c47,0x4a8e,0xb1,0xd9,0x0a,0x6c,0x2f,0x4e,0x8d,0x31);
 
 namespace MSIX {
 
@@ -57,7 +78,7 @@ namespace MSIX {
     };    
 
     // Object backed by AppxSignature.p7x
-    class AppxSignatureObject final : public ComClass<AppxSignatureObject, IVerifierObject>
+    class AppxSignatureObject final : public ComClass<AppxSignatureObject, IVerifierObject, IZipDigestVerifier>
     {
     public:
 
@@ -69,6 +90,10 @@ namespace MSIX {
         ComPtr<IStream> GetStream() override        { return m_stream; }
         ComPtr<IStream> GetValidationStream(const std::string& part, const ComPtr<IStream>& stream) override;
 
+        // IZipDigestVerifier
+        void ValidateCentralDirectory(const ComPtr<IZipReader>& zip) override;
+        void ValidateFileRecords(const ComPtr<IZipReader>& zip) override;
+
         void ValidateDigestHeader(DigestHeader* header, std::size_t numberOfHashes, std::size_t modHashes);
 
         SignatureOrigin GetSignatureOrigin() { return m_signatureOrigin; }
@@ -23,14 +23,42 @@ namespace MSIX {
   
     const std::uint64_t BLOCKMAP_BLOCK_SIZE = 65536; // 64KB
 
-    typedef struct Block
+    // Read-only view over the blocks of a single file in the blockmap. The hashes and sizes live in
+    // contiguous arrays owned by the blockmap object, which must outlive the view.
+    class BlockView
     {
-        std::uint64_t compressedSize;
-        std::uint64_t blockSize;
-        std::vector<std::uint8_t> hash;
-    } Block;
+    public:
+        // Stored in place of the size of a block that has no Size attribute
+        static constexpr std::uint64_t NoSize = static_cast<std::uint64_t>(-1);
+
+        BlockView() = default;
+        BlockView(const SHA256::Hash* hashes, const std::uint64_t* sizes, std::size_t count, std::uint64_t fileSize) :
+            m_hashes(hashes), m_sizes(sizes), m_count(count), m_fileSize(fileSize)
+        {}
+
+        std::size_t size() const { return m_count; }
+        bool empty() const { return m_count == 0; }
+
+        const SHA256::Hash& Hash(std::size_t index) const { return m_hashes[index]; }
+
+        // Blocks without a Size attribute report the size of the whole file as their compressed size
+        std::uint64_t CompressedSize(std::size_t index) const
+        {   return (m_sizes[index] == NoSize) ? m_fileSize : m_sizes[index];
+        }
+
+        // Blocks without a Size attribute are always BLOCKMAP_BLOCK_SIZE, even the last one
+        std::uint64_t BlockSize(std::size_t index) const
+        {   return (m_sizes[index] == NoSize) ? BLOCKMAP_BLOCK_SIZE : m_sizes[index];
+        }
+
+    protected:
+        const SHA256::Hash*  m_hashes = nullptr;
+        const std::uint64_t* m_sizes = nullptr;
+        std::size_t          m_count = 0;
+        std::uint64_t        m_fileSize = 0;
+    };
 
-    typedef struct BlockPlusStream : Block
+    typedef struct BlockPlusStream
     {
         std::uint64_t   size;
         std::uint64_t   offset;         
@@ -41,7 +69,7 @@ namespace MSIX {
     class BlockMapStream final : public StreamBase
     {
     public:
-        BlockMapStream(IMsixFactory* factory, std::string decodedName, const ComPtr<IStream>& stream, std::vector<Block>& blocks)
+        BlockMapStream(IMsixFactory* factory, std::string decodedName, const ComPtr<IStream>& stream, const BlockView& blocks)
             : m_factory(factory), m_decodedName(decodedName), m_stream(stream)
         {
             // Determine overall stream size
@@ -59,17 +87,16 @@ namespace MSIX {
             // Build a vector of all HashStream->RangeStream's for the blocks in the blockmap
             std::uint64_t offset = 0;
             std::uint64_t sizeRemaining = m_streamSize;
-            for (auto block = blocks.begin(); ((sizeRemaining != 0) && (block != blocks.end())); block++)
+            for (std::size_t index = 0; ((sizeRemaining != 0) && (index < blocks.size())); index++)
             {
                 auto rangeStream = ComPtr<IStream>::Make<RangeStream>(offset, std::min(sizeRemaining, BLOCKMAP_BLOCK_SIZE), stream.Get());                
-                auto hashStream = ComPtr<IStream>::Make<HashStream>(rangeStream, block->hash);
+                auto hashStream = ComPtr<IStream>::Make<HashStream>(rangeStream, blocks.Hash(index));
                 std::uint64_t blockSize = std::min(sizeRemaining, BLOCKMAP_BLOCK_SIZE);
 
                 BlockPlusStream bs;
                 bs.offset = offset;
                 bs.size   = blockSize;
                 bs.stream = hashStream;
-                bs.hash   = block->hash;
                 m_blockStreams.emplace_back(std::move(bs));
                 
                 offset          += blockSize;
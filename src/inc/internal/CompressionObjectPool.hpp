@@ -0,0 +1,45 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+#include "ICompressionObject.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace MSIX {
+
+    // Keeps compression objects whose stream is done so the next stream resets one instead of allocating
+    // and initializing new state. Packages with lots of small files otherwise spend a good part of their
+    // time in inflateInit/deflateInit and their End. Safe to use from multiple threads.
+    class CompressionObjectPool final
+    {
+    public:
+        CompressionObjectPool(CompressionOperation operation, std::size_t capacity);
+        ~CompressionObjectPool();
+
+        // Returns an object ready for a new stream, initialized with level if it wasn't in the pool.
+        std::unique_ptr<ICompressionObject> Acquire(int level = DefaultCompressionLevel);
+
+        // Gives back an object acquired with level. It is cleaned up if the pool is full.
+        void Release(std::unique_ptr<ICompressionObject>&& object, int level = DefaultCompressionLevel);
+
+        // Shared by all the InflateStreams of the process.
+        static CompressionObjectPool& Inflate();
+
+    protected:
+        struct Entry
+        {
+            int                                 level;
+            std::unique_ptr<ICompressionObject> object;
+        };
+
+        CompressionOperation m_operation;
+        std::size_t          m_capacity;
+        std::mutex           m_mutex;
+        std::vector<Entry>   m_objects;
+    };
+}
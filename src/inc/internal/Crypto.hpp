@@ -4,6 +4,11 @@
 // 
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace MSIX {
@@ -11,12 +16,32 @@ namespace MSIX {
     class SHA256
     {
     public:
+        static constexpr std::size_t HashSize = 32;
+        using Hash = std::array<std::uint8_t, HashSize>;
+
         static bool ComputeHash(std::uint8_t *buffer, std::uint32_t cbBuffer, std::vector<uint8_t>& hash);
+
+        // Uses the CPU's SHA-256 instructions when available, otherwise the platform's crypto library.
+        static void ComputeHash(const std::uint8_t* buffer, std::size_t cbBuffer, Hash& hash);
+
+        // Hashes count independent buffers, e.g. the blocks of a file, into hashes[0..count).
+        static void ComputeHashes(const std::uint8_t* const* buffers, const std::size_t* cbBuffers, Hash* hashes, std::size_t count);
+
+        // Incremental hashing, for data that is not available in a single buffer.
+        SHA256();
+        ~SHA256();
+        void Add(const std::uint8_t* buffer, std::size_t cbBuffer);
+        void Get(std::vector<std::uint8_t>& hash);
+
+    protected:
+        struct Context;
+        std::unique_ptr<Context> m_context;
     };
 
     class Base64
     {
     public:
-        static std::string ComputeBase64(const std::vector<std::uint8_t>& buffer);
+        static std::string ComputeBase64(const std::uint8_t* buffer, std::size_t size);
+        static std::string ComputeBase64(const std::vector<std::uint8_t>& buffer) { return ComputeBase64(buffer.data(), buffer.size()); }
     };
 }
\ No newline at end of file
@@ -6,16 +6,24 @@
 
 #include "ComHelper.hpp"
 #include "StreamBase.hpp"
+#include "CompressionObjectPool.hpp"
 
+#include <memory>
 #include <vector>
-#include <zlib.h>
 
 namespace MSIX {
 
+    // Returns the zlib level used for the given compression option, APPX_COMPRESSION_OPTION_NONE is not valid.
+    int GetDeflateLevel(APPX_COMPRESSION_OPTION compressionOption);
+
     class DeflateStream final : public StreamBase
     {
     public:
-        DeflateStream(const ComPtr<IStream>& stream);
+        // The deflate state comes from pool and goes back to it when the stream is destroyed. buffer is where the
+        // compressed data goes before it is written to stream. Both belong to the caller, so they can be reused
+        // for many streams, and must outlive this stream.
+        DeflateStream(const ComPtr<IStream>& stream, APPX_COMPRESSION_OPTION compressionOption,
+            CompressionObjectPool& pool, std::vector<std::uint8_t>& buffer);
         ~DeflateStream();
 
         // IStream
@@ -29,7 +37,7 @@ namespace MSIX {
         std::string GetName() override { return m_stream.As<IStreamInternal>()->GetName(); }
     
     protected:
-        std::vector<std::uint8_t> Deflate(int disposition);
+        ULONG Deflate(CompressionFlush flush);
 
         typedef enum
         {
@@ -39,7 +47,10 @@ namespace MSIX {
         State;
 
         State m_state = State::Open;
-        z_stream m_zstrm;
         ComPtr<IStream> m_stream;
+        CompressionObjectPool& m_pool;
+        int m_level;
+        std::unique_ptr<ICompressionObject> m_compressionObject;
+        std::vector<std::uint8_t>& m_buffer;
     };
 }
@@ -4,7 +4,10 @@
 //
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace MSIX { namespace Encoding {
 
@@ -14,4 +17,9 @@ namespace MSIX { namespace Encoding {
     std::string Base32Encoding(const std::vector<uint8_t>& bytes);
     std::vector<std::uint8_t> GetBase64DecodedValue(const std::string& value);
 
+    // Decodes into exactly size bytes at out, vectorized where the CPU allows it. Throws if value isn't
+    // the base64 encoding of size bytes.
+    void GetBase64DecodedValue(const char* value, std::size_t length, std::uint8_t* out, std::size_t size);
+    std::string GetBase64EncodedValue(const std::uint8_t* data, std::size_t size);
+
 } /*Encoding */ } /* MSIX */
@@ -23,16 +23,27 @@ namespace MSIX {
     protected:
         bool m_validated;
         ComPtr<IStream> m_stream;
-        std::vector<std::uint8_t>& m_expectedHash;
+        const std::uint8_t* m_expectedHash;
+        std::size_t m_expectedHashSize;
         std::unique_ptr<std::vector<std::uint8_t>> m_cacheBuffer;
         std::uint64_t m_relativePosition;
         size_t m_streamSize;
 
     public:
-        HashStream(const ComPtr<IStream>& stream, std::vector<std::uint8_t>& expectedHash) :
+        // The expected hash is not copied and must outlive the stream.
+        HashStream(const ComPtr<IStream>& stream, const SHA256::Hash& expectedHash) :
+            HashStream(stream, expectedHash.data(), expectedHash.size())
+        {}
+
+        HashStream(const ComPtr<IStream>& stream, const std::vector<std::uint8_t>& expectedHash) :
+            HashStream(stream, expectedHash.data(), expectedHash.size())
+        {}
+
+        HashStream(const ComPtr<IStream>& stream, const std::uint8_t* expectedHash, std::size_t expectedHashSize) :
             m_validated(false),
             m_stream(stream),
             m_expectedHash(expectedHash),
+            m_expectedHashSize(expectedHashSize),
             m_relativePosition(0),
             m_streamSize(0)
         {
@@ -56,14 +67,12 @@ namespace MSIX {
             ThrowErrorIfNot(MSIX::Error::SignatureInvalid, bytesRead == m_streamSize, "read failed");
 
             // compute digest and compare against expected digest
-            std::vector<std::uint8_t> hash;
-            ThrowErrorIfNot(MSIX::Error::SignatureInvalid, 
-                MSIX::SHA256::ComputeHash(m_cacheBuffer->data(), static_cast<uint32_t>(m_cacheBuffer->size()), hash), 
-                "Invalid signature");
-            ThrowErrorIfNot(MSIX::Error::SignatureInvalid, m_expectedHash.size() == hash.size(), "Signature is corrupt");
+            MSIX::SHA256::Hash hash;
+            MSIX::SHA256::ComputeHash(m_cacheBuffer->data(), m_cacheBuffer->size(), hash);
+            ThrowErrorIfNot(MSIX::Error::SignatureInvalid, m_expectedHashSize == hash.size(), "Signature is corrupt");
             ThrowErrorIfNot(
                 MSIX::Error::SignatureInvalid,
-                memcmp(m_expectedHash.data(), hash.data(), hash.size()) == 0,
+                memcmp(m_expectedHash, hash.data(), hash.size()) == 0,
                 "Signature hash doesn't match digest hash"); //TODO: better exception
 
             m_validated = true;
@@ -23,12 +23,27 @@ namespace MSIX {
         NeedDictionary
     };
 
+    enum class CompressionFlush
+    {
+        Full,   // everything so far is written out and the output starts over on a byte boundary
+        Finish  // last input of the stream
+    };
+
+    // Level used when the operation doesn't take one or the caller doesn't care.
+    static const int DefaultCompressionLevel = -1;
+
     class ICompressionObject
     {
         public:
-            virtual CompressionStatus Initialize(CompressionOperation operation) = 0;
+            // level only applies to Deflate.
+            virtual CompressionStatus Initialize(CompressionOperation operation, int level = DefaultCompressionLevel) = 0;
             virtual CompressionStatus Inflate() = 0;
+            virtual CompressionStatus Deflate(CompressionFlush flush) = 0;
+            // Starts a new stream with the same operation and level without freeing the state.
+            virtual CompressionStatus Reset() = 0;
             virtual CompressionStatus Cleanup() = 0;
+            // Upper bound of the output of deflating sourceSize bytes at once.
+            virtual std::size_t GetDeflateBound(std::size_t sourceSize) = 0;
             virtual std::size_t GetAvailableSourceSize() = 0;
             virtual std::size_t GetAvailableDestinationSize() = 0;
             virtual void SetInput(std::uint8_t* buffer, std::size_t size) = 0;
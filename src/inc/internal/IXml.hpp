@@ -91,7 +91,8 @@ class IXmlElement : public IUnknown
 {
 public:
     virtual std::string               GetAttributeValue(XmlAttributeName attribute) = 0;
-    virtual std::vector<std::uint8_t> GetBase64DecodedAttributeValue(XmlAttributeName attribute) = 0;
+    // Decodes the attribute into exactly size bytes at value
+    virtual void                      GetBase64DecodedAttributeValue(XmlAttributeName attribute, std::uint8_t* value, std::size_t size) = 0;
     virtual std::string               GetText() = 0;
     virtual std::string               GetPrefix() = 0;
 };
@@ -178,6 +179,28 @@ public:
 };
 MSIX_INTERFACE(IXmlDom, 0x0e7a446e,0xbaf7,0x44c1,0xb3,0x8a,0x21,0x6b,0xfa,0x18,0xa1,0xa8);
 
+// Receives the child elements of an element in document order, see IXmlDomWalker.
+class IXmlChildHandler
+{
+public:
+    // Returns false to stop visiting the remaining children
+    virtual bool Child(const std::string& localName, const MSIX::ComPtr<IXmlElement>& element) = 0;
+};
+
+// {3c8e5d71-2f4a-4b96-a1d3-6e0b9f27c5a4}
+#ifndef WIN32
+interface IXmlDomWalker : public IUnknown
+#else
+class IXmlDomWalker : public IUnknown
+#endif
+// An internal interface for walking a document object model without XPath queries. Implemented by the
+// XML implementations that validate, so manifest semantic validation can be done in a single pass.
+{
+public:
+    virtual bool ForEachChildElement(const MSIX::ComPtr<IXmlElement>& parent, IXmlChildHandler& handler) = 0;
+};
+MSIX_INTERFACE(IXmlDomWalker, 0x3c8e5d71,0x2f4a,0x4b96,0xa1,0xd3,0x6e,0x0b,0x9f,0x27,0xc5,0xa4);
+
 // {f82a60ec-fbfc-4cb9-bc04-1a0fe2b4d5be}
 #ifndef WIN32
 interface IXmlFactory : public IUnknown
@@ -191,6 +214,42 @@ public:
 };
 MSIX_INTERFACE(IXmlFactory, 0xf82a60ec,0xfbfc,0x4cb9,0xbc,0x04,0x1a,0x0f,0xe2,0xb4,0xd5,0xbe);
 
+// An element seen while parsing a document as a stream. Only valid for the duration of the callback.
+class IXmlStreamElement
+{
+public:
+    virtual bool                      HasLocalName(const char* localName) = 0;
+    virtual std::string               GetAttributeValue(XmlAttributeName attribute) = 0;
+    // Decodes the attribute into exactly size bytes at value
+    virtual void                      GetBase64DecodedAttributeValue(XmlAttributeName attribute, std::uint8_t* value, std::size_t size) = 0;
+};
+
+// Receives the elements of a document in document order. depth is 0 for the root element.
+class IXmlStreamHandler
+{
+public:
+    // Returns false to stop parsing, the rest of the document is then neither read nor checked
+    virtual bool StartElement(std::size_t depth, IXmlStreamElement& element) = 0;
+    virtual void EndElement(std::size_t depth) = 0;
+};
+
+// {5b1f3e0c-7a9d-4c61-9e2a-3f8d6c4b1a07}
+#ifndef WIN32
+interface IXmlStreamFactory : public IUnknown
+#else
+class IXmlStreamFactory : public IUnknown
+#endif
+// An internal interface for parsing (and validating) documents without building a DOM. Optional, XML
+// implementations that don't support it are only used through IXmlFactory.
+{
+public:
+    // Returns false if the XML implementation can't parse documents as a stream
+    virtual bool ParseStream(XmlContentType footPrintType, const MSIX::ComPtr<IStream>& stream, IXmlStreamHandler& handler) = 0;
+    // Same as ParseStream, but without schema validation. Only reads as much of the stream as the handler needs.
+    virtual bool ScanStream(XmlContentType footPrintType, const MSIX::ComPtr<IStream>& stream, IXmlStreamHandler& handler) = 0;
+};
+MSIX_INTERFACE(IXmlStreamFactory, 0x5b1f3e0c,0x7a9d,0x4c61,0x9e,0x2a,0x3f,0x8d,0x6c,0x4b,0x1a,0x07);
+
 namespace MSIX {
     MSIX::ComPtr<IXmlFactory> CreateXmlFactory(IMsixFactory* factory);
 
@@ -222,9 +281,8 @@ namespace MSIX {
     };
 
     template <class T>
-    static T GetNumber(const ComPtr<IXmlElement>& element, XmlAttributeName attribute, T defaultValue)
+    static T GetNumber(const std::string& attributeValue, T defaultValue)
     {
-        const auto& attributeValue = element->GetAttributeValue(attribute);
         bool hasValue = !attributeValue.empty();
         T value = defaultValue;
         if (hasValue)
@@ -249,6 +307,18 @@ namespace MSIX {
         return value;
     }
 
+    template <class T>
+    static T GetNumber(const ComPtr<IXmlElement>& element, XmlAttributeName attribute, T defaultValue)
+    {
+        return GetNumber<T>(element->GetAttributeValue(attribute), defaultValue);
+    }
+
+    template <class T>
+    static T GetNumber(IXmlStreamElement& element, XmlAttributeName attribute, T defaultValue)
+    {
+        return GetNumber<T>(element.GetAttributeValue(attribute), defaultValue);
+    }
+
 #ifdef USING_MSXML
     using XmlQueryNameCharType = wchar_t;
 #else
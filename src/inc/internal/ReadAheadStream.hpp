@@ -0,0 +1,74 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+#include "ComHelper.hpp"
+#include "Crypto.hpp"
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace MSIX {
+
+    // Read-only decorator over the raw package stream. The zip headers and the RangeStreams
+    // created for each file issue many small reads; this coalesces them into page-sized reads
+    // to the underlying stream, keeps the most recently used pages around and grows the
+    // amount read ahead while the access pattern stays sequential.
+    class ReadAheadStream final : public StreamBase
+    {
+    public:
+        ReadAheadStream(const ComPtr<IStream>& stream);
+
+        HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER *newPosition) noexcept override;
+        HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept override;
+
+        // IStreamInternal
+        std::uint64_t GetSize() override { return m_size; }
+        bool IsCompressed() override { return m_stream.As<IStreamInternal>()->IsCompressed(); }
+        std::string GetName() override { return m_stream.As<IStreamInternal>()->GetName(); }
+
+        // Hashes the first length bytes of the stream as they are read from the underlying stream, so a digest
+        // over most of the package doesn't require reading it twice. Data that comes in ahead of the digest is
+        // held until the digest gets to it. GetPrefixDigest only reads the parts that were never read and
+        // returns the SHA256.
+        void StartPrefixDigest(std::uint64_t length);
+        std::vector<std::uint8_t> GetPrefixDigest();
+
+        static constexpr std::uint32_t PageSize = 64*1024;  // Size of each cached page
+        static constexpr size_t MaxPages = 16;              // Pages kept in the cache
+        static constexpr size_t MaxReadAheadPages = 8;      // Upper bound of pages read on a sequential miss
+        static constexpr size_t MaxPendingDigest = 64*1024*1024; // Upper bound of data held for the digest
+
+    protected:
+        struct Page
+        {
+            std::uint64_t index;
+            std::vector<std::uint8_t> data;
+        };
+
+        const Page* FindPage(std::uint64_t index);
+        const Page* FillPages(std::uint64_t index);
+        ULONG ReadFromSource(std::uint64_t position, void* buffer, ULONG countBytes);
+        void UpdatePrefixDigest(std::uint64_t position, const std::uint8_t* data, std::uint64_t count);
+        void AddToPrefixDigest(std::uint64_t position, const std::uint8_t* data, std::uint64_t count);
+
+        ComPtr<IStream> m_stream;
+        std::uint64_t   m_size = 0;
+        std::uint64_t   m_position = 0;
+        std::uint64_t   m_lastReadEnd = 0;
+        size_t          m_readAheadPages = 1;
+        std::list<Page> m_pages; // most recently used first
+
+        std::unique_ptr<SHA256> m_prefixDigest;
+        std::uint64_t   m_prefixDigestLength = 0;
+        std::uint64_t   m_prefixDigestPosition = 0; // everything before this is already hashed
+        std::map<std::uint64_t, std::vector<std::uint8_t>> m_pendingDigest; // read ahead of the digest, by offset
+        std::size_t     m_pendingDigestSize = 0;
+    };
+}
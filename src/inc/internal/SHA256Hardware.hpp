@@ -0,0 +1,21 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include "Crypto.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MSIX { namespace SHA256Hardware {
+
+    // True when the SDK was built with, and the CPU has, the SHA-256 instructions (x86 SHA extensions
+    // or ARMv8 crypto extensions). The crypto PALs check this before falling back to their library.
+    bool IsSupported();
+
+    // Hashes count independent buffers. Buffers are processed in pairs so the rounds of one hide the
+    // latency of the other. Only valid when IsSupported() is true.
+    void ComputeHashes(const std::uint8_t* const* buffers, const std::size_t* sizes, SHA256::Hash* hashes, std::size_t count);
+} }
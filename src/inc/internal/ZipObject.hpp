@@ -177,6 +177,8 @@ namespace MSIX {
 
         CompressionType GetCompressionMethod() const noexcept { return static_cast<CompressionType>(Field<4>().get()); }
 
+        std::uint32_t GetCrc() const noexcept { return Field<7>(); }
+
         std::uint64_t GetCompressedSize() const noexcept
         {
             if (IsValueInExtendedInfo(Field<8>()))
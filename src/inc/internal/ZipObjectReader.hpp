@@ -7,14 +7,42 @@
 #include "Exceptions.hpp"
 #include "ComHelper.hpp"
 #include "ZipObject.hpp"
+#include "ReadAheadStream.hpp"
 
 #include <vector>
 #include <map>
 #include <memory>
 
+// {c9e8d4a7-3b1f-4e62-9a0d-7f5b2c18e643}
+#ifndef WIN32
+interface IZipReader : public IUnknown
+#else
+#include "Unknwn.h"
+#include "Objidl.h"
+class IZipReader : public IUnknown
+#endif
+{
+public:
+    // Returns the SHA256 of the central directory and end of central directory records as they
+    // would be if the file was not in the archive. This is the AXCD digest of a signed package.
+    virtual std::vector<std::uint8_t> GetCentralDirectoryDigest(const std::string& excludedFile) = 0;
+
+    // Starts hashing the file records that precede the local header of lastFile while the
+    // archive is being read. This is the AXPC digest of a signed package.
+    virtual void StartFileRecordsDigest(const std::string& lastFile) = 0;
+
+    // Returns the SHA256 started by StartFileRecordsDigest, reading any part that wasn't read yet.
+    virtual std::vector<std::uint8_t> GetFileRecordsDigest() = 0;
+
+    // Returns a stream over the data of the file as it is in the archive, without inflating it, along with the
+    // crc and uncompressed size of its central directory record. Null if the file isn't in the archive.
+    virtual MSIX::ComPtr<IStream> GetRawFile(const std::string& fileName, std::uint32_t& crc, std::uint64_t& uncompressedSize) = 0;
+};
+MSIX_INTERFACE(IZipReader, 0xc9e8d4a7,0x3b1f,0x4e62,0x9a,0x0d,0x7f,0x5b,0x2c,0x18,0xe6,0x43);
+
 namespace MSIX {
     // This represents a raw stream over a.zip file.
-    class ZipObjectReader final : public ComClass<ZipObjectReader, IStorageObject>, ZipObject
+    class ZipObjectReader final : public ComClass<ZipObjectReader, IStorageObject, IZipReader>, ZipObject
     {
     public:
         ZipObjectReader(const ComPtr<IStream>& stream);
@@ -24,7 +52,18 @@ namespace MSIX {
         ComPtr<IStream> GetFile(const std::string& fileName) override;
         std::string GetFileName() override;
 
+        // IZipReader
+        std::vector<std::uint8_t> GetCentralDirectoryDigest(const std::string& excludedFile) override;
+        void StartFileRecordsDigest(const std::string& lastFile) override;
+        std::vector<std::uint8_t> GetFileRecordsDigest() override;
+        ComPtr<IStream> GetRawFile(const std::string& fileName, std::uint32_t& crc, std::uint64_t& uncompressedSize) override;
+
     protected:
+        ComPtr<IStream> MakeZipFileStream(const std::string& name, CentralDirectoryFileHeader& centralFileHeader);
+
         std::map<std::string, ComPtr<IStream>> m_streams;
+        ReadAheadStream* m_readAheadStream; // owned by m_stream
+        std::uint64_t m_offsetStartOfCD = 0;
+        std::uint64_t m_totalNumberOfEntries = 0;
     };
 }
@@ -24,8 +24,10 @@ class IZipWriter : public IUnknown
 #endif
 {
 public:
-    // Writes the lfh header to the stream and return the size of the header
-    virtual std::pair<std::uint32_t, MSIX::ComPtr<IStream>> PrepareToAddFile(const std::string& name, bool isCompressed) = 0;
+    // Writes the lfh header to the stream and return the size of the header and the stream for the file
+    // data. Unless compressionOption is APPX_COMPRESSION_OPTION_NONE the caller is responsible for writing
+    // data deflated with the level for that option to it.
+    virtual std::pair<std::uint32_t, MSIX::ComPtr<IStream>> PrepareToAddFile(const std::string& name, APPX_COMPRESSION_OPTION compressionOption) = 0;
 
     // Ends the file, rewrites the LFH or writes data descriptor and adds an entry
     // to the central directories map
@@ -52,7 +54,7 @@ namespace MSIX {
         std::string GetFileName() override { NOTIMPLEMENTED };
 
         // IZipWriter
-        std::pair<std::uint32_t, ComPtr<IStream>> PrepareToAddFile(const std::string& name, bool isCompressed) override;
+        std::pair<std::uint32_t, ComPtr<IStream>> PrepareToAddFile(const std::string& name, APPX_COMPRESSION_OPTION compressionOption) override;
         void EndFile(std::uint32_t crc, std::uint64_t compressedSize, std::uint64_t uncompressedSize, bool forceDataDescriptor) override;
         void Close() override;
 
@@ -1632,6 +1632,13 @@ enum MSIX_VALIDATION_OPTION
                                                                   // If the SDK is compiled without USE_VALIDATION_PARSER,
                                                                   // no schema validation is done, but it needs to be
                                                                   // valid xml.
+        MSIX_VALIDATION_OPTION_CACHECERTIFICATECHAIN       = 0x8, // Remember certificate chains that verified successfully
+                                                                  // for the rest of the process, until the first certificate
+                                                                  // in the chain expires. Meant for validating many packages
+                                                                  // from a few publishers.
+        MSIX_VALIDATION_OPTION_RELEASEMANIFESTDOM          = 0x10, // Release the AppxManifest.xml DOM once the manifest reader
+                                                                   // has read its values. IMsixDocumentElement::GetDocumentElement
+                                                                   // parses the manifest again if called afterwards.
     }   MSIX_VALIDATION_OPTION;
 
 typedef /* [v1_enum] */
@@ -1639,7 +1646,10 @@ enum MSIX_PACKUNPACK_OPTION
     {
         MSIX_PACKUNPACK_OPTION_NONE                    = 0x0,
         MSIX_PACKUNPACK_OPTION_CREATEPACKAGESUBFOLDER  = 0x1,
-        MSIX_PACKUNPACK_OPTION_UNPACKWITHFLATSTRUCTURE = 0x2
+        MSIX_PACKUNPACK_OPTION_UNPACKWITHFLATSTRUCTURE = 0x2,
+        MSIX_PACKUNPACK_OPTION_STOREINCOMPRESSIBLEFILES = 0x4  // Pack only. Files that would be compressed are stored
+                                                               // if a sample of their content barely compresses, e.g.
+                                                               // already compressed assets with custom extensions.
     }   MSIX_PACKUNPACK_OPTION;
 
 typedef /* [v1_enum] */
@@ -1731,6 +1741,30 @@ MSIX_API HRESULT STDMETHODCALLTYPE PackPackage(
     char* outputPackage
 ) noexcept;
 
+// Same as PackPackage, which uses APPX_COMPRESSION_OPTION_NORMAL. compressionOption is used for the files
+// that are compressed based on their extension, APPX_COMPRESSION_OPTION_NONE stores every file.
+MSIX_API HRESULT STDMETHODCALLTYPE PackPackageWithCompression(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    MSIX_VALIDATION_OPTION validationOption,
+    APPX_COMPRESSION_OPTION compressionOption,
+    char* directoryPath,
+    char* outputPackage
+) noexcept;
+
+// Creates outputPackage from the payload files of sourcePackage without inflating or deflating them, so changing
+// the manifest or a few files doesn't cost a full pack. Files in directoryPath, which can be null, are packed in
+// place of the ones with the same name and its AppxManifest.xml, if any, replaces the manifest of sourcePackage.
+// The files in removedFiles are left out. The output package isn't signed.
+MSIX_API HRESULT STDMETHODCALLTYPE RepackPackage(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    MSIX_VALIDATION_OPTION validationOption,
+    char* sourcePackage,
+    char* directoryPath,
+    UINT32 removedFileCount,
+    char** removedFiles,
+    char* outputPackage
+) noexcept;
+
 #endif // MSIX_PACK
 
 // A call to called CoCreateAppxFactory is required before start using the factory on non-windows platforms specifying
@@ -1740,6 +1774,84 @@ typedef void STDMETHODCALLTYPE COTASKMEMFREE(LPVOID pv);
 
 MSIX_API HRESULT STDMETHODCALLTYPE GetLogTextUTF8(COTASKMEMALLOC* memalloc, char** logText) noexcept;
 
+// Verify
+// Checks a package or bundle like unpacking it would, without writing anything to disk: signature, [Content_Types].xml,
+// AppxBlockMap.xml and the hash of every block of every payload file. Blocks are hashed on threadCount threads (0 uses one
+// per processor). Files and blocks that don't match are returned in failures as a single allocation from memalloc that
+// the caller frees. The result is the error of the first failure, or the error that prevented opening the package, in
+// which case there are no failures.
+#define MSIX_VERIFICATION_FILE 0xFFFFFFFF
+
+typedef struct MSIX_VERIFICATION_FAILURE
+{
+    char*   fileName;   // For bundles the name is prefixed by the package that contains the file.
+    UINT32  blockIndex; // MSIX_VERIFICATION_FILE if the failure applies to the whole file
+    HRESULT error;
+}   MSIX_VERIFICATION_FAILURE;
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyPackage(
+    MSIX_VALIDATION_OPTION validationOption,
+    char* utf8SourcePackage,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount
+) noexcept;
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyPackageFromPackageReader(
+    IAppxPackageReader* packageReader,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount
+) noexcept;
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyPackageFromStream(
+    MSIX_VALIDATION_OPTION validationOption,
+    IStream* stream,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount
+) noexcept;
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyBundle(
+    MSIX_VALIDATION_OPTION validationOption,
+    char* utf8SourcePackage,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount
+) noexcept;
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyBundleFromBundleReader(
+    IAppxBundleReader* bundleReader,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount
+) noexcept;
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyBundleFromStream(
+    MSIX_VALIDATION_OPTION validationOption,
+    IStream* stream,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount
+) noexcept;
+
+// GetPackageIdentityFromStream
+// Reads the identity of a package, or of a bundle, from AppxManifest.xml or AppxBundleManifest.xml without reading anything
+// else from the package. The manifest is parsed up to the Identity element and isn't validated against its schema, and
+// neither the signature nor AppxBlockMap.xml are looked at, so the identity is not to be trusted. packageId uses factory
+// to allocate the strings it returns and must not outlive it.
+MSIX_API HRESULT STDMETHODCALLTYPE GetPackageIdentityFromStream(
+    IAppxFactory* factory,
+    IStream* stream,
+    IAppxManifestPackageId** packageId
+) noexcept;
+
 // Call specific for Windows. Default to call CoTaskMemAlloc and CoTaskMemFree
 MSIX_API HRESULT STDMETHODCALLTYPE CoCreateAppxFactory(
     MSIX_VALIDATION_OPTION validationOption,
@@ -13,6 +13,7 @@
 #include <algorithm>
 #include <functional>
 #include <sstream>
+#include <map>
 
 #define TOOL_HELP_COMMAND_STRING "-?"
 
@@ -30,6 +31,12 @@ struct Option
         Name(std::move(name)), Required(required), ParameterCount(parameterCount), Help(std::move(help)), ParameterName(std::move(parameterName))
     {}
 
+    // Constructor for options whose parameters must be one of allowedValues.
+    Option(std::string name, std::string help, bool required, size_t parameterCount, std::string parameterName, std::vector<std::string> allowedValues) :
+        Name(std::move(name)), Required(required), ParameterCount(parameterCount), Help(std::move(help)), ParameterName(std::move(parameterName)),
+        AllowedValues(std::move(allowedValues))
+    {}
+
     bool operator==(const std::string& rhs) const {
         return Name == rhs;
     }
@@ -39,6 +46,7 @@ struct Option
     bool        Required;
     size_t      ParameterCount;
     std::string ParameterName;
+    std::vector<std::string> AllowedValues; // empty when any value is accepted
 };
 
 // Describes a command that the user may specify.
@@ -131,6 +139,15 @@ struct Invocation
                     error += optionString;
                     return false;
                 }
+                if (!option->AllowedValues.empty() &&
+                    std::find(option->AllowedValues.begin(), option->AllowedValues.end(), argv[index]) == option->AllowedValues.end())
+                {
+                    error = "Invalid value for option ";
+                    error += optionString;
+                    error += ": ";
+                    error += argv[index];
+                    return false;
+                }
                 params.emplace_back(argv[index]);
             }
 
@@ -212,6 +229,20 @@ struct Invocation
         return opt->params[0];
     }
 
+    // For options that can be given more than once, in the order they were given.
+    std::vector<std::string> GetOptionValues(const std::string& name) const
+    {
+        std::vector<std::string> values;
+        for (const auto& opt : options)
+        {
+            if (opt == name)
+            {
+                values.insert(values.end(), opt.params.begin(), opt.params.end());
+            }
+        }
+        return values;
+    }
+
 private:
     mutable std::string error;
     std::string         toolName;
@@ -418,6 +449,38 @@ MSIX_APPLICABILITY_OPTIONS GetApplicabilityOption(const Invocation& invocation)
     return applicability;
 }
 
+#ifdef MSIX_PACK
+APPX_COMPRESSION_OPTION GetCompressionOption(const Invocation& invocation)
+{
+    if (!invocation.IsOptionPresent("-c"))
+    {
+        return APPX_COMPRESSION_OPTION::APPX_COMPRESSION_OPTION_NORMAL;
+    }
+
+    const std::map<std::string, APPX_COMPRESSION_OPTION> options = {
+        { "none",      APPX_COMPRESSION_OPTION::APPX_COMPRESSION_OPTION_NONE },
+        { "superfast", APPX_COMPRESSION_OPTION::APPX_COMPRESSION_OPTION_SUPERFAST },
+        { "fast",      APPX_COMPRESSION_OPTION::APPX_COMPRESSION_OPTION_FAST },
+        { "normal",    APPX_COMPRESSION_OPTION::APPX_COMPRESSION_OPTION_NORMAL },
+        { "maximum",   APPX_COMPRESSION_OPTION::APPX_COMPRESSION_OPTION_MAXIMUM },
+    };
+    // Parse only accepts these values for -c
+    return options.at(invocation.GetOptionValue("-c"));
+}
+
+MSIX_PACKUNPACK_OPTION GetPackOption(const Invocation& invocation)
+{
+    MSIX_PACKUNPACK_OPTION pack = MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE;
+
+    if (invocation.IsOptionPresent("-si"))
+    {
+        pack |= MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_STOREINCOMPRESSIBLEFILES;
+    }
+
+    return pack;
+}
+#endif
+
 #pragma region Commands
 
 Command CreateHelpCommand(const std::vector<Command>& commands)
@@ -523,6 +586,64 @@ Command CreateUnbundleCommand()
     return result;
 }
 
+Command CreateVerifyCommand()
+{
+    Command result{ "verify", "Verify a package or bundle without unpacking it",
+        {
+            Option{ "-p", "Input package or bundle file path.", true, 1, "package" },
+            Option{ "-t", "Number of threads used to hash blocks. By default one per processor.", false, 1, "threads" },
+            Option{ "-ac", "Allows any certificate. By default the signature origin must be known." },
+            Option{ "-ss", "Skips enforcement of signed packages. By default packages must be signed." },
+            Option{ TOOL_HELP_COMMAND_STRING, "Displays this help text." },
+        }
+    };
+
+    result.SetDescription({
+        "Checks the signature, content types, block map and the hash of every block",
+        "of every file in the package at <package> without writing anything to disk.",
+        "If <package> is a bundle, all its packages are checked. Files and blocks",
+        "that don't match are listed.",
+        });
+
+    result.SetInvocationFunc([](const Invocation& invocation)
+        {
+            UINT32 threadCount = 0;
+            if (invocation.IsOptionPresent("-t"))
+            {
+                threadCount = static_cast<UINT32>(std::stoul(invocation.GetOptionValue("-t")));
+            }
+
+            MSIX_VERIFICATION_FAILURE* failures = nullptr;
+            UINT32 failureCount = 0;
+            auto hr = VerifyPackage(
+                GetValidationOption(invocation),
+                const_cast<char*>(invocation.GetOptionValue("-p").c_str()),
+                threadCount,
+                MyAllocate,
+                &failures,
+                &failureCount);
+
+            for (UINT32 i = 0; i < failureCount; i++)
+            {
+                std::cout << failures[i].fileName;
+                if (failures[i].blockIndex != MSIX_VERIFICATION_FILE)
+                {
+                    std::cout << " block " << std::dec << failures[i].blockIndex;
+                }
+                std::cout << ": 0x" << std::hex << failures[i].error << std::endl;
+            }
+            std::free(failures);
+
+            if (hr == 0)
+            {
+                std::cout << "Package verified" << std::endl;
+            }
+            return hr;
+        });
+
+    return result;
+}
+
 #ifdef MSIX_PACK
 Command CreatePackCommand()
 {
@@ -530,6 +651,9 @@ Command CreatePackCommand()
         {
             Option{ "-d", "Input directory path.", true, 1, "directory" },
             Option{ "-p", "Output package file path.", true, 1, "package" },
+            Option{ "-c", "Compression level: none, superfast, fast, normal or maximum. Default is normal.", false, 1, "level",
+                { "none", "superfast", "fast", "normal", "maximum" } },
+            Option{ "-si", "Store files whose content barely compresses, whatever their extension." },
             Option{ TOOL_HELP_COMMAND_STRING, "Displays this help text." },
         }
     };
@@ -537,20 +661,67 @@ Command CreatePackCommand()
     result.SetDescription({
         "Creates an app package at <package> by adding all the files from the",
         "specified input <directory>. You must include a valid package manifest",
-        "file named AppxManifest.xml in the directory provided.",
+        "file named AppxManifest.xml in the directory provided. Files whose",
+        "extension denotes already compressed content are always stored. With",
+        "-si the start of every other file is sampled as well.",
         });
 
     result.SetInvocationFunc([](const Invocation& invocation)
         {
-            return PackPackage(
-                MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+            return PackPackageWithCompression(
+                GetPackOption(invocation),
                 MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_FULL,
+                GetCompressionOption(invocation),
                 const_cast<char*>(invocation.GetOptionValue("-d").c_str()),
                 const_cast<char*>(invocation.GetOptionValue("-p").c_str()));
         });
 
     return result;
 }
+
+Command CreateRepackCommand()
+{
+    Command result{ "repack", "Rebuild a package with a new manifest or changed files",
+        {
+            Option{ "-p", "Input package file path.", true, 1, "package" },
+            Option{ "-o", "Output package file path.", true, 1, "output" },
+            Option{ "-d", "Directory with the files to add or replace.", false, 1, "directory" },
+            Option{ "-r", "Name of a file to remove. Can be given more than once.", false, 1, "file" },
+            Option{ "-si", "Store added files whose content barely compresses, whatever their extension." },
+            Option{ "-ac", "Allows any certificate. By default the signature origin must be known." },
+            Option{ "-ss", "Skips enforcement of signed packages. By default packages must be signed." },
+            Option{ TOOL_HELP_COMMAND_STRING, "Displays this help text." },
+        }
+    };
+
+    result.SetDescription({
+        "Creates an app package at <output> with the files of <package>, which",
+        "are copied as they are without compressing them again. Files from the",
+        "optional <directory> replace the ones with the same name, including",
+        "AppxManifest.xml, or are added. Files given with -r are left out. The",
+        "output package isn't signed.",
+        });
+
+    result.SetInvocationFunc([](const Invocation& invocation)
+        {
+            auto removed = invocation.GetOptionValues("-r");
+            std::vector<char*> removedFiles;
+            for (auto& file : removed)
+            {
+                removedFiles.push_back(const_cast<char*>(file.c_str()));
+            }
+            return RepackPackage(
+                GetPackOption(invocation),
+                GetValidationOption(invocation),
+                const_cast<char*>(invocation.GetOptionValue("-p").c_str()),
+                invocation.IsOptionPresent("-d") ? const_cast<char*>(invocation.GetOptionValue("-d").c_str()) : nullptr,
+                static_cast<UINT32>(removedFiles.size()),
+                removedFiles.data(),
+                const_cast<char*>(invocation.GetOptionValue("-o").c_str()));
+        });
+
+    return result;
+}
 #endif
 
 #pragma endregion
@@ -564,8 +735,10 @@ int main(int argc, char* argv[])
     std::vector<Command> commands = {
         CreateUnpackCommand(),
         CreateUnbundleCommand(),
+        CreateVerifyCommand(),
         #ifdef MSIX_PACK
         CreatePackCommand(),
+        CreateRepackCommand(),
         #endif
     };
 
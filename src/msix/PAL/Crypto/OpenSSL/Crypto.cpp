@@ -4,24 +4,82 @@
 // 
 #include "Exceptions.hpp"
 #include "Crypto.hpp"
+#include "SHA256Hardware.hpp"
 
 #include "openssl/sha.h"
 #include "openssl/evp.h"
 
+#include <memory>
+
 namespace MSIX {
+
+    struct unique_EVP_MD_CTX_deleter {
+        void operator()(EVP_MD_CTX *c) const { if (c) EVP_MD_CTX_destroy(c); };
+    };
+
+    typedef std::unique_ptr<EVP_MD_CTX, unique_EVP_MD_CTX_deleter> unique_EVP_MD_CTX;
+
+    // Digest contexts are reused per thread, so hashing a block doesn't allocate.
+    static EVP_MD_CTX* GetThreadDigestContext()
+    {
+        thread_local unique_EVP_MD_CTX context(EVP_MD_CTX_create());
+        ThrowErrorIfNot(Error::OutOfMemory, context, "failed creating digest context");
+        return context.get();
+    }
+
     bool SHA256::ComputeHash(std::uint8_t *buffer, std::uint32_t cbBuffer, std::vector<uint8_t>& hash)
     {
-        hash.resize(SHA256_DIGEST_LENGTH);
-        ::SHA256(buffer, cbBuffer, hash.data());
+        Hash result;
+        ComputeHash(buffer, cbBuffer, result);
+        hash.assign(result.begin(), result.end());
         return true;
     }
 
-    std::string Base64::ComputeBase64(const std::vector<std::uint8_t>& buffer)
+    void SHA256::ComputeHash(const std::uint8_t* buffer, std::size_t cbBuffer, Hash& hash)
+    {
+        ComputeHashes(&buffer, &cbBuffer, &hash, 1);
+    }
+
+    void SHA256::ComputeHashes(const std::uint8_t* const* buffers, const std::size_t* cbBuffers, Hash* hashes, std::size_t count)
     {
-        int expectedSize = ((buffer.size() +2)/3)*4; // +2 for a cheap round up if it needs padding
-        std::vector<std::uint8_t> result(expectedSize);
-        int encodeResult = EVP_EncodeBlock(static_cast<unsigned char*>(result.data()), const_cast<unsigned char*>(buffer.data()), buffer.size());
-        ThrowErrorIf(Error::Unexpected, expectedSize != encodeResult, "Error computing base64");
-        return std::string(result.begin(), result.end());
+        if (SHA256Hardware::IsSupported())
+        {
+            SHA256Hardware::ComputeHashes(buffers, cbBuffers, hashes, count);
+            return;
+        }
+
+        EVP_MD_CTX* context = GetThreadDigestContext();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            unsigned int size = 0;
+            ThrowErrorIfNot(Error::Unexpected, (
+                EVP_DigestInit_ex(context, EVP_sha256(), nullptr) == 1 &&
+                EVP_DigestUpdate(context, buffers[i], cbBuffers[i]) == 1 &&
+                EVP_DigestFinal_ex(context, hashes[i].data(), &size) == 1 &&
+                size == HashSize), "failed computing SHA256 hash");
+        }
+    }
+
+    struct SHA256::Context
+    {
+        SHA256_CTX ctx;
+    };
+
+    SHA256::SHA256() : m_context(std::make_unique<Context>())
+    {
+        ThrowErrorIfNot(Error::Unexpected, SHA256_Init(&m_context->ctx), "failed initializing SHA256 hash");
+    }
+
+    SHA256::~SHA256() = default;
+
+    void SHA256::Add(const std::uint8_t* buffer, std::size_t cbBuffer)
+    {
+        ThrowErrorIfNot(Error::Unexpected, SHA256_Update(&m_context->ctx, buffer, cbBuffer), "failed computing SHA256 hash");
+    }
+
+    void SHA256::Get(std::vector<std::uint8_t>& hash)
+    {
+        hash.resize(SHA256_DIGEST_LENGTH);
+        ThrowErrorIfNot(Error::Unexpected, SHA256_Final(hash.data(), &m_context->ctx), "failed computing SHA256 hash");
     }
 }
@@ -10,8 +10,10 @@
 #include <winerror.h>
 #include "Exceptions.hpp"
 #include "Crypto.hpp"
-#include "UnicodeConversion.hpp"
+#include "SHA256Hardware.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -107,16 +109,94 @@ namespace MSIX {
         return true;
     }
 
-    std::string Base64::ComputeBase64(const std::vector<std::uint8_t>& buffer)
+    void SHA256::ComputeHash(const std::uint8_t* buffer, std::size_t cbBuffer, Hash& hash)
     {
-        std::wstring result;
-        DWORD encodingFlags = CRYPT_STRING_BASE64 | CRYPT_STRING_NOCRLF;
-        DWORD encodedHashSize = 0;
-        ThrowHrIfFalse(CryptBinaryToStringW(buffer.data(), static_cast<DWORD>(buffer.size()), encodingFlags, nullptr, &encodedHashSize),
-            "CryptBinaryToStringW failed");
-        result.resize(encodedHashSize-1); // CryptBinaryToStringW returned size includes null termination
-        ThrowHrIfFalse(CryptBinaryToStringW(buffer.data(), static_cast<DWORD>(buffer.size()), encodingFlags, const_cast<wchar_t*>(result.data()), &encodedHashSize),
-            "CryptBinaryToStringW failed");
-        return wstring_to_utf8(result);
+        ComputeHashes(&buffer, &cbBuffer, &hash, 1);
+    }
+
+    void SHA256::ComputeHashes(const std::uint8_t* const* buffers, const std::size_t* cbBuffers, Hash* hashes, std::size_t count)
+    {
+        if (SHA256Hardware::IsSupported())
+        {
+            SHA256Hardware::ComputeHashes(buffers, cbBuffers, hashes, count);
+            return;
+        }
+
+        // Opening the provider is the expensive part, so it is done once for the process.
+        static unique_alg_handle algHandle([]()
+        {
+            BCRYPT_ALG_HANDLE algHandleT;
+            ThrowStatusIfFailed(BCryptOpenAlgorithmProvider(&algHandleT, BCRYPT_SHA256_ALGORITHM, nullptr, 0),
+                "failed computing SHA256 hash");
+            return algHandleT;
+        }());
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            BCRYPT_HASH_HANDLE hashHandleT;
+            ThrowStatusIfFailed(BCryptCreateHash(algHandle.get(), &hashHandleT, nullptr, 0, nullptr, 0, 0),
+                "failed computing SHA256 hash");
+            unique_hash_handle hashHandle(hashHandleT);
+
+            const std::uint8_t* buffer = buffers[i];
+            std::size_t cbBuffer = cbBuffers[i];
+            do
+            {   // BCryptHashData takes a ULONG, so feed large buffers in pieces.
+                ULONG chunk = static_cast<ULONG>(std::min<std::size_t>(cbBuffer, (std::numeric_limits<ULONG>::max)()));
+                ThrowStatusIfFailed(BCryptHashData(hashHandle.get(), const_cast<PUCHAR>(buffer), chunk, 0),
+                    "failed computing SHA256 hash");
+                buffer += chunk;
+                cbBuffer -= chunk;
+            } while (cbBuffer > 0);
+
+            ThrowStatusIfFailed(BCryptFinishHash(hashHandle.get(), hashes[i].data(), static_cast<ULONG>(HashSize), 0),
+                "failed computing SHA256 hash");
+        }
+    }
+
+    struct SHA256::Context
+    {
+        unique_alg_handle algHandle;
+        unique_hash_handle hashHandle;
+    };
+
+    SHA256::SHA256() : m_context(std::make_unique<Context>())
+    {
+        BCRYPT_ALG_HANDLE algHandleT;
+        BCRYPT_HASH_HANDLE hashHandleT;
+        ThrowStatusIfFailed(BCryptOpenAlgorithmProvider(&algHandleT, BCRYPT_SHA256_ALGORITHM, nullptr, 0),
+            "failed initializing SHA256 hash");
+        m_context->algHandle.reset(algHandleT);
+        ThrowStatusIfFailed(BCryptCreateHash(m_context->algHandle.get(), &hashHandleT, nullptr, 0, nullptr, 0, 0),
+            "failed initializing SHA256 hash");
+        m_context->hashHandle.reset(hashHandleT);
+    }
+
+    SHA256::~SHA256() = default;
+
+    void SHA256::Add(const std::uint8_t* buffer, std::size_t cbBuffer)
+    {
+        // BCryptHashData takes a ULONG, so feed large buffers in pieces.
+        while (cbBuffer > 0)
+        {
+            ULONG chunk = static_cast<ULONG>(std::min<std::size_t>(cbBuffer, (std::numeric_limits<ULONG>::max)()));
+            ThrowStatusIfFailed(BCryptHashData(m_context->hashHandle.get(), const_cast<PUCHAR>(buffer), chunk, 0),
+                "failed computing SHA256 hash");
+            buffer += chunk;
+            cbBuffer -= chunk;
+        }
+    }
+
+    void SHA256::Get(std::vector<std::uint8_t>& hash)
+    {
+        DWORD hashLength = 0;
+        DWORD resultLength = 0;
+        ThrowStatusIfFailed(BCryptGetProperty(m_context->algHandle.get(), BCRYPT_HASH_LENGTH, (PBYTE)&hashLength,
+            sizeof(hashLength), &resultLength, 0),
+            "failed computing SHA256 hash");
+        ThrowErrorIf(Error::Unexpected, (resultLength != sizeof(hashLength)), "failed computing SHA256 hash");
+        hash.resize(hashLength);
+        ThrowStatusIfFailed(BCryptFinishHash(m_context->hashHandle.get(), hash.data(), hashLength, 0),
+            "failed computing SHA256 hash");
     }
 }
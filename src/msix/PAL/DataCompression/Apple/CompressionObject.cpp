@@ -16,9 +16,10 @@ namespace MSIX {
         CompressionObject() = default;
 
         // ICompressionObject interface
-        CompressionStatus Initialize(CompressionOperation operation) noexcept
+        CompressionStatus Initialize(CompressionOperation operation, int) noexcept
         {
             m_compressionStream = {0};
+            m_operation = operation;
 
             switch (operation)
             {
@@ -26,7 +27,8 @@ namespace MSIX {
                     return GetStatus(compression_stream_init(&m_compressionStream, COMPRESSION_STREAM_DECODE, COMPRESSION_ZLIB));
                     break;
                 default:
-                    NOTIMPLEMENTED;
+                    // Only inflate is supported, see Deflate.
+                    return CompressionStatus::Error;
             }
         }
 
@@ -35,11 +37,31 @@ namespace MSIX {
             return GetStatus(compression_stream_process(&m_compressionStream, 0));
         }
 
+        CompressionStatus Deflate(CompressionFlush) noexcept
+        {
+            // libcompression can't do a full flush, which every block of the package needs. Packing requires zlib,
+            // Initialize already refuses to deflate.
+            return CompressionStatus::Error;
+        }
+
+        CompressionStatus Reset() noexcept
+        {
+            // There is no reset in libcompression, start over instead.
+            auto status = Cleanup();
+            if (status != CompressionStatus::Ok) { return status; }
+            return Initialize(m_operation, DefaultCompressionLevel);
+        }
+
         CompressionStatus Cleanup() noexcept
         {
             return GetStatus(compression_stream_destroy(&m_compressionStream));
         }
 
+        size_t GetDeflateBound(size_t) noexcept
+        {
+            return 0;
+        }
+
         size_t GetAvailableSourceSize() noexcept
         {
             return m_compressionStream.src_size;
@@ -63,7 +85,8 @@ namespace MSIX {
         }
 
     private:
-        compression_stream m_compressionStream = {0};
+        compression_stream   m_compressionStream = {0};
+        CompressionOperation m_operation = CompressionOperation::Inflate;
 
         CompressionStatus GetStatus(compression_status status)
         {
@@ -20,15 +20,20 @@ namespace MSIX {
         CompressionObject() = default;
 
         // ICompressionObject interface
-        CompressionStatus Initialize(CompressionOperation operation) noexcept
+        CompressionStatus Initialize(CompressionOperation operation, int level) noexcept
         {
             m_zstrm = { 0 };
+            m_operation = operation;
 
             switch (operation)
             {
                 case CompressionOperation::Inflate:
                     return GetStatus(inflateInit2(&m_zstrm, -MAX_WBITS));
                     break;
+                case CompressionOperation::Deflate:
+                    return GetStatus(deflateInit2(&m_zstrm, (level == DefaultCompressionLevel) ? Z_DEFAULT_COMPRESSION : level,
+                        Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY));
+                    break;
                 default:
                     NOTIMPLEMENTED;
             }
@@ -39,9 +44,27 @@ namespace MSIX {
             return GetStatus(inflate(&m_zstrm, Z_NO_FLUSH));
         }
 
+        CompressionStatus Deflate(CompressionFlush flush) noexcept
+        {
+            return GetStatus(deflate(&m_zstrm, (flush == CompressionFlush::Finish) ? Z_FINISH : Z_FULL_FLUSH));
+        }
+
+        CompressionStatus Reset() noexcept
+        {
+            // zlib leaves the buffers of the previous stream alone
+            SetInput(nullptr, 0);
+            SetOutput(nullptr, 0);
+            return GetStatus((m_operation == CompressionOperation::Inflate) ? inflateReset(&m_zstrm) : deflateReset(&m_zstrm));
+        }
+
         CompressionStatus Cleanup() noexcept
         {
-            return GetStatus(inflateEnd(&m_zstrm));
+            return GetStatus((m_operation == CompressionOperation::Inflate) ? inflateEnd(&m_zstrm) : deflateEnd(&m_zstrm));
+        }
+
+        size_t GetDeflateBound(size_t sourceSize) noexcept
+        {
+            return deflateBound(&m_zstrm, static_cast<uLong>(sourceSize));
         }
 
         size_t GetAvailableSourceSize() noexcept
@@ -67,14 +90,15 @@ namespace MSIX {
         }
 
     private:
-        z_stream        m_zstrm;
+        z_stream             m_zstrm;
+        CompressionOperation m_operation = CompressionOperation::Inflate;
 
         CompressionStatus GetStatus(int status)
         {
             switch (status)
             {
                 case Z_BUF_ERROR:
-                    // Since we do not use Z_FINISH, Z_BUF_ERROR just means there is nothing to do.
+                    // Z_FINISH is only used with room for the whole output, so Z_BUF_ERROR just means there is nothing to do.
                     //__fallthrough;
                 case Z_OK:
                     return CompressionStatus::Ok;
@@ -0,0 +1,73 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+// 
+#include "CertificateChainCache.hpp"
+#include "Crypto.hpp"
+#include "Exceptions.hpp"
+
+namespace MSIX
+{
+    constexpr std::size_t CertificateChainCache::MaxEntries;
+
+    CertificateChainCache& CertificateChainCache::Get()
+    {
+        static CertificateChainCache cache;
+        return cache;
+    }
+
+    std::vector<std::uint8_t> CertificateChainCache::GetKey(STACK_OF(X509)* certs)
+    {
+        SHA256 hash;
+        for (int i = 0; i < sk_X509_num(certs); i++)
+        {
+            X509* cert = sk_X509_value(certs, i);
+            int length = i2d_X509(cert, nullptr);
+            ThrowErrorIf(Error::SignatureInvalid, (length <= 0), "Could not encode cert");
+            std::vector<std::uint8_t> der(length);
+            std::uint8_t* out = der.data();
+            i2d_X509(cert, &out);
+            hash.Add(der.data(), der.size());
+        }
+        std::vector<std::uint8_t> key;
+        hash.Get(key);
+        return key;
+    }
+
+    bool CertificateChainCache::Find(const std::vector<std::uint8_t>& key, std::string& publisher)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = m_entries.find(key);
+        if (entry == m_entries.end()) { return false; }
+        if (X509_cmp_time(entry->second.expiry.get(), nullptr) <= 0)
+        {   m_entries.erase(entry);
+            return false;
+        }
+        publisher = entry->second.publisher;
+        return true;
+    }
+
+    void CertificateChainCache::Add(const std::vector<std::uint8_t>& key, STACK_OF(X509)* certs, const std::string& publisher)
+    {
+        ASN1_TIME* expiry = nullptr;
+        for (int i = 0; i < sk_X509_num(certs); i++)
+        {
+            ASN1_TIME* notAfter = X509_get_notAfter(sk_X509_value(certs, i));
+            int days = 0, seconds = 0;
+            if (expiry == nullptr || (ASN1_TIME_diff(&days, &seconds, expiry, notAfter) && (days < 0 || seconds < 0)))
+            {   expiry = notAfter;
+            }
+        }
+        // Nothing to gain from remembering a chain that is already expired.
+        if (expiry == nullptr || X509_cmp_time(expiry, nullptr) <= 0) { return; }
+
+        Entry entry;
+        entry.publisher = publisher;
+        entry.expiry.reset(ASN1_STRING_dup(expiry));
+        ThrowErrorIfNot(Error::OutOfMemory, entry.expiry, "Could not copy cert expiration");
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_entries.size() >= MaxEntries) { m_entries.clear(); }
+        m_entries[key] = std::move(entry);
+    }
+}
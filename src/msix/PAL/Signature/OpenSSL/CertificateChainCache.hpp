@@ -0,0 +1,50 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+// 
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <openssl/x509.h>
+
+namespace MSIX
+{
+    // Opt-in cache (MSIX_VALIDATION_OPTION_CACHECERTIFICATECHAIN) of the certificate chains that verified successfully.
+    // Packages from the same publisher carry the same certificates, so the verification and the publisher name derived
+    // from them are kept per chain until the first certificate of the chain expires.
+    class CertificateChainCache
+    {
+    public:
+        // The one shared by all the packages validated in the process.
+        static CertificateChainCache& Get();
+
+        // The key is the SHA256 of the DER encoding of all the certificates in the signature.
+        static std::vector<std::uint8_t> GetKey(STACK_OF(X509)* certs);
+
+        bool Find(const std::vector<std::uint8_t>& key, std::string& publisher);
+        void Add(const std::vector<std::uint8_t>& key, STACK_OF(X509)* certs, const std::string& publisher);
+
+        static constexpr std::size_t MaxEntries = 256;
+
+    private:
+        struct unique_ASN1_TIME_deleter {
+            void operator()(ASN1_TIME *t) const { if (t) ASN1_TIME_free(t); };
+        };
+
+        struct Entry
+        {
+            std::string publisher;
+            std::unique_ptr<ASN1_TIME, unique_ASN1_TIME_deleter> expiry;
+        };
+
+        std::mutex m_mutex;
+        std::map<std::vector<std::uint8_t>, Entry> m_entries;
+    };
+}
@@ -8,10 +8,15 @@
 #include "SignatureValidator.hpp"
 #include "MSIXResource.hpp"
 #include "StreamHelper.hpp"
+#include "CertificateChainCache.hpp"
 
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include <openssl/err.h>
 #include <openssl/bio.h>
@@ -54,6 +59,14 @@ namespace MSIX
         void operator()(STACK_OF(X509) *sx) const { if (sx) sk_X509_free(sx); };
     };
 
+    struct unique_ASN1_OBJECT_deleter {
+        void operator()(ASN1_OBJECT *o) const { if (o) ASN1_OBJECT_free(o); };
+    };
+
+    struct unique_EXTENDED_KEY_USAGE_deleter {
+        void operator()(EXTENDED_KEY_USAGE *e) const { if (e) EXTENDED_KEY_USAGE_free(e); };
+    };
+
     struct shared_BIO_deleter {
         void operator()(BIO *b) const { if (b) BIO_free(b); };
     };
@@ -65,6 +78,8 @@ namespace MSIX
     typedef std::unique_ptr<X509_STORE_CTX, unique_X509_STORE_CTX_deleter> unique_X509_STORE_CTX;
     typedef std::unique_ptr<char, unique_OPENSSL_string_deleter> unique_OPENSSL_string;
     typedef std::unique_ptr<STACK_OF(X509), unique_STACK_X509_deleter> unique_STACK_X509;
+    typedef std::unique_ptr<ASN1_OBJECT, unique_ASN1_OBJECT_deleter> unique_ASN1_OBJECT;
+    typedef std::unique_ptr<EXTENDED_KEY_USAGE, unique_EXTENDED_KEY_USAGE_deleter> unique_EXTENDED_KEY_USAGE;
     
     typedef struct Asn1Sequence
     {
@@ -86,39 +101,22 @@ namespace MSIX
     } Asn1Sequence;
 
     // Best effort to determine whether the signature file is associated with a store cert
-    static bool IsStoreOrigin(std::uint8_t* signatureBuffer, std::uint32_t cbSignatureBuffer)
+    static bool IsStoreOrigin(PKCS7* p7)
     {
-        unique_BIO bmem(BIO_new_mem_buf(signatureBuffer, cbSignatureBuffer));
-        unique_PKCS7 p7(d2i_PKCS7_bio(bmem.get(), nullptr));
+        // Parsed once, OBJ_cmp against it is a plain comparison of the encoded OIDs.
+        static const unique_ASN1_OBJECT storeOid(OBJ_txt2obj(OID::WindowsStore(), 1 /*numerical form only*/));
+        ThrowErrorIfNot(Error::Unexpected, storeOid, "Could not create Windows Store OID");
 
-        STACK_OF(X509) *certStack = p7.get()->d.sign->cert;
+        STACK_OF(X509) *certStack = p7->d.sign->cert;
         for (int i = 0; i < sk_X509_num(certStack); i++)
         {
             X509* cert = sk_X509_value(certStack, i);
-            STACK_OF(X509_EXTENSION) *exts = cert->cert_info->extensions;
-            for (int i = 0; i < sk_X509_EXTENSION_num(exts); i++) 
+            unique_EXTENDED_KEY_USAGE eku(reinterpret_cast<EXTENDED_KEY_USAGE*>(X509_get_ext_d2i(cert, NID_ext_key_usage, nullptr, nullptr)));
+            for (int j = 0; eku && j < sk_ASN1_OBJECT_num(eku.get()); j++)
             {
-                X509_EXTENSION *ext = sk_X509_EXTENSION_value(exts, i);
-                if (ext)
+                if (OBJ_cmp(sk_ASN1_OBJECT_value(eku.get(), j), storeOid.get()) == 0)
                 {
-                    if (X509_EXTENSION_get_object(ext))
-                    {
-                        unique_BIO extbio(BIO_new(BIO_s_mem()));
-                        if (!X509V3_EXT_print(extbio.get(), ext, 0, 0)) 
-                        {
-                            M_ASN1_OCTET_STRING_print(extbio.get(), ext->value);
-                        }
-                        // null terminate the string.
-                        BIO_write(extbio.get(), "", 1);
-                        BUF_MEM *bptr = nullptr;
-                        BIO_get_mem_ptr(extbio.get(), &bptr);
-                        
-                        if (bptr && bptr->data && 
-                            std::string((char*)bptr->data).find(OID::WindowsStore()) != std::string::npos)
-                        {
-                            return true;
-                        }
-                    }
+                    return true;
                 }
             }
         }
@@ -126,7 +124,7 @@ namespace MSIX
     }
 
     // Best effort to determine whether the signature file is associated with a store cert
-    static bool IsAuthenticodeOrigin(std::uint8_t* signatureBuffer, std::uint32_t cbSignatureBuffer)
+    static bool IsAuthenticodeOrigin(PKCS7* /*p7*/)
     {
         bool retValue = false;
         return retValue;
@@ -215,6 +213,77 @@ namespace MSIX
         return ok; 
     }
 
+    // OpenSSL 1.0.x relies on the application for locking. The shared store is read from many threads
+    // while verifying, so provide the locks unless whoever is hosting us already did.
+    static std::unique_ptr<std::mutex[]> s_opensslLocks;
+
+    static void LockingCallback(int mode, int n, const char* /*file*/, int /*line*/)
+    {
+        if (mode & CRYPTO_LOCK) { s_opensslLocks[n].lock(); }
+        else                    { s_opensslLocks[n].unlock(); }
+    }
+
+    // The trusted certificates come from our resources and never change, so the store and the stack
+    // used to verify against them are built once per process and only read afterwards.
+    class TrustedCertificates
+    {
+    public:
+        static const TrustedCertificates& Get(IMsixFactory* factory)
+        {
+            static const TrustedCertificates trusted(factory);
+            return trusted;
+        }
+
+        X509_STORE* GetStore() const     { return m_store.get(); }
+        STACK_OF(X509)* GetChain() const { return m_chain.get(); }
+
+    private:
+        TrustedCertificates(IMsixFactory* factory)
+        {
+            if (CRYPTO_get_locking_callback() == nullptr)
+            {
+                s_opensslLocks.reset(new std::mutex[CRYPTO_num_locks()]);
+                CRYPTO_set_locking_callback(&LockingCallback);
+            }
+
+            // Tell OpenSSL to use all available algorithms when evaluating certs
+            OpenSSL_add_all_algorithms();
+
+            // Create a trusted cert store
+            m_store.reset(X509_STORE_new());
+            // Set a verify callback to evaluate errors
+            X509_STORE_set_verify_cb(m_store.get(), &VerifyCallback);
+            // We have to tell OpenSSL why we are using the store -- in this case, closest is ANY.
+            X509_STORE_set_purpose(m_store.get(), X509_PURPOSE_ANY);
+
+            // Loop through our trusted PEM certs, create X509 objects from them, and add to trusted store
+            m_chain.reset(sk_X509_new_null());
+
+            // Get certificates from our resources
+            auto appxCerts = GetResources(factory, Resource::Certificates);
+            for ( auto& appxCert : appxCerts )
+            {
+                auto certBuffer = Helper::CreateBufferFromStream(appxCert.second);
+                // Load the cert into memory
+                unique_BIO bcert(BIO_new_mem_buf(certBuffer.data(), certBuffer.size()));
+
+                // Create a cert from the memory buffer
+                unique_X509 cert(PEM_read_bio_X509(bcert.get(), nullptr, nullptr, nullptr));
+
+                // Add the cert to the trusted store
+                ThrowErrorIfNot(Error::SignatureInvalid, 
+                    X509_STORE_add_cert(m_store.get(), cert.get()) == 1, 
+                    "Could not add cert to keychain");
+
+                // The store holds a reference, which keeps the cert alive for the stack as well.
+                sk_X509_push(m_chain.get(), cert.get());
+            }
+        }
+
+        unique_X509_STORE m_store;
+        unique_STACK_X509 m_chain;
+    };
+
     void replaceAll( std::string &s, const std::string &search, const std::string &replace ) {
         for(size_t pos = 0; ; pos += replace.length() ) {
             // Locate the substring to replace
@@ -226,10 +295,10 @@ namespace MSIX
         }
     }
 
-    bool GetPublisherName(/*in*/ unique_PKCS7& p7, /*inout*/ std::string& publisher)
+    bool GetPublisherName(/*in*/ PKCS7* p7, /*inout*/ std::string& publisher)
     {
         X509* cert = nullptr;
-        STACK_OF(X509) *untrustedCerts = p7.get()->d.sign->cert;
+        STACK_OF(X509) *untrustedCerts = p7->d.sign->cert;
         // If there's only one cert, it's a self-signed package; just return its subject
         if (sk_X509_num(untrustedCerts) == 1)
         {
@@ -327,56 +396,38 @@ namespace MSIX
 
         // Load the p7s into a BIO buffer
         unique_BIO bmem(BIO_new_mem_buf(p7s.data(), p7s.size()));
-        // Initialize the PKCS7 object from the BIO buffer
+        // Initialize the PKCS7 object from the BIO buffer. This is the only time the signature gets decoded,
+        // everything below works on the parsed object.
         unique_PKCS7 p7(d2i_PKCS7_bio(bmem.get(), nullptr));
 
-        // Tell OpenSSL to use all available algorithms when evaluating certs
-        OpenSSL_add_all_algorithms();
+        const auto& trusted = TrustedCertificates::Get(factory);
 
-        // Create a trusted cert store
-        unique_X509_STORE store(X509_STORE_new());
-        // Set a verify callback to evaluate errors
-        X509_STORE_set_verify_cb(store.get(), &VerifyCallback);
-        // We have to tell OpenSSL why we are using the store -- in this case, closest is ANY.
-        X509_STORE_set_purpose(store.get(), X509_PURPOSE_ANY);
-        
-        // Loop through our trusted PEM certs, create X509 objects from them, and add to trusted store
-        unique_STACK_X509 trustedChain(sk_X509_new_null());
+        unique_BIO signatureDigest(nullptr);
+        ReadDigestHashes(p7.get(), signatureObject, signatureDigest);
         
-        // Get certificates from our resources
-        auto appxCerts = GetResources(factory, Resource::Certificates);
-        for ( auto& appxCert : appxCerts )
+        // The cache only holds chains that were verified, so it doesn't apply when we don't verify them.
+        bool useChainCache = (option & MSIX_VALIDATION_OPTION_CACHECERTIFICATECHAIN) &&
+            (MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN != (option & MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN));
+        std::vector<std::uint8_t> chainKey;
+        bool chainVerified = false;
+        if (useChainCache)
         {
-            auto certBuffer = Helper::CreateBufferFromStream(appxCert.second);
-            // Load the cert into memory
-            unique_BIO bcert(BIO_new_mem_buf(certBuffer.data(), certBuffer.size()));
-
-            // Create a cert from the memory buffer
-            unique_X509 cert(PEM_read_bio_X509(bcert.get(), nullptr, nullptr, nullptr));
-            
-            // Add the cert to the trusted store
-            ThrowErrorIfNot(Error::SignatureInvalid, 
-                X509_STORE_add_cert(store.get(), cert.get()) == 1, 
-                "Could not add cert to keychain");
-            
-            sk_X509_push(trustedChain.get(), cert.get());
+            chainKey = CertificateChainCache::GetKey(p7.get()->d.sign->cert);
+            chainVerified = CertificateChainCache::Get().Find(chainKey, publisher);
         }
 
-        unique_BIO signatureDigest(nullptr);
-        ReadDigestHashes(p7.get(), signatureObject, signatureDigest);
-        
         // Loop through the untrusted certs and verify them if we're going to treat
         if (MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN != (option & MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN))
         {
             STACK_OF(X509) *untrustedCerts = p7.get()->d.sign->cert;
-            for (int i = 0; i < sk_X509_num(untrustedCerts); i++)
+            for (int i = 0; !chainVerified && i < sk_X509_num(untrustedCerts); i++)
             {
                 X509* cert = sk_X509_value(untrustedCerts, i);
                 unique_X509_STORE_CTX context(X509_STORE_CTX_new());
-                X509_STORE_CTX_init(context.get(), store.get(), nullptr, nullptr);
+                X509_STORE_CTX_init(context.get(), trusted.GetStore(), nullptr, nullptr);
 
                 X509_STORE_CTX_set_chain(context.get(), untrustedCerts);
-                X509_STORE_CTX_trusted_stack(context.get(), trustedChain.get());
+                X509_STORE_CTX_trusted_stack(context.get(), trusted.GetChain());
                 X509_STORE_CTX_set_cert(context.get(), cert);
 
                 X509_VERIFY_PARAM* param = X509_STORE_CTX_get0_param(context.get());
@@ -388,14 +439,16 @@ namespace MSIX
                         "Could not verify cert");
             }
 
+            // The signature over the digests is always checked, only the signer's chain comes from the cache.
+            int flags = PKCS7_NOCRL | (chainVerified ? PKCS7_NOVERIFY : 0);
             ThrowErrorIfNot(Error::SignatureInvalid, 
-                PKCS7_verify(p7.get(), trustedChain.get(), store.get(), signatureDigest.get(), nullptr/*out*/, PKCS7_NOCRL/*flags*/) == 1, 
+                PKCS7_verify(p7.get(), trusted.GetChain(), trusted.GetStore(), signatureDigest.get(), nullptr/*out*/, flags) == 1, 
                 "Could not verify package signature");
         }
 
         origin = MSIX::SignatureOrigin::Unknown;
-        if (IsStoreOrigin(p7s.data(), p7s.size())) { origin = MSIX::SignatureOrigin::Store; }
-        else if (IsAuthenticodeOrigin(p7s.data(), p7s.size())) { origin = MSIX::SignatureOrigin::LOB; }
+        if (IsStoreOrigin(p7.get())) { origin = MSIX::SignatureOrigin::Store; }
+        else if (IsAuthenticodeOrigin(p7.get())) { origin = MSIX::SignatureOrigin::LOB; }
 
         bool SignatureOriginUnknownAllowed = (option & MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN) == MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN;
         ThrowErrorIf(Error::CertNotTrusted, 
@@ -408,10 +461,17 @@ namespace MSIX
             SignatureOriginUnknownAllowed
         ), "Signature origin check failed");
 
-        ThrowErrorIfNot(Error::SignatureInvalid, (
-            GetPublisherName(p7, publisher) == true
-        ), "Signature origin check failed");
-        
+        if (!chainVerified)
+        {
+            ThrowErrorIfNot(Error::SignatureInvalid, (
+                GetPublisherName(p7.get(), publisher) == true
+            ), "Signature origin check failed");
+
+            if (useChainCache)
+            {   CertificateChainCache::Get().Add(chainKey, p7.get()->d.sign->cert, publisher);
+            }
+        }
+
         return true;
     }
 } // namespace MSIX
@@ -43,10 +43,10 @@ public:
         return GetAttributeValue(intermediate);
     }
 
-    std::vector<std::uint8_t> GetBase64DecodedAttributeValue(XmlAttributeName attribute) override
+    void GetBase64DecodedAttributeValue(XmlAttributeName attribute, std::uint8_t* value, std::size_t size) override
     {
         auto intermediate = GetAttributeValue(attribute);
-        return Encoding::GetBase64DecodedValue(intermediate);
+        Encoding::GetBase64DecodedValue(intermediate.data(), intermediate.size(), value, size);
     }
 
     std::string GetText() override
@@ -30,6 +30,7 @@ class IMSXMLElement : public IUnknown
 {
 public:
     virtual MSIX::ComPtr<IXMLDOMNodeList> SelectNodes(XmlQueryName query) = 0;
+    virtual MSIX::ComPtr<IXMLDOMNodeList> GetChildNodes() = 0;
 };
 MSIX_INTERFACE(IMSXMLElement, 0x2730f595,0x0c80,0x4f3e,0x88,0x91,0x75,0x3b,0x2e,0x8c,0x30,0x5d);
 
@@ -144,10 +145,10 @@ public:
         return {};
     }
 
-    std::vector<std::uint8_t> GetBase64DecodedAttributeValue(XmlAttributeName attribute) override
+    void GetBase64DecodedAttributeValue(XmlAttributeName attribute, std::uint8_t* value, std::size_t size) override
     {
         auto intermediate = GetAttributeValue(attribute);
-        return Encoding::GetBase64DecodedValue(intermediate);
+        Encoding::GetBase64DecodedValue(intermediate.data(), intermediate.size(), value, size);
     }
 
     std::string GetText() override
@@ -185,6 +186,13 @@ public:
         return list;
     }
 
+    ComPtr<IXMLDOMNodeList> GetChildNodes() override
+    {
+        ComPtr<IXMLDOMNodeList> list;
+        ThrowHrIfFailed(m_element->get_childNodes(&list));
+        return list;
+    }
+
     // IMsixElement
     HRESULT STDMETHODCALLTYPE GetAttributeValue(LPCWSTR name, LPWSTR* value) noexcept override try
     {
@@ -321,7 +329,7 @@ protected:
     }                                                                            \
 }
 
-class MSXMLDom final : public ComClass<MSXMLDom, IXmlDom, IMSXMLDom>
+class MSXMLDom final : public ComClass<MSXMLDom, IXmlDom, IMSXMLDom, IXmlDomWalker>
 {
 public:
     MSXMLDom(const ComPtr<IStream>& stream, const NamespaceManager& namespaces, IMsixFactory* factory = nullptr, bool stripIgnorableNamespaces = false) : m_factory(factory)
@@ -553,6 +561,36 @@ public:
         return true;
     }
 
+    // IXmlDomWalker
+    bool ForEachChildElement(const ComPtr<IXmlElement>& parent, IXmlChildHandler& handler) override
+    {
+        ComPtr<IXMLDOMNodeList> list = parent.As<IMSXMLElement>()->GetChildNodes();
+
+        long count = 0;
+        ThrowHrIfFailed(list->get_length(&count));
+        for(long index=0; index < count; index++)
+        {
+            ComPtr<IXMLDOMNode> node;
+            ThrowHrIfFailed(list->get_item(index, &node));
+            DOMNodeType type;
+            ThrowHrIfFailed(node->get_nodeType(&type));
+            if (type != NODE_ELEMENT)
+            {
+                continue;
+            }
+            Bstr localName;
+            ThrowHrIfFailed(node->get_baseName(localName.AddressOf()));
+            ComPtr<IXMLDOMElement> elementItem;
+            ThrowHrIfFailed(node->QueryInterface(__uuidof(IXMLDOMElement), reinterpret_cast<void**>(&elementItem)));
+            auto item = ComPtr<IXmlElement>::Make<MSXMLElement>(m_factory, elementItem);
+            if (!handler.Child(wstring_to_utf8(static_cast<WCHAR*>(localName.Get())), item))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
 protected:
     ComPtr<IXMLDOMDocument2> m_xmlDocument;
     IMsixFactory* m_factory;
@@ -2,12 +2,14 @@
 //  Copyright (C) 2017 Microsoft.  All rights reserved.
 //  See LICENSE file in the project root for full license information.
 // 
+#include <algorithm>
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
 #include <map>
-#include <queue>
 #include <list>
+#include <mutex>
 
 #include "Exceptions.hpp"
 #include "StreamBase.hpp"
@@ -15,22 +17,32 @@
 #include "StreamHelper.hpp"
 #include "MSIXResource.hpp"
 #include "UnicodeConversion.hpp"
+#include "Encoding.hpp"
 #include "Enumerators.hpp"
 
 // Mandatory for using any feature of Xerces.
 #include "xercesc/dom/DOM.hpp"
 #include "xercesc/framework/MemBufInputSource.hpp"
+#include "xercesc/framework/MemoryManager.hpp"
 #include "xercesc/framework/XMLGrammarPoolImpl.hpp"
 #include "xercesc/parsers/AbstractDOMParser.hpp"
+#include "xercesc/parsers/SAX2XMLReaderImpl.hpp"
 #include "xercesc/parsers/XercesDOMParser.hpp"
 #include "xercesc/sax/ErrorHandler.hpp"
+#include "xercesc/sax/InputSource.hpp"
+#include "xercesc/util/BinInputStream.hpp"
 #include "xercesc/util/PlatformUtils.hpp"
 #include "xercesc/util/XMLString.hpp"
-#include "xercesc/util/Base64.hpp"
+#include "xercesc/util/XMLChar.hpp"
 #include "xercesc/sax/SAXParseException.hpp"
 #include "xercesc/util/XMLEntityResolver.hpp"
 #include "xercesc/util/XMLUni.hpp" // helpful XMLChr*
-#include "xercesc/framework/MemBufFormatTarget.hpp"
+#include "xercesc/framework/XMLFormatter.hpp"
+#include "xercesc/framework/XMLPScanToken.hpp"
+#include "xercesc/sax2/Attributes.hpp"
+#include "xercesc/sax2/DefaultHandler.hpp"
+#include "xercesc/sax2/SAX2XMLReader.hpp"
+#include "xercesc/sax2/XMLReaderFactory.hpp"
 
 XERCES_CPP_NAMESPACE_USE
 
@@ -208,46 +220,153 @@ protected:
     XMLCh* m_ptr = nullptr;
 };
 
-class XercesXMLBytePtr
+// Base64 is plain ASCII, narrow it without going through the transcoder. Anything else will
+// fail to decode as it won't narrow to a valid base64 character.
+static void DecodeBase64(const XMLCh* encoded, std::uint8_t* value, std::size_t size)
+{
+    std::size_t length = XMLString::stringLen(encoded);
+    char fixed[64];
+    std::string dynamic;
+    char* chars = fixed;
+    if (length > sizeof(fixed))
+    {   dynamic.resize(length);
+        chars = &dynamic[0];
+    }
+    for (std::size_t index = 0; index < length; index++)
+    {   chars[index] = (encoded[index] < 0x80) ? static_cast<char>(encoded[index]) : static_cast<char>(0x80);
+    }
+    Encoding::GetBase64DecodedValue(chars, length, value, size);
+}
+
+// Compiled XPath expressions shared by all the documents created by a factory. Compiling an expression
+// binds its namespace prefixes, so the cache key is the expression plus the namespaces its prefixes
+// resolve to in the document being queried. Expressions are compiled against a document owned by the
+// cache, which keeps them independent of the lifetime of the documents they are evaluated on.
+class XPathCache final
 {
 public:
-    XercesXMLBytePtr(XMLByte* c) : m_ptr(c) {}
-    ~XercesXMLBytePtr() { InternalRelease(); }
+    XPathCache() : m_document(DOMImplementation::getImplementation()->createDocument(XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager))
+    {}
 
-    // move ctor
-    XercesXMLBytePtr(XercesXMLBytePtr &&right) : m_ptr(nullptr)
+    XercesPtr<DOMXPathResult> Evaluate(const char* xpath, DOMElement* context, DOMXPathNSResolver* resolver)
     {
-        if (this != reinterpret_cast<XercesXMLBytePtr*>(&reinterpret_cast<std::int8_t&>(right)))
-        {   Swap(right);
+        XercesXMLChPtr expression(XMLString::transcode(xpath));
+        auto key = GetKey(expression.Get(), resolver);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = m_expressions.find(key);
+        if (entry == m_expressions.end())
+        {
+            if (m_expressions.size() >= MaxExpressions) { m_expressions.clear(); }
+            XercesPtr<DOMXPathExpression> compiled(m_document->createExpression(expression.Get(), resolver));
+            entry = m_expressions.emplace(std::move(key), std::move(compiled)).first;
         }
-    }  
+        // Evaluating an expression updates its string pool, so this must be done under the lock too.
+        return XercesPtr<DOMXPathResult>(entry->second->evaluate(context, DOMXPathResult::ORDERED_NODE_SNAPSHOT_TYPE, nullptr));
+    }
 
-    void InternalRelease()
-    {   delete(m_ptr);
-        m_ptr = nullptr;
+protected:
+    static constexpr std::size_t MaxExpressions = 256;
+
+    static std::basic_string<XMLCh> GetKey(const XMLCh* expression, DOMXPathNSResolver* resolver)
+    {
+        std::basic_string<XMLCh> key(expression);
+        std::basic_string<XMLCh> name;
+        for (const XMLCh* c = expression; *c != chNull; c++)
+        {
+            // A name followed by a single colon is a prefix, a double colon follows an axis.
+            if (*c == chColon && *(c + 1) != chColon && !name.empty())
+            {
+                const XMLCh* uri = resolver->lookupNamespaceURI(name.c_str());
+                key.push_back(chNull);
+                key.append(name);
+                key.push_back(chEqual);
+                if (uri != nullptr) { key.append(uri); }
+            }
+            if (XMLChar1_0::isNCNameChar(*c)) { name.push_back(*c); }
+            else { name.clear(); }
+        }
+        return key;
     }
 
-    XercesXMLBytePtr& operator=(XercesXMLBytePtr&& right)
-    {   XercesXMLBytePtr(std::move(right)).Swap(*this);
-        return *this;
+    std::mutex m_mutex;
+    XercesPtr<DOMDocument> m_document;
+    std::map<std::basic_string<XMLCh>, XercesPtr<DOMXPathExpression>> m_expressions;
+};
+
+// State shared by all the elements of a parsed document. The namespace resolver is only
+// needed for XPath queries, so it is created the first time one is made.
+class XercesDocument final
+{
+public:
+    XercesDocument(XERCES_CPP_NAMESPACE::XercesDOMParser* parser, XPathCache* xpathCache) :
+        m_parser(parser), m_xpathCache(xpathCache)
+    {}
+
+    DOMDocument* GetDocument() { return m_parser->getDocument(); }
+
+    XercesPtr<DOMXPathResult> Evaluate(const char* xpath, DOMElement* context)
+    {
+        return m_xpathCache->Evaluate(xpath, context, GetResolver());
+    }
+
+    DOMXPathNSResolver* GetResolver()
+    {
+        if (!m_resolver.Get())
+        {   m_resolver = XercesPtr<DOMXPathNSResolver>(GetDocument()->createNSResolver(GetDocument()));
+        }
+        return m_resolver.Get();
+    }
+
+private:
+    XERCES_CPP_NAMESPACE::XercesDOMParser* m_parser = nullptr;
+    XPathCache* m_xpathCache = nullptr;
+    XercesPtr<DOMXPathNSResolver> m_resolver;
+};
+
+// Enumerates the result of an XPath query, creating the element objects as they are asked for.
+class XercesElementEnumerator final : public ComClass<XercesElementEnumerator, IMsixElementEnumerator>
+{
+public:
+    XercesElementEnumerator(IMsixFactory* factory, XercesDocument* document, XercesPtr<DOMXPathResult>&& result) :
+        m_factory(factory), m_document(document), m_result(std::move(result))
+    {
+        m_size = m_result->getSnapshotLength();
     }
 
-    XMLByte* operator->() const { return m_ptr; }
-    XMLByte* Get() const { return m_ptr; }
+    // IMsixElementEnumerator
+    HRESULT STDMETHODCALLTYPE GetCurrent(IMsixElement** element) noexcept override;
+
+    HRESULT STDMETHODCALLTYPE GetHasCurrent(BOOL* hasCurrent) noexcept override try
+    {
+        ThrowErrorIfNot(Error::InvalidParameter, (hasCurrent), "bad pointer");
+        *hasCurrent = (m_cursor != m_size) ? TRUE : FALSE;
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE MoveNext(BOOL* hasNext) noexcept override try
+    {
+        ThrowErrorIfNot(Error::InvalidParameter, (hasNext), "bad pointer");
+        *hasNext = (++m_cursor != m_size) ? TRUE : FALSE;
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
 protected:
-    inline void Swap(XercesXMLBytePtr& right ) { std::swap(m_ptr, right.m_ptr); }
-    XMLByte* m_ptr = nullptr;
+    IMsixFactory* m_factory = nullptr;
+    XercesDocument* m_document = nullptr;
+    XercesPtr<DOMXPathResult> m_result;
+    XMLSize_t m_size = 0;
+    XMLSize_t m_cursor = 0;
 };
 
+// Non owning handle to an element of a document owned by XercesDom.
 class XercesElement final : public ComClass<XercesElement, IXmlElement, IXercesElement, IMsixElement>
 {
 public:
 
-    XercesElement(IMsixFactory* factory, DOMElement* element, XERCES_CPP_NAMESPACE::XercesDOMParser* parser) :
-        m_factory(factory), m_element(element), m_parser(parser)
-    {
-        m_resolver = XercesPtr<DOMXPathNSResolver>(m_parser->getDocument()->createNSResolver(m_parser->getDocument()));
-    }
+    XercesElement(IMsixFactory* factory, DOMElement* element, XercesDocument* document) :
+        m_factory(factory), m_element(element), m_document(document)
+    {}
     
     // IXmlElement
     std::string GetAttributeValue(XmlAttributeName attribute) override
@@ -256,18 +375,10 @@ public:
         return GetAttributeValue(attributeName);
     }
 
-    std::vector<std::uint8_t> GetBase64DecodedAttributeValue(XmlAttributeName attribute) override
+    void GetBase64DecodedAttributeValue(XmlAttributeName attribute, std::uint8_t* value, std::size_t size) override
     {
         XercesXMLChPtr nameAttr(XMLString::transcode(GetAttributeNameStringUtf8(attribute)));
-        XMLSize_t len = 0;
-        XercesXMLBytePtr decodedData(XERCES_CPP_NAMESPACE::Base64::decodeToXMLByte(
-            m_element->getAttribute(nameAttr.Get()),
-            &len));
-        std::vector<std::uint8_t> result(len);
-        for(XMLSize_t index=0; index < len; index++)
-        {   result[index] = static_cast<std::uint8_t>(decodedData.Get()[index]);
-        }
-        return result;
+        DecodeBase64(m_element->getAttribute(nameAttr.Get()), value, size);
     }
 
     std::string GetText() override
@@ -342,72 +453,416 @@ public:
     {
         ThrowErrorIf(Error::InvalidParameter, (elements == nullptr || *elements != nullptr), "bad pointer.");
         // Note: getElementsByTagName only returns the childs of a DOMElement and doesn't 
-        // support xPath. For this reason we need the XercesDomParser in this object.
-        XercesXMLChPtr xPath(XMLString::transcode(xpath));
-        XercesPtr<DOMXPathResult> result(m_parser->getDocument()->evaluate(
-            xPath.Get(),
-            m_element,
-            m_resolver.Get(),
-            DOMXPathResult::ORDERED_NODE_SNAPSHOT_TYPE,
-            nullptr));
-
-        std::vector<ComPtr<IMsixElement>> elementsEnum;
-        for (XMLSize_t i = 0; i < result->getSnapshotLength(); i++)
-        {
-            result->snapshotItem(i);
-            auto node = static_cast<DOMElement*>(result->getNodeValue());
-            auto item = ComPtr<IMsixElement>::Make<XercesElement>(m_factory, node, m_parser);
-            elementsEnum.push_back(std::move(item));
-        }
-        *elements = ComPtr<IMsixElementEnumerator>::
-            Make<EnumeratorCom<IMsixElementEnumerator,IMsixElement>>(elementsEnum).Detach();
+        // support xPath. For this reason we need the document in this object.
+        auto result = m_document->Evaluate(xpath, m_element);
+        *elements = ComPtr<IMsixElementEnumerator>::Make<XercesElementEnumerator>(m_factory, m_document, std::move(result)).Detach();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
 protected:
     IMsixFactory* m_factory = nullptr;
     DOMElement* m_element = nullptr;
-    XERCES_CPP_NAMESPACE::XercesDOMParser* m_parser;
-    XercesPtr<DOMXPathNSResolver> m_resolver;
+    XercesDocument* m_document = nullptr;
 };
 
-class XercesDom final : public ComClass<XercesDom, IXmlDom>
+HRESULT STDMETHODCALLTYPE XercesElementEnumerator::GetCurrent(IMsixElement** element) noexcept try
+{
+    ThrowErrorIf(Error::InvalidParameter, (element == nullptr || *element != nullptr), "bad pointer");
+    ThrowErrorIf(Error::Unexpected, (m_cursor >= m_size), "No current element");
+    m_result->snapshotItem(m_cursor);
+    auto node = static_cast<DOMElement*>(m_result->getNodeValue());
+    *element = ComPtr<IMsixElement>::Make<XercesElement>(m_factory, node, m_document).Detach();
+    return static_cast<HRESULT>(Error::OK);
+} CATCH_RETURN();
+
+// Writes the bytes produced by an XMLFormatter into a vector
+class VectorFormatTarget final : public XERCES_CPP_NAMESPACE::XMLFormatTarget
 {
 public:
-    XercesDom(IMsixFactory* factory, const ComPtr<IStream>& stream, XmlContentType footPrintType) :
-        m_factory(factory), m_stream(stream)
+    VectorFormatTarget(std::vector<XMLByte>& buffer) : m_buffer(buffer) {}
+
+    void writeChars(const XMLByte* const toWrite, const XMLSize_t count, XERCES_CPP_NAMESPACE::XMLFormatter* const formatter) override
+    {   m_buffer.insert(m_buffer.end(), toWrite, toWrite + count);
+    }
+
+private:
+    std::vector<XMLByte>& m_buffer;
+};
+
+// SAX handler that writes the document back out as it is being read, leaving out the elements and
+// attributes of the ignorable namespaces that the schemas don't know about. Which namespaces those are
+// is only known once the root element is read, when there's nothing to leave out the caller can stop.
+class IgnorableNamespacesFilter final : public XERCES_CPP_NAMESPACE::DefaultHandler
+{
+public:
+    IgnorableNamespacesFilter(const NamespaceManager& namespaces, std::vector<XMLByte>& output) :
+        m_namespaces(namespaces), m_target(output),
+        m_formatter("UTF-8", &m_target, XERCES_CPP_NAMESPACE::XMLFormatter::NoEscapes, XERCES_CPP_NAMESPACE::XMLFormatter::UnRep_CharRef)
+    {}
+
+    bool HasRoot() const { return m_hasRoot; }
+    bool HasNamespacesToStrip() const { return !m_stripped.empty(); }
+
+    void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname,
+        const XERCES_CPP_NAMESPACE::Attributes& attrs) override
     {
-        auto buffer = Helper::CreateBufferFromStream(stream);
-        std::unique_ptr<XERCES_CPP_NAMESPACE::MemBufInputSource> source = std::make_unique<XERCES_CPP_NAMESPACE::MemBufInputSource>(
-            reinterpret_cast<const XMLByte*>(&buffer[0]), buffer.size(), "XML File");
+        if (!m_hasRoot)
+        {
+            m_hasRoot = true;
+            FindNamespacesToStrip(attrs);
+            if (m_stripped.empty()) { return; }
+            static const char declaration[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+            m_target.writeChars(reinterpret_cast<const XMLByte*>(declaration), sizeof(declaration) - 1, &m_formatter);
+        }
 
-        // Create parser and grammar pool
-        auto grammarPool = std::make_unique<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl>(XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager);
-        m_parser = std::make_unique<XERCES_CPP_NAMESPACE::XercesDOMParser>(nullptr, XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager, grammarPool.get());
-        
-        // For Non validation parser GetResources will return an empty vector for the ContentType, BlockMap and AppxBundleManifest.
-        // XercesDom will only parse the schemas if the vector is not empty. If not, it will only see that it is valid xml.
+        // Everything under an element that is left out is left out as well
+        if (m_skipDepth > 0 || IsStripped(uri))
+        {   m_skipDepth++;
+            return;
+        }
+
+        m_formatter << XERCES_CPP_NAMESPACE::XMLFormatter::NoEscapes << chOpenAngle << qname;
+        for (XMLSize_t i = 0; i < attrs.getLength(); i++)
+        {
+            if (IsStripped(attrs.getURI(i))) { continue; }
+            m_formatter << XERCES_CPP_NAMESPACE::XMLFormatter::NoEscapes << chSpace << attrs.getQName(i) << chEqual << chDoubleQuote
+                        << XERCES_CPP_NAMESPACE::XMLFormatter::AttrEscapes << attrs.getValue(i)
+                        << XERCES_CPP_NAMESPACE::XMLFormatter::NoEscapes << chDoubleQuote;
+        }
+        m_formatter << chCloseAngle;
+    }
+
+    void endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) override
+    {
+        if (m_skipDepth > 0)
+        {   m_skipDepth--;
+            return;
+        }
+        m_formatter << XERCES_CPP_NAMESPACE::XMLFormatter::NoEscapes << chOpenAngle << chForwardSlash << qname << chCloseAngle;
+    }
+
+    void characters(const XMLCh* const chars, const XMLSize_t length) override
+    {
+        if (m_skipDepth > 0) { return; }
+        m_formatter.formatBuf(chars, length, XERCES_CPP_NAMESPACE::XMLFormatter::CharEscapes);
+    }
+
+    void ignorableWhitespace(const XMLCh* const chars, const XMLSize_t length) override
+    {
+        characters(chars, length);
+    }
+
+private:
+    void FindNamespacesToStrip(const XERCES_CPP_NAMESPACE::Attributes& attrs)
+    {
+        static const XMLCh ignorableNamespaces[] = u"IgnorableNamespaces";
+        const XMLCh* value = attrs.getValue(ignorableNamespaces);
+        if (value == nullptr) { return; }
+
+        std::u16string aliases(value);
+        std::size_t position = 0;
+        while (position < aliases.size())
+        {
+            auto end = aliases.find_first_of(u" \t\r\n", position);
+            if (end == std::u16string::npos) { end = aliases.size(); }
+            if (end > position)
+            {   // Look for the xmlns:[alias] attribute, only strip the namespace if we don't know about it
+                std::u16string alias = u"xmlns:" + aliases.substr(position, end - position);
+                const XMLCh* uri = attrs.getValue(alias.c_str());
+                if (uri != nullptr)
+                {
+                    std::string utf8Uri = u16string_to_utf8(uri);
+                    if (std::find(m_namespaces.begin(), m_namespaces.end(), utf8Uri.c_str()) == m_namespaces.end())
+                    {   m_stripped.push_back(uri);
+                    }
+                }
+            }
+            position = end + 1;
+        }
+    }
+
+    bool IsStripped(const XMLCh* uri) const
+    {
+        if (uri == nullptr || *uri == chNull) { return false; }
+        return std::find(m_stripped.begin(), m_stripped.end(), uri) != m_stripped.end();
+    }
+
+    const NamespaceManager&                 m_namespaces;
+    VectorFormatTarget                      m_target;
+    XERCES_CPP_NAMESPACE::XMLFormatter      m_formatter;
+    std::vector<std::u16string>             m_stripped;
+    bool                                    m_hasRoot = false;
+    std::size_t                             m_skipDepth = 0;
+};
+
+// Element handed to an IXmlStreamHandler from the SAX startElement callback
+class XercesStreamElement final : public IXmlStreamElement
+{
+public:
+    XercesStreamElement(const XMLCh* localName, const XERCES_CPP_NAMESPACE::Attributes& attributes) :
+        m_localName(localName), m_attributes(attributes)
+    {}
+
+    bool HasLocalName(const char* localName) override
+    {
+        const XMLCh* name = m_localName;
+        for (; *localName != '\0' && *name == static_cast<XMLCh>(*localName); localName++, name++);
+        return (*localName == '\0') && (*name == chNull);
+    }
+
+    std::string GetAttributeValue(XmlAttributeName attribute) override
+    {
+        const XMLCh* value = GetValue(attribute);
+        if (value == nullptr) { return {}; }
+        return u16string_to_utf8(value);
+    }
+
+    void GetBase64DecodedAttributeValue(XmlAttributeName attribute, std::uint8_t* value, std::size_t size) override
+    {
+        const XMLCh* encoded = GetValue(attribute);
+        DecodeBase64((encoded == nullptr) ? XMLUni::fgZeroLenString : encoded, value, size);
+    }
+
+private:
+    const XMLCh* GetValue(XmlAttributeName attribute)
+    {   // Attribute names are plain ASCII
+        const char* name = GetAttributeNameStringUtf8(attribute);
+        XMLCh wide[64];
+        std::size_t length = 0;
+        for (; name[length] != '\0'; length++)
+        {   ThrowErrorIf(Error::Unexpected, (length == (sizeof(wide) / sizeof(XMLCh)) - 1), "Attribute name too long");
+            wide[length] = static_cast<XMLCh>(name[length]);
+        }
+        wide[length] = chNull;
+        return m_attributes.getValue(wide);
+    }
+
+    const XMLCh* m_localName;
+    const XERCES_CPP_NAMESPACE::Attributes& m_attributes;
+};
+
+// Forwards the SAX element callbacks to an IXmlStreamHandler
+class XercesStreamHandler final : public XERCES_CPP_NAMESPACE::DefaultHandler
+{
+public:
+    XercesStreamHandler(IXmlStreamHandler& handler) : m_handler(handler) {}
+
+    bool IsStopped() { return m_stopped; }
+
+    void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname,
+        const XERCES_CPP_NAMESPACE::Attributes& attrs) override
+    {
+        XercesStreamElement element(localname, attrs);
+        if (!m_handler.StartElement(m_depth++, element))
+        {
+            m_stopped = true;
+        }
+    }
+
+    void endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) override
+    {
+        m_handler.EndElement(--m_depth);
+    }
+
+private:
+    IXmlStreamHandler& m_handler;
+    std::size_t        m_depth = 0;
+    bool               m_stopped = false;
+};
+
+// Reads the document from the stream as the parser asks for it, so a parse that stops early doesn't read
+// (or inflate) the rest of the document.
+class StreamInputSource final : public XERCES_CPP_NAMESPACE::InputSource
+{
+public:
+    StreamInputSource(const ComPtr<IStream>& stream) : XERCES_CPP_NAMESPACE::InputSource("XML File"), m_stream(stream) {}
+
+    XERCES_CPP_NAMESPACE::BinInputStream* makeStream() const override
+    {
+        return new (getMemoryManager()) Reader(m_stream);
+    }
+
+private:
+    class Reader final : public XERCES_CPP_NAMESPACE::BinInputStream
+    {
+    public:
+        Reader(const ComPtr<IStream>& stream) : m_stream(stream) {}
+
+        XMLFilePos curPos() const override { return m_position; }
+
+        XMLSize_t readBytes(XMLByte* const toFill, const XMLSize_t maxToRead) override
+        {
+            ULONG read = 0;
+            ThrowHrIfFailed(m_stream->Read(toFill, static_cast<ULONG>(maxToRead), &read));
+            m_position += read;
+            return read;
+        }
+
+        const XMLCh* getContentType() const override { return nullptr; }
+
+    private:
+        ComPtr<IStream> m_stream;
+        XMLFilePos      m_position = 0;
+    };
+
+    ComPtr<IStream> m_stream;
+};
+
+// Compiling the schemas costs more than parsing the documents validated against them. The schemas come from
+// our resources and never change, so they are compiled once per process into a grammar pool per type of
+// document. The pools are locked once built, which makes them read-only and safe to share between parsers
+// running on different threads.
+class SchemaGrammars
+{
+public:
+    static SchemaGrammars& Get()
+    {
+        static SchemaGrammars grammars;
+        return grammars;
+    }
+
+    // Returns nullptr if there are no schemas for this type of document, which is always the case for the
+    // non validation parser. Documents are then only checked for being valid xml.
+    XERCES_CPP_NAMESPACE::XMLGrammarPool* GetPool(IMsixFactory* factory, XmlContentType footPrintType)
+    {
+        ThrowErrorIf(Error::InvalidParameter, (static_cast<std::size_t>(footPrintType) >= MaxContentTypes), "Invalid xml content type");
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& entry = m_pools[static_cast<std::size_t>(footPrintType)];
+        if (!entry.built)
+        {
+            entry.pool = BuildPool(factory, footPrintType);
+            entry.built = true;
+        }
+        return entry.pool.get();
+    }
+
+private:
+    static constexpr std::size_t MaxContentTypes = static_cast<std::size_t>(XmlContentType::AppxBundleManifestXml) + 1;
+
+    struct Entry
+    {
+        bool built = false;
+        std::unique_ptr<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl> pool;
+    };
+
+    // Keep xerces initialized for as long as the pools are around, regardless of the factories.
+    SchemaGrammars() { XERCES_CPP_NAMESPACE::XMLPlatformUtils::Initialize(); }
+
+    ~SchemaGrammars()
+    {
+        for (auto& entry : m_pools) { entry.pool.reset(); }
+        XERCES_CPP_NAMESPACE::XMLPlatformUtils::Terminate();
+    }
+
+    static std::unique_ptr<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl> BuildPool(IMsixFactory* factory, XmlContentType footPrintType)
+    {
         std::vector<std::pair<std::string, ComPtr<IStream>>> schemas;
         if (footPrintType == XmlContentType::AppxBlockMapXml)
         {
-            schemas = GetResources(m_factory, Resource::Type::BlockMap);
+            schemas = GetResources(factory, Resource::Type::BlockMap);
         }
         else if (footPrintType == XmlContentType::AppxManifestXml)
         {
-            schemas = GetResources(m_factory, Resource::Type::AppxManifest);
+            schemas = GetResources(factory, Resource::Type::AppxManifest);
         }
         else if (footPrintType == XmlContentType::ContentTypeXml)
         {
-            schemas = GetResources(m_factory, Resource::Type::ContentType);
+            schemas = GetResources(factory, Resource::Type::ContentType);
         }
         else if (footPrintType == XmlContentType::AppxBundleManifestXml)
         {
-            schemas = GetResources(m_factory, Resource::Type::AppxBundleManifest);
+            schemas = GetResources(factory, Resource::Type::AppxBundleManifest);
+        }
+        if (schemas.empty()) { return nullptr; }
+
+        auto grammarPool = std::make_unique<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl>(XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager);
+        {
+            XERCES_CPP_NAMESPACE::XercesDOMParser parser(nullptr, XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager, grammarPool.get());
+            ParsingException errorHandler;
+            MsixEntityResolver entityResolver(factory, s_xmlNamespaces[static_cast<std::uint8_t>(footPrintType)]);
+            parser.setErrorHandler(&errorHandler);
+            parser.setXMLEntityResolver(&entityResolver);
+            parser.setDoNamespaces(true);
+            parser.setDoSchema(true);
+            parser.setValidationSchemaFullChecking(true);
+
+            for(const auto& schema : schemas)
+            {
+                auto schemaBuffer = Helper::CreateBufferFromStream(schema.second);
+                auto item = std::make_unique<XERCES_CPP_NAMESPACE::MemBufInputSource>(
+                    reinterpret_cast<const XMLByte*>(&schemaBuffer[0]), schemaBuffer.size(), schema.first.c_str());
+                parser.loadGrammar(*item, XERCES_CPP_NAMESPACE::Grammar::GrammarType::SchemaGrammarType, true);
+            }
         }
-        else
+        grammarPool->lockPool();
+        return grammarPool;
+    }
+
+    std::mutex m_mutex;
+    Entry      m_pools[MaxContentTypes];
+};
+
+// Bump allocator for a XercesDom parser and its document. Manifest and blockmap DOMs are short lived and
+// make lots of small allocations, so nothing is freed individually and everything goes away at once with
+// the DOM, instead of going through the global heap node by node.
+class ArenaMemoryManager final : public XERCES_CPP_NAMESPACE::MemoryManager
+{
+public:
+    ArenaMemoryManager() {}
+
+    // Exceptions can outlive the arena
+    XERCES_CPP_NAMESPACE::MemoryManager* getExceptionMemoryManager() override
+    {   return XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager;
+    }
+
+    void* allocate(XMLSize_t size) override
+    {
+        size = std::max<XMLSize_t>((size + Alignment - 1) & ~(Alignment - 1), Alignment);
+        if (size > LargeAllocation)
+        {   // Big enough to get its own chunk, keep filling the current one.
+            m_chunks.emplace_back(new std::uint8_t[size]);
+            return m_chunks.back().get();
+        }
+        if (size > m_available)
         {
-            ThrowError(Error::InvalidParameter);
+            m_chunks.emplace_back(new std::uint8_t[ChunkSize]);
+            m_next = m_chunks.back().get();
+            m_available = ChunkSize;
         }
+        void* result = m_next;
+        m_next += size;
+        m_available -= size;
+        return result;
+    }
+
+    void deallocate(void*) override {}
+
+protected:
+    static constexpr XMLSize_t Alignment = alignof(std::max_align_t);
+    static constexpr XMLSize_t ChunkSize = 64 * 1024;
+    static constexpr XMLSize_t LargeAllocation = ChunkSize / 4;
+
+    std::vector<std::unique_ptr<std::uint8_t[]>> m_chunks;
+    std::uint8_t* m_next = nullptr;
+    XMLSize_t m_available = 0;
+};
+
+constexpr XMLSize_t ArenaMemoryManager::Alignment;
+constexpr XMLSize_t ArenaMemoryManager::ChunkSize;
+constexpr XMLSize_t ArenaMemoryManager::LargeAllocation;
+
+class XercesDom final : public ComClass<XercesDom, IXmlDom, IXmlDomWalker>
+{
+public:
+    XercesDom(IMsixFactory* factory, const ComPtr<IStream>& stream, XmlContentType footPrintType, XERCES_CPP_NAMESPACE::XMLGrammarPool* grammarPool, XPathCache* xpathCache) :
+        m_factory(factory), m_stream(stream)
+    {
+        auto buffer = Helper::CreateBufferFromStream(stream);
+        std::unique_ptr<XERCES_CPP_NAMESPACE::MemBufInputSource> source = std::make_unique<XERCES_CPP_NAMESPACE::MemBufInputSource>(
+            reinterpret_cast<const XMLByte*>(&buffer[0]), buffer.size(), "XML File");
+
+        // Create parser, without a grammar pool it will create its own.
+        m_parser = std::make_unique<XERCES_CPP_NAMESPACE::XercesDOMParser>(nullptr, &m_memoryManager, grammarPool);
 
         // Set the error handler and entity resolver for the parser
         auto errorHandler = std::make_unique<ParsingException>();
@@ -416,32 +871,27 @@ public:
         m_parser->setXMLEntityResolver(entityResolver.get());
         m_parser->setDoNamespaces(true);
 
-        if (!schemas.empty())
+        std::vector<XMLByte> stripped;
+        if (grammarPool != nullptr)
         {
-            if (footPrintType == XmlContentType::AppxManifestXml || footPrintType == XmlContentType::AppxBundleManifestXml)
+            if ((footPrintType == XmlContentType::AppxManifestXml || footPrintType == XmlContentType::AppxBundleManifestXml) &&
+                StripIgnorableNamespaces(*source, s_xmlNamespaces[static_cast<std::uint8_t>(footPrintType)], stripped))
             {
-                source = StripIgnorableNamespaces(*source, s_xmlNamespaces[static_cast<std::uint8_t>(footPrintType)]);
+                source = std::make_unique<XERCES_CPP_NAMESPACE::MemBufInputSource>(stripped.data(), stripped.size(), "XML File");
             }
 
             m_parser->setValidationScheme(XERCES_CPP_NAMESPACE::AbstractDOMParser::ValSchemes::Val_Always);
-            m_parser->cacheGrammarFromParse(true);
+            m_parser->useCachedGrammarInParse(true);
             m_parser->setDoSchema(true);
             m_parser->setValidationSchemaFullChecking(true);
             // Disable DTD and prevent XXE attacks.  See https://www.owasp.org/index.php/XML_External_Entity_(XXE)_Prevention_Cheat_Sheet#libxerces-c for additional details.
             m_parser->setIgnoreCachedDTD(true);
             m_parser->setSkipDTDValidation(true);
             m_parser->setCreateEntityReferenceNodes(false);
-
-            for(const auto& schema : schemas)
-            {
-                auto schemaBuffer = Helper::CreateBufferFromStream(schema.second);
-                auto item = std::make_unique<XERCES_CPP_NAMESPACE::MemBufInputSource>(
-                    reinterpret_cast<const XMLByte*>(&schemaBuffer[0]), schemaBuffer.size(), schema.first.c_str());
-                m_parser->loadGrammar(*item, XERCES_CPP_NAMESPACE::Grammar::GrammarType::SchemaGrammarType, true);
-            }
         }
 
         m_parser->parse(*source);
+        m_document = std::make_unique<XercesDocument>(m_parser.get(), xpathCache);
 
         // TODO: Do semantic check for all the elements we modified to maxOcurrs=unbounded and xs:patterns
     }
@@ -449,7 +899,7 @@ public:
     // IXmlDom
     MSIX::ComPtr<IXmlElement> GetDocument() override
     {
-        return ComPtr<IXmlElement>::Make<XercesElement>(m_factory, m_parser->getDocument()->getDocumentElement(), m_parser.get());
+        return ComPtr<IXmlElement>::Make<XercesElement>(m_factory, m_parser->getDocument()->getDocumentElement(), m_document.get());
     }
 
     bool ForEachElementIn(const ComPtr<IXmlElement>& root, XmlQueryName query, XmlVisitor& visitor) override
@@ -480,7 +930,7 @@ public:
 
         for(const auto& element : list)
         {
-            auto item = ComPtr<IXmlElement>::Make<XercesElement>(m_factory, element, m_parser.get());
+            auto item = ComPtr<IXmlElement>::Make<XercesElement>(m_factory, element, m_document.get());
             if (!visitor(item))
             {
                 return false;
@@ -489,122 +939,57 @@ public:
         return true;
     }
 
-protected:
-
-    std::unique_ptr<MemBufInputSource> StripIgnorableNamespaces(const InputSource& source, const NamespaceManager& namespaces)
+    // IXmlDomWalker
+    bool ForEachChildElement(const ComPtr<IXmlElement>& parent, IXmlChildHandler& handler) override
     {
-        m_parser->setDoNamespaces(true);
-        m_parser->parse(source);
-        XERCES_CPP_NAMESPACE::DOMDocument* dom = m_parser->getDocument();
-        auto rootElement = ComPtr<IXercesElement>::Make<XercesElement>(m_factory, dom->getDocumentElement(), m_parser.get());
-        std::string attr = "IgnorableNamespaces";
-        std::string attrValue = rootElement->GetAttributeValue(attr);
-        if (!attrValue.empty())
+        DOMElement* element = parent.As<IXercesElement>()->GetElement();
+        for (DOMElement* child = element->getFirstElementChild(); child != nullptr; child = child->getNextElementSibling())
         {
-            std::vector<std::string> aliasesToLookup;
-            {
-                std::string alias;
-                std::istringstream aliases(attrValue);
-                while(getline(aliases, alias, ' ')) { aliasesToLookup.push_back(alias); }
-            }
-            for (const auto& a : aliasesToLookup)
+            XercesCharPtr localName(XMLString::transcode(child->getLocalName()));
+            auto item = ComPtr<IXmlElement>::Make<XercesElement>(m_factory, child, m_document.get());
+            if (!handler.Child(localName.Get(), item))
             {
-                std::string alias = "xmlns:" + a; // Look for xmlns:[alias] attribute name
-                std::string aliasValue = rootElement->GetAttributeValue(alias);
-                const auto& entry = std::find(namespaces.begin(), namespaces.end(), aliasValue.c_str());
-                if (entry == namespaces.end()) // only strip if we don't know about it
-                {
-                    RemoveAllInNamespace(rootElement, a);
-                }
+                return false;
             }
-
         }
+        return true;
+    }
 
-        // Serialize the new dom to parse.
-        static const XMLCh cs[3] = {chLatin_L, chLatin_S, chNull};
-        DOMImplementation *impl = DOMImplementationRegistry::getDOMImplementation(cs);
-        auto serializer = XercesPtr<DOMLSSerializer>((static_cast<DOMImplementationLS*>(impl))->createLSSerializer());
-        auto lsOutput = XercesPtr<DOMLSOutput>((static_cast<DOMImplementationLS*>(impl))->createLSOutput());
-
-        // Set encoding to UTF-8
-        static const XMLCh utf8Str[] = {chLatin_U, chLatin_T, chLatin_F, chDash, chDigit_8, chNull};
-        lsOutput->setEncoding(utf8Str);
-
-        std::unique_ptr<MemBufFormatTarget> formatTarget = std::make_unique<MemBufFormatTarget>();
-        lsOutput->setByteStream(static_cast<XMLFormatTarget*>(formatTarget.get()));
-        serializer->write(dom, lsOutput.Get());
-
-        m_parser->reset();
-
-        // Copy buffer, don't use unique_ptr here, this buffer is going to be deleted by Xerces
-        XMLSize_t size = formatTarget->getLen();
-        XMLByte* newBuffer = new XMLByte[size];
-        std::memcpy(reinterpret_cast<void*>(newBuffer), 
-            reinterpret_cast<void*>(const_cast<XMLByte*>(formatTarget->getRawBuffer())),
-            static_cast<size_t>(size));
-        return std::make_unique<MemBufInputSource>(newBuffer, size, "XML File", true /*delete by xerces*/);
-    }
-
-    // Remove elements and attributes from a specified namespace. We don't use the Xerces xPath APIs for several
-    // reasons:
-    // 1 - XPathScannerForSchema::addToken on xercesxpath.cpp explicitly disallows node() as a valid token to matches 
-    // elements and attribute nodes with one single xpath...
-    // 2 - Xerces will throw XMLExcepts::XPath_NoAttrSelector ("selector cannot select attribute"). for //@<namespace>:*.
-    // See XercesXPath::checkForSelectedAttributes in xercesxpath.cpp. Removing the checkForSelectedAttributes from
-    // XercesXPath::XercesXPath will allow us to use the xpath but the result will be the element node, not the 
-    // attribute one. This implies modifying xerces and then iteratate the attributes of the elements.
-    // 
-    // Because we don't want to modify xerces, we will iterate through all of the elements and look at their attributes.
-    // If we are doing that, there's no point selecting all the elements in the namespace using xpath,
-    // just remove them in the same pass.
-    void RemoveAllInNamespace(ComPtr<IXercesElement>& rootElement, const std::string& prefix)
-    {
-        XercesXMLChPtr XercesPrefix(XMLString::transcode(prefix.c_str()));
-        std::queue<DOMNode*> nodeQueue;
-        nodeQueue.push(static_cast<DOMNode*>(rootElement->GetElement()));
-        while (!nodeQueue.empty())
-        {
-            auto node = nodeQueue.front();
+protected:
 
-            // Remove node if is from the ignorable namespace, no need to look at its childs anymore
-            if (node->getPrefix() != nullptr &&
-                (XMLString::compareString(node->getPrefix(), XercesPrefix.Get()) == 0))
-            {
-                DOMNode* parentNode = node->getParentNode();
-                ThrowErrorIfNot(Error::XmlError, parentNode, "We are trying to delete the root element!");
-                parentNode->removeChild(node);
-            }
-            else
-            {
-                // Add childs to queue
-                DOMNode* child = node->getFirstChild();
-                while (child)
-                {
-                    if (child->getNodeType() == DOMNode::ELEMENT_NODE)
-                    {
-                        nodeQueue.push(child);
-                    }
-                    child=child->getNextSibling();
-                }
-                // See if this node has attributes in the ignorable namespace
-                if (node->hasAttributes())
-                {
-                    // DOMElement::removeAttributeNS requires knowing the name of the attribute
-                    // so we have to get all of them and look one by one
-                    DOMNamedNodeMap* attributes = node->getAttributes();
-                    for (XMLSize_t i = 0; i < attributes->getLength(); i++)
-                    {
-                        DOMNode* attribute = attributes->item(i);
-                        if (attribute->getPrefix() != nullptr && 
-                        (XMLString::compareString(attribute->getPrefix(), XercesPrefix.Get()) == 0))
-                        {
-                            static_cast<DOMElement*>(node)->removeAttributeNode(static_cast<DOMAttr*>(attribute));
-                        }
-                    }
-                }
-            }
-            nodeQueue.pop();
+    // Elements and attributes of ignorable namespaces the schemas don't know about would fail validation. They are
+    // filtered out in a single non validating SAX pass that writes the rest of the document to stripped. The pass
+    // stops right after the root element if there's nothing to filter, in which case this returns false and the
+    // original document can be used as is.
+    bool StripIgnorableNamespaces(const InputSource& source, const NamespaceManager& namespaces, std::vector<XMLByte>& stripped)
+    {
+        std::unique_ptr<XERCES_CPP_NAMESPACE::SAX2XMLReader> reader(XERCES_CPP_NAMESPACE::XMLReaderFactory::createXMLReader());
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgSAX2CoreNameSpaces, true);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgSAX2CoreNameSpacePrefixes, true); // report xmlns attributes
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgSAX2CoreValidation, false);
+        // Disable DTD and prevent XXE attacks.
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesLoadExternalDTD, false);
+
+        ParsingException errorHandler;
+        IgnorableNamespacesFilter filter(namespaces, stripped);
+        reader->setContentHandler(&filter);
+        reader->setErrorHandler(&errorHandler);
+
+        XERCES_CPP_NAMESPACE::XMLPScanToken token;
+        bool more = reader->parseFirst(source, token);
+        while (more && !filter.HasRoot())
+        {   more = reader->parseNext(token);
+        }
+        if (!filter.HasNamespacesToStrip())
+        {
+            reader->parseReset(token);
+            stripped.clear();
+            return false;
         }
+        while (more)
+        {   more = reader->parseNext(token);
+        }
+        return true;
     }
 
     void FindChildElements(std::string xpath, DOMElement* root, std::list<DOMElement*>& list)
@@ -637,29 +1022,89 @@ protected:
     }
 
     IMsixFactory* m_factory;
+    ArenaMemoryManager m_memoryManager; // must outlive the parser
     std::unique_ptr<XERCES_CPP_NAMESPACE::XercesDOMParser> m_parser;
+    std::unique_ptr<XercesDocument> m_document; // released before the parser that owns the document
     ComPtr<IStream> m_stream;
 };
 
-class XercesFactory final : public ComClass<XercesFactory, IXmlFactory>
+class XercesFactory final : public ComClass<XercesFactory, IXmlFactory, IXmlStreamFactory>
 {
 public:
-    XercesFactory(IMsixFactory* factory) : m_factory(factory)
+    XercesFactory(IMsixFactory* factory) : m_factory(factory), m_grammars(SchemaGrammars::Get())
     {
         XERCES_CPP_NAMESPACE::XMLPlatformUtils::Initialize();
+        m_xpathCache = std::make_unique<XPathCache>();
     }
 
     ~XercesFactory()
     {
+        m_xpathCache.reset();
         XERCES_CPP_NAMESPACE::XMLPlatformUtils::Terminate();
     }
 
     ComPtr<IXmlDom> CreateDomFromStream(XmlContentType footPrintType, const ComPtr<IStream>& stream) override
     {
-        return ComPtr<IXmlDom>::Make<XercesDom>(m_factory, stream, footPrintType);
+        return ComPtr<IXmlDom>::Make<XercesDom>(m_factory, stream, footPrintType, m_grammars.GetPool(m_factory, footPrintType), m_xpathCache.get());
     }
+
+    // IXmlStreamFactory
+    bool ParseStream(XmlContentType footPrintType, const ComPtr<IStream>& stream, IXmlStreamHandler& handler) override
+    {
+        Parse(footPrintType, stream, m_grammars.GetPool(m_factory, footPrintType), handler);
+        return true;
+    }
+
+    bool ScanStream(XmlContentType footPrintType, const ComPtr<IStream>& stream, IXmlStreamHandler& handler) override
+    {
+        Parse(footPrintType, stream, nullptr, handler);
+        return true;
+    }
+
 protected:
-    IMsixFactory* m_factory;
+    // Without a grammar pool the document is only checked for being well formed, up to where the handler stops.
+    void Parse(XmlContentType footPrintType, const ComPtr<IStream>& stream, XERCES_CPP_NAMESPACE::XMLGrammarPool* grammarPool, IXmlStreamHandler& handler)
+    {
+        LARGE_INTEGER start = { 0 };
+        ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::START, nullptr));
+        StreamInputSource source(stream);
+        auto reader = std::make_unique<XERCES_CPP_NAMESPACE::SAX2XMLReaderImpl>(XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager, grammarPool);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgSAX2CoreNameSpaces, true);
+        // Disable DTD and prevent XXE attacks.
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesLoadExternalDTD, false);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesSkipDTDValidation, true);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgSAX2CoreValidation, (grammarPool != nullptr));
+        // Schema processing is on by default for SAX2 and would look for the grammars of the namespaces it sees.
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesSchema, (grammarPool != nullptr));
+        if (grammarPool != nullptr)
+        {
+            reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesDynamic, false);
+            reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesSchemaFullChecking, true);
+            reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesUseCachedGrammarInParse, true);
+        }
+
+        ParsingException errorHandler;
+        MsixEntityResolver entityResolver(m_factory, s_xmlNamespaces[static_cast<std::uint8_t>(footPrintType)]);
+        XercesStreamHandler contentHandler(handler);
+        reader->setErrorHandler(&errorHandler);
+        reader->setXMLEntityResolver(&entityResolver);
+        reader->setContentHandler(&contentHandler);
+
+        XERCES_CPP_NAMESPACE::XMLPScanToken token;
+        bool more = reader->parseFirst(source, token);
+        while (more && !contentHandler.IsStopped())
+        {   more = reader->parseNext(token);
+        }
+        if (more)
+        {   reader->parseReset(token);
+        }
+        // move the underlying stream back to the beginning.
+        ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::START, nullptr));
+    }
+
+    IMsixFactory*   m_factory;
+    SchemaGrammars& m_grammars;
+    std::unique_ptr<XPathCache> m_xpathCache;
 };
 
 ComPtr<IXmlFactory> CreateXmlFactory(IMsixFactory* factory) { return ComPtr<IXmlFactory>::Make<XercesFactory>(factory); }
@@ -78,9 +78,7 @@ namespace MSIX {
 
     AppxManifestObject::AppxManifestObject(IMsixFactory* factory, const ComPtr<IStream>& stream) : m_factory(factory), m_stream(stream)
     {
-        ComPtr<IXmlFactory> xmlFactory;
-        ThrowHrIfFailed(m_factory->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));
-        m_dom = xmlFactory->CreateDomFromStream(XmlContentType::AppxManifestXml, stream);
+        m_dom = CreateDom();
 
 #if VALIDATING
         AppxManifestValidation::ValidateManifest(m_dom.Get());
@@ -123,6 +121,19 @@ namespace MSIX {
         });
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Dependencies_TargetDeviceFamily, visitorTDF);
         ThrowErrorIf(Error::AppxManifestSemanticError, m_platform == MSIX_PLATFORM_NONE , "Couldn't find TargetDeviceFamily element in AppxManifest.xml");
+
+        // Everything the getters return is read once, after this the DOM is only needed for GetDocumentElement.
+        ParseProperties();
+        ParsePackageDependencies();
+        ParseResources();
+        ParseApplications();
+        ParseMainPackageDependencies();
+        ParseCapabilities();
+
+        if (m_factory->GetValidationOptions() & MSIX_VALIDATION_OPTION_RELEASEMANIFESTDOM)
+        {
+            m_dom = nullptr;
+        }
     }
 
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetPackageId(IAppxManifestPackageId **packageId) noexcept try
@@ -136,7 +147,138 @@ namespace MSIX {
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetProperties(IAppxManifestProperties **packageProperties) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (packageProperties == nullptr || *packageProperties != nullptr), "bad pointer");
+        auto properties = m_properties;
+        *packageProperties = properties.Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetPackageDependencies(IAppxManifestPackageDependenciesEnumerator **dependencies) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (dependencies == nullptr || *dependencies != nullptr), "bad pointer");
+        *dependencies = ComPtr<IAppxManifestPackageDependenciesEnumerator>::
+            Make<EnumeratorCom<IAppxManifestPackageDependenciesEnumerator,IAppxManifestPackageDependency>>(m_packageDependencies).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetCapabilities(APPX_CAPABILITIES *capabilities) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (capabilities == nullptr), "bad pointer");
+
+        APPX_CAPABILITIES appxCapabilities = static_cast<APPX_CAPABILITIES>(0);
+        auto capabilitiesNames = GetCapabilities(APPX_CAPABILITY_CLASS_GENERAL);
+        for (const auto& capability : capabilitiesNames)
+        {
+            const auto& capabilityEntry = std::find(std::begin(capabilitiesList), std::end(capabilitiesList), capability.c_str());
+            // Don't fail if not found as it can be custom capability or from a different namespace.
+            if (capabilityEntry != std::end(capabilitiesList))
+            {
+                appxCapabilities = static_cast<APPX_CAPABILITIES>((appxCapabilities) | (*capabilityEntry).value);
+            }
+        }
+        *capabilities = appxCapabilities;
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetResources(IAppxManifestResourcesEnumerator **resources) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (resources == nullptr || *resources != nullptr), "bad pointer");
+        *resources = ComPtr<IAppxManifestResourcesEnumerator>::Make<EnumeratorString<IAppxManifestResourcesEnumerator, IAppxManifestResourcesEnumeratorUtf8>>(m_factory.Get(), m_resources).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetDeviceCapabilities(IAppxManifestDeviceCapabilitiesEnumerator **deviceCapabilities) noexcept
+    {
+        return static_cast<HRESULT>(Error::NotImplemented);
+    }
+
+    // This method became deprecated as of Windows 8.1, use GetTargetDeviceFamilies instead.
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetPrerequisite(LPCWSTR name, UINT64 *value) noexcept
+    {
+        return static_cast<HRESULT>(Error::NotImplemented);
+    }
+
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetApplications(IAppxManifestApplicationsEnumerator **applications) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (applications == nullptr || *applications != nullptr), "bad pointer");
+        *applications = ComPtr<IAppxManifestApplicationsEnumerator>::
+            Make<EnumeratorCom<IAppxManifestApplicationsEnumerator,IAppxManifestApplication>>(m_applications).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetStream(IStream **manifestStream) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (manifestStream == nullptr || *manifestStream != nullptr), "bad pointer");
+        auto stream = m_stream;
+        *manifestStream = stream.Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    // IAppxManifestReader2
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetQualifiedResources(IAppxManifestQualifiedResourcesEnumerator **resources) noexcept
+    {
+        return static_cast<HRESULT>(Error::NotImplemented);
+    }
+
+    // IAppxManifestReader3
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetCapabilitiesByCapabilityClass(
+        APPX_CAPABILITY_CLASS_TYPE capabilityClass,
+        IAppxManifestCapabilitiesEnumerator **capabilities) noexcept
+    {
+        ThrowErrorIf(Error::InvalidParameter, (capabilities == nullptr), "bad pointer");
+
+        *capabilities = nullptr;
+        auto capabilitiesNames = GetCapabilities(capabilityClass);
+        *capabilities = ComPtr<IAppxManifestCapabilitiesEnumerator>::Make<EnumeratorString<IAppxManifestCapabilitiesEnumerator, IAppxManifestCapabilitiesEnumeratorUtf8>>(m_factory.Get(), capabilitiesNames).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    }
+
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetTargetDeviceFamilies(IAppxManifestTargetDeviceFamiliesEnumerator **targetDeviceFamilies) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (targetDeviceFamilies == nullptr || *targetDeviceFamilies != nullptr), "bad pointer");
+        *targetDeviceFamilies = ComPtr<IAppxManifestTargetDeviceFamiliesEnumerator>::
+            Make<EnumeratorCom<IAppxManifestTargetDeviceFamiliesEnumerator, IAppxManifestTargetDeviceFamily>>(m_tdf).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    // IAppxManifestReader4
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetOptionalPackageInfo(IAppxManifestOptionalPackageInfo **optionalPackageInfo) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (optionalPackageInfo == nullptr || *optionalPackageInfo != nullptr), "bad pointer.");
+        auto info = m_optionalPackageInfo;
+        *optionalPackageInfo = info.Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    // IAppxManifestReader5
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetMainPackageDependencies(IAppxManifestMainPackageDependenciesEnumerator **mainPackageDependencies) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (mainPackageDependencies == nullptr || *mainPackageDependencies != nullptr), "bad pointer.");
+        *mainPackageDependencies = ComPtr<IAppxManifestMainPackageDependenciesEnumerator>::
+            Make<EnumeratorCom<IAppxManifestMainPackageDependenciesEnumerator, IAppxManifestMainPackageDependency>>(m_mainPackageDependencies).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    // IMsixDocumentElement
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetDocumentElement(IMsixElement** documentElement) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (documentElement == nullptr || *documentElement != nullptr), "bad pointer");
+        if (!m_dom)
+        {   // The DOM was released after reading the manifest, parse it again and keep it this time.
+            m_dom = CreateDom();
+        }
+        *documentElement = m_dom->GetDocument().As<IMsixElement>().Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    ComPtr<IXmlDom> AppxManifestObject::CreateDom()
+    {
+        ComPtr<IXmlFactory> xmlFactory;
+        ThrowHrIfFailed(m_factory->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));
+        return xmlFactory->CreateDomFromStream(XmlContentType::AppxManifestXml, m_stream);
+    }
 
+    void AppxManifestObject::ParseProperties()
+    {
         // Parse elements in Properties element
         std::map<std::string, std::string> stringValues;
         std::map<std::string, bool> boolValues;
@@ -165,6 +307,7 @@ namespace MSIX {
                 _contextPropertiesString* contextProperties = reinterpret_cast<_contextPropertiesString*>(c);
                 auto value = node->GetText();
                 contextProperties->stringValues->insert(std::pair<std::string, std::string>(contextProperties->value, value));
+                contextProperties->wasFound = true;
                 return true;
             });
             context->self->m_dom->ForEachElementIn(propertiesNode, XmlQueryName::Child_Description, visitorString);
@@ -234,65 +377,30 @@ namespace MSIX {
             return true;
         });
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Properties, visitorProperties);
-        *packageProperties = ComPtr<IAppxManifestProperties>::Make<AppxManifestProperties>(
-            m_factory.Get(), std::move(stringValues), std::move(boolValues)).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
+        m_properties = ComPtr<IAppxManifestProperties>::Make<AppxManifestProperties>(m_factory.Get(), std::move(stringValues), std::move(boolValues));
+    }
 
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetPackageDependencies(IAppxManifestPackageDependenciesEnumerator **dependencies) noexcept try
+    void AppxManifestObject::ParsePackageDependencies()
     {
-        ThrowErrorIf(Error::InvalidParameter, (dependencies == nullptr || *dependencies != nullptr), "bad pointer");
-        std::vector<ComPtr<IAppxManifestPackageDependency>> packageDependencies;
-        struct _context
-        {
-            AppxManifestObject* self;
-            std::vector<ComPtr<IAppxManifestPackageDependency>>* packageDependencies;
-        };
-        _context context = { this, &packageDependencies};
-
         // Parse PackageDependency elements
-        XmlVisitor visitorDependencies(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& dependencyNode)->bool
+        XmlVisitor visitorDependencies(static_cast<void*>(this), [](void* s, const ComPtr<IXmlElement>& dependencyNode)->bool
         {
-            _context* context = reinterpret_cast<_context*>(c);
+            AppxManifestObject* self = reinterpret_cast<AppxManifestObject*>(s);
             auto min = dependencyNode->GetAttributeValue(XmlAttributeName::MinVersion);
             auto name = dependencyNode->GetAttributeValue(XmlAttributeName::Name);
             auto publisher = dependencyNode->GetAttributeValue(XmlAttributeName::Publisher);
             // TODO: get MaxMajorVersionTested if needed
-            auto dependency = ComPtr<IAppxManifestPackageDependency>::Make<AppxManifestPackageDependency>(context->self->m_factory.Get(), min, name, publisher);
-            context->packageDependencies->push_back(std::move(dependency));
+            auto dependency = ComPtr<IAppxManifestPackageDependency>::Make<AppxManifestPackageDependency>(self->m_factory.Get(), min, name, publisher);
+            self->m_packageDependencies.push_back(std::move(dependency));
             return true;
         });
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Dependencies_PackageDependency, visitorDependencies);
-        *dependencies = ComPtr<IAppxManifestPackageDependenciesEnumerator>::
-            Make<EnumeratorCom<IAppxManifestPackageDependenciesEnumerator,IAppxManifestPackageDependency>>(packageDependencies).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
-
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetCapabilities(APPX_CAPABILITIES *capabilities) noexcept try
-    {
-        ThrowErrorIf(Error::InvalidParameter, (capabilities == nullptr), "bad pointer");
-
-        APPX_CAPABILITIES appxCapabilities = static_cast<APPX_CAPABILITIES>(0);
-        auto capabilitiesNames = GetCapabilities(APPX_CAPABILITY_CLASS_GENERAL);
-        for (const auto& capability : capabilitiesNames)
-        {
-            const auto& capabilityEntry = std::find(std::begin(capabilitiesList), std::end(capabilitiesList), capability.c_str());
-            // Don't fail if not found as it can be custom capability or from a different namespace.
-            if (capabilityEntry != std::end(capabilitiesList))
-            {
-                appxCapabilities = static_cast<APPX_CAPABILITIES>((appxCapabilities) | (*capabilityEntry).value);
-            }
-        }
-        *capabilities = appxCapabilities;
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
+    }
 
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetResources(IAppxManifestResourcesEnumerator **resources) noexcept try
+    void AppxManifestObject::ParseResources()
     {
-        ThrowErrorIf(Error::InvalidParameter, (resources == nullptr || *resources != nullptr), "bad pointer");
         // Parse Resource elements.
-        std::vector<std::string> appxResources;
-        XmlVisitor visitorResource(static_cast<void*>(&appxResources), [](void* r, const ComPtr<IXmlElement>& resourceNode)->bool
+        XmlVisitor visitorResource(static_cast<void*>(&m_resources), [](void* r, const ComPtr<IXmlElement>& resourceNode)->bool
         {
             std::vector<std::string>* resources = reinterpret_cast<std::vector<std::string>*>(r);
             auto name = resourceNode->GetAttributeValue(XmlAttributeName::Language);
@@ -300,128 +408,32 @@ namespace MSIX {
             return true;
         });
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Resources_Resource, visitorResource);
-        *resources = ComPtr<IAppxManifestResourcesEnumerator>::Make<EnumeratorString<IAppxManifestResourcesEnumerator, IAppxManifestResourcesEnumeratorUtf8>>(m_factory.Get(), appxResources).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
-
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetDeviceCapabilities(IAppxManifestDeviceCapabilitiesEnumerator **deviceCapabilities) noexcept
-    {
-        return static_cast<HRESULT>(Error::NotImplemented);
-    }
-
-    // This method became deprecated as of Windows 8.1, use GetTargetDeviceFamilies instead.
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetPrerequisite(LPCWSTR name, UINT64 *value) noexcept
-    {
-        return static_cast<HRESULT>(Error::NotImplemented);
     }
 
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetApplications(IAppxManifestApplicationsEnumerator **applications) noexcept try
+    void AppxManifestObject::ParseApplications()
     {
-        ThrowErrorIf(Error::InvalidParameter, (applications == nullptr || *applications != nullptr), "bad pointer");
-
-        std::vector<ComPtr<IAppxManifestApplication>> apps;
-        struct _context
-        {
-            AppxManifestObject* self;
-            std::vector<ComPtr<IAppxManifestApplication>>* apps;
-        };
-        _context context = { this, &apps};
-
         // Parse Application elements
-        XmlVisitor visitorApplication(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& applicationNode)->bool
+        XmlVisitor visitorApplication(static_cast<void*>(this), [](void* s, const ComPtr<IXmlElement>& applicationNode)->bool
         {
-            _context* context = reinterpret_cast<_context*>(c);
+            AppxManifestObject* self = reinterpret_cast<AppxManifestObject*>(s);
             auto appId = applicationNode->GetAttributeValue(XmlAttributeName::Package_Applications_Application_Id);
-            auto packageIdInternal = context->self->m_packageId.As<IAppxManifestPackageIdInternal>();
+            auto packageIdInternal = self->m_packageId.As<IAppxManifestPackageIdInternal>();
             auto aumid = packageIdInternal->GetPackageFamilyName() + "!" + appId;
-            auto application = ComPtr<IAppxManifestApplication>::Make<AppxManifestApplication>(context->self->m_factory.Get(), aumid);
+            auto application = ComPtr<IAppxManifestApplication>::Make<AppxManifestApplication>(self->m_factory.Get(), aumid);
             // TODO: get other attributes from the Application element and store them a map in AppxManifestApplication
             // or make the AppxManifestApplication have a IXmlElement member to get attributes at will.
-            context->apps->push_back(std::move(application));
+            self->m_applications.push_back(std::move(application));
             return true;
         });
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Applications_Application, visitorApplication);
-        *applications = ComPtr<IAppxManifestApplicationsEnumerator>::
-            Make<EnumeratorCom<IAppxManifestApplicationsEnumerator,IAppxManifestApplication>>(apps).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
-
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetStream(IStream **manifestStream) noexcept try
-    {
-        ThrowErrorIf(Error::InvalidParameter, (manifestStream == nullptr || *manifestStream != nullptr), "bad pointer");
-        auto stream = m_stream;
-        *manifestStream = stream.Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
-
-    // IAppxManifestReader2
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetQualifiedResources(IAppxManifestQualifiedResourcesEnumerator **resources) noexcept
-    {
-        return static_cast<HRESULT>(Error::NotImplemented);
-    }
-
-    // IAppxManifestReader3
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetCapabilitiesByCapabilityClass(
-        APPX_CAPABILITY_CLASS_TYPE capabilityClass,
-        IAppxManifestCapabilitiesEnumerator **capabilities) noexcept
-    {
-        ThrowErrorIf(Error::InvalidParameter, (capabilities == nullptr), "bad pointer");
-
-        *capabilities = nullptr;
-        auto capabilitiesNames = GetCapabilities(capabilityClass);
-        *capabilities = ComPtr<IAppxManifestCapabilitiesEnumerator>::Make<EnumeratorString<IAppxManifestCapabilitiesEnumerator, IAppxManifestCapabilitiesEnumeratorUtf8>>(m_factory.Get(), capabilitiesNames).Detach();
-        return static_cast<HRESULT>(Error::OK);
     }
 
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetTargetDeviceFamilies(IAppxManifestTargetDeviceFamiliesEnumerator **targetDeviceFamilies) noexcept try
-    {
-        ThrowErrorIf(Error::InvalidParameter, (targetDeviceFamilies == nullptr || *targetDeviceFamilies != nullptr), "bad pointer");
-        *targetDeviceFamilies = ComPtr<IAppxManifestTargetDeviceFamiliesEnumerator>::
-            Make<EnumeratorCom<IAppxManifestTargetDeviceFamiliesEnumerator, IAppxManifestTargetDeviceFamily>>(m_tdf).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
-
-    // IAppxManifestReader4
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetOptionalPackageInfo(IAppxManifestOptionalPackageInfo **optionalPackageInfo) noexcept try
-    {
-        ThrowErrorIf(Error::InvalidParameter, (optionalPackageInfo == nullptr || *optionalPackageInfo != nullptr), "bad pointer.");
-
-        struct _context
-        {
-            std::string mainPackageName;
-        };
-        _context context = {};
-
-        // Parse MainPackageDependency elements
-        XmlVisitor visitorMainPackageDependencies(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& dependencyNode)->bool
-        {
-            _context* context = reinterpret_cast<_context*>(c);
-            auto name = dependencyNode->GetAttributeValue(XmlAttributeName::Name);
-            context->mainPackageName = name;
-            return false;
-        });
-        m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Dependencies_MainPackageDependency, visitorMainPackageDependencies);
-        *optionalPackageInfo = ComPtr<IAppxManifestOptionalPackageInfo>::Make<AppxManifestOptionalPackageInfo>(this->m_factory.Get(), context.mainPackageName).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
-
-    // IAppxManifestReader5
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetMainPackageDependencies(IAppxManifestMainPackageDependenciesEnumerator **mainPackageDependencies) noexcept try
+    void AppxManifestObject::ParseMainPackageDependencies()
     {
-        ThrowErrorIf(Error::InvalidParameter, (mainPackageDependencies == nullptr || *mainPackageDependencies != nullptr), "bad pointer.");
-        std::vector<ComPtr<IAppxManifestMainPackageDependency>> packageDependencies;
-
-        struct _context
-        {
-            AppxManifestObject* self;
-            std::vector<ComPtr<IAppxManifestMainPackageDependency>>* packageDependencies;
-        };
-        _context context = { this, &packageDependencies };
-
         // Parse MainPackageDependency elements
-        XmlVisitor visitorMainPackageDependencies(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& dependencyNode)->bool
+        XmlVisitor visitorMainPackageDependencies(static_cast<void*>(this), [](void* s, const ComPtr<IXmlElement>& dependencyNode)->bool
         {
-            _context* context = reinterpret_cast<_context*>(c);
+            AppxManifestObject* self = reinterpret_cast<AppxManifestObject*>(s);
             auto name = dependencyNode->GetAttributeValue(XmlAttributeName::Name);
             auto publisher = dependencyNode->GetAttributeValue(XmlAttributeName::Publisher);
             std::string packageFamilyName;
@@ -430,31 +442,91 @@ namespace MSIX {
             // if no publisher for the main package dependency is specified, we default to the publisher of the optional package itself
             if (publisher.empty())
             {
-                auto packageIdInternal = context->self->m_packageId.As<IAppxManifestPackageIdInternal>();
+                auto packageIdInternal = self->m_packageId.As<IAppxManifestPackageIdInternal>();
                 publisher = packageIdInternal->GetPublisher();
             }
 
             publisherHash = ComputePublisherId(publisher);
             packageFamilyName = name + "_" + publisherHash;
 
-            auto dependency = ComPtr<IAppxManifestMainPackageDependency>::Make<AppxManifestMainPackageDependency>(context->self->m_factory.Get(), name, publisher, packageFamilyName);
-            context->packageDependencies->push_back(std::move(dependency));
+            // The package is an optional package of the first main package it depends on
+            if (!self->m_optionalPackageInfo)
+            {
+                self->m_optionalPackageInfo = ComPtr<IAppxManifestOptionalPackageInfo>::Make<AppxManifestOptionalPackageInfo>(self->m_factory.Get(), name);
+            }
+
+            auto dependency = ComPtr<IAppxManifestMainPackageDependency>::Make<AppxManifestMainPackageDependency>(self->m_factory.Get(), name, publisher, packageFamilyName);
+            self->m_mainPackageDependencies.push_back(std::move(dependency));
             return true;
         });
-
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Dependencies_MainPackageDependency, visitorMainPackageDependencies);
-        *mainPackageDependencies = ComPtr<IAppxManifestMainPackageDependenciesEnumerator>::
-            Make<EnumeratorCom<IAppxManifestMainPackageDependenciesEnumerator, IAppxManifestMainPackageDependency>>(packageDependencies).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
+        if (!m_optionalPackageInfo)
+        {
+            m_optionalPackageInfo = ComPtr<IAppxManifestOptionalPackageInfo>::Make<AppxManifestOptionalPackageInfo>(m_factory.Get(), "");
+        }
+    }
 
-    // IMsixDocumentElement
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetDocumentElement(IMsixElement** documentElement) noexcept try
+    void AppxManifestObject::ParseCapabilities()
     {
-        ThrowErrorIf(Error::InvalidParameter, (documentElement == nullptr || *documentElement != nullptr), "bad pointer");
-        *documentElement = m_dom->GetDocument().As<IMsixElement>().Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
+        // Parse Capability elements.
+        XmlVisitor visitorCapabilities(static_cast<void*>(this), [](void* s, const ComPtr<IXmlElement>& capabilitiesNode)->bool
+        {
+            AppxManifestObject* self = reinterpret_cast<AppxManifestObject*>(s);
+            std::string prefix = capabilitiesNode->GetPrefix();
+            auto name = capabilitiesNode->GetAttributeValue(XmlAttributeName::Name);
+
+            static std::array<std::string, 11> generalCapabilities = 
+            {
+                "foundation",
+                "uap",
+                "win10foundation",
+                "win10uap",
+                "uap2",
+                "uap3",
+                "uap4",
+                "uap6",
+                "uap7",
+                "win10mobile",
+                "", // If no prefix then default namespace for AppxManifest is win10foundation.
+            };
+
+            static std::array<std::string, 2> restrictedCapabilities = 
+            {
+                "rescap",
+                "win10rescap",
+            };
+
+            static std::array<std::string, 2> windowsCapabilities = 
+            {
+                "wincap",
+                "win10wincap",
+            };
+
+            if (std::find(generalCapabilities.begin(), generalCapabilities.end(), prefix) != generalCapabilities.end())
+            {
+                self->m_capabilities.emplace_back(APPX_CAPABILITY_CLASS_GENERAL, std::move(name));
+            }
+            else if (std::find(restrictedCapabilities.begin(), restrictedCapabilities.end(), prefix) != restrictedCapabilities.end())
+            {
+                self->m_capabilities.emplace_back(APPX_CAPABILITY_CLASS_RESTRICTED, std::move(name));
+            }
+            else if (std::find(windowsCapabilities.begin(), windowsCapabilities.end(), prefix) != windowsCapabilities.end())
+            {
+                self->m_capabilities.emplace_back(APPX_CAPABILITY_CLASS_WINDOWS, std::move(name));
+            }
+            return true;
+        });
+        m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Capabilities_Capability, visitorCapabilities);
+
+        XmlVisitor visitorCustomCapabilities(static_cast<void*>(&m_customCapabilities), [](void* c, const ComPtr<IXmlElement>& capabilitiesNode)->bool
+        {
+            std::vector<std::string>* customCapabilities = reinterpret_cast<std::vector<std::string>*>(c);
+            auto name = capabilitiesNode->GetAttributeValue(XmlAttributeName::Name);
+            customCapabilities->push_back(std::move(name));
+            return true;
+        });
+        m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Capabilities_CustomCapability, visitorCustomCapabilities);
+    }
 
     // Helper to get capabilities from the manifest
     std::vector<std::string> AppxManifestObject::GetCapabilities(APPX_CAPABILITY_CLASS_TYPE capabilityClass)
@@ -462,101 +534,21 @@ namespace MSIX {
         ThrowErrorIf(Error::InvalidParameter, capabilityClass > APPX_CAPABILITY_CLASS_CUSTOM || capabilityClass < APPX_CAPABILITY_CLASS_DEFAULT, 
             "Invalid capability class.");
 
+        // The default class are the general capabilities
+        auto requested = (capabilityClass == APPX_CAPABILITY_CLASS_DEFAULT) ? APPX_CAPABILITY_CLASS_GENERAL : capabilityClass;
         std::vector<std::string> capabilitiesNames;
-        struct _context
+        for (const auto& capability : m_capabilities)
         {
-            APPX_CAPABILITY_CLASS_TYPE capabilityClass;
-            std::vector<std::string>& capabilitiesNames;
-        };
-        _context context = { capabilityClass, capabilitiesNames};
-
-        // Parse Capability elements.
-        if (capabilityClass != APPX_CAPABILITY_CLASS_CUSTOM)
-        {
-            XmlVisitor visitorCapabilities(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& capabilitiesNode)->bool
+            if (requested == APPX_CAPABILITY_CLASS_ALL || requested == capability.first)
             {
-                _context* context = reinterpret_cast<_context*>(c);
-                std::string prefix = capabilitiesNode->GetPrefix();
-                auto name = capabilitiesNode->GetAttributeValue(XmlAttributeName::Name);
-
-                static std::array<std::string, 11> generalCapabilities = 
-                {
-                    "foundation",
-                    "uap",
-                    "win10foundation",
-                    "win10uap",
-                    "uap2",
-                    "uap3",
-                    "uap4",
-                    "uap6",
-                    "uap7",
-                    "win10mobile",
-                    "", // If no prefix then default namespace for AppxManifest is win10foundation.
-                };
-
-                static std::array<std::string, 2> restrictedCapabilities = 
-                {
-                    "rescap",
-                    "win10rescap",
-                };
-
-                static std::array<std::string, 2> windowsCapabilities = 
-                {
-                    "wincap",
-                    "win10wincap",
-                };
-
-                if (context->capabilityClass == APPX_CAPABILITY_CLASS_GENERAL ||
-                    context->capabilityClass == APPX_CAPABILITY_CLASS_DEFAULT ||
-                    context->capabilityClass == APPX_CAPABILITY_CLASS_ALL)
-                {
-                    auto found = std::find(generalCapabilities.begin(), generalCapabilities.end(), prefix);
-                    if (found != generalCapabilities.end())
-                    {
-                        context->capabilitiesNames.push_back(name);
-                        return true;
-                    }
-                }
-
-                if (context->capabilityClass == APPX_CAPABILITY_CLASS_RESTRICTED ||
-                    context->capabilityClass == APPX_CAPABILITY_CLASS_ALL)
-                { 
-                    auto found = std::find(restrictedCapabilities.begin(), restrictedCapabilities.end(), prefix);
-                    if (found != restrictedCapabilities.end())
-                    {
-                        context->capabilitiesNames.push_back(name);
-                        return true;
-                    }
-                }
-
-                if (context->capabilityClass == APPX_CAPABILITY_CLASS_WINDOWS ||
-                    context->capabilityClass == APPX_CAPABILITY_CLASS_ALL)
-                {
-                    auto found = std::find(windowsCapabilities.begin(), windowsCapabilities.end(), prefix);
-                    if (found != windowsCapabilities.end())
-                    {
-                        context->capabilitiesNames.push_back(name);
-                        return true;
-                    }
-                }
-
-                return true;
-            });
-            m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Capabilities_Capability, visitorCapabilities);
+                capabilitiesNames.push_back(capability.second);
+            }
         }
 
         if (capabilityClass == APPX_CAPABILITY_CLASS_CUSTOM || capabilityClass == APPX_CAPABILITY_CLASS_ALL)
         {
-            XmlVisitor visitorCustomCapabilities(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& capabilitiesNode)->bool
-            {
-                _context* context = reinterpret_cast<_context*>(c);
-                auto name = capabilitiesNode->GetAttributeValue(XmlAttributeName::Name);
-                context->capabilitiesNames.push_back(name);
-                return true;
-            });
-            m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Capabilities_CustomCapability, visitorCustomCapabilities);
+            capabilitiesNames.insert(capabilitiesNames.end(), m_customCapabilities.begin(), m_customCapabilities.end());
         }
-
         return capabilitiesNames;
     }
 }
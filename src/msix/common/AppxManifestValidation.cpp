@@ -3,7 +3,8 @@
 //  See LICENSE file in the project root for full license information.
 //
 
-#include <regex>
+#include <algorithm>
+#include <cstdint>
 #include <string>
 
 #include "AppxManifestValidation.hpp"
@@ -17,117 +18,46 @@ namespace MSIX {
 
     namespace
     {
-        struct TargetAttribute
+        // What a single pass over the manifest found, used by the checks that depend on the package type.
+        struct ManifestState
         {
-            XmlQueryName ElementQuery;
-            XmlAttributeName AttributeName;
-        };
+            std::uint64_t present = 0;
+            bool isFramework = false;
+            bool isResource = false;
+            bool hasProcessorArchitecture = false;
 
-        struct TargetAttributeComparison
-        {
-            XmlQueryName ElementQuery;
-            XmlAttributeName FirstAttributeName;
-            XmlAttributeName SecondAttributeName;
+            void SetPresent(XmlQueryName query) { present |= (1ull << static_cast<std::uint8_t>(query)); }
+            bool IsPresent(XmlQueryName query) const { return (present & (1ull << static_cast<std::uint8_t>(query))) != 0; }
         };
 
-        bool GetPropertyAsBool(IXmlDom* manifest, XmlQueryName query)
-        {
-            bool result = false;
-            XmlVisitor visitor{ &result,
-                [](void* c, const MSIX::ComPtr<IXmlElement>& element)
-            {
-                *reinterpret_cast<bool*>(c) = (element->GetText() == "true");
-                return false;
-            }};
-            manifest->ForEachElementIn(query, visitor);
-            return result;
-        }
+        typedef void(*ElementCheck)(ManifestState&, const ComPtr<IXmlElement>&);
 
-        bool AreAnyPresent(IXmlDom* manifest, XmlQueryName query)
+        struct ElementRule
         {
-            bool result = false;
-            XmlVisitor visitor{ &result,
-                [](void* c, const MSIX::ComPtr<IXmlElement>& element)
-            {
-                *reinterpret_cast<bool*>(c) = true;
-                return false;
-            } };
-            manifest->ForEachElementIn(query, visitor);
-            return result;
-        }
-
-        bool AreAnyPresent(IXmlDom* manifest, XmlQueryName query, XmlAttributeName attribute)
-        {
-            struct context
-            {
-                bool result;
-                XmlAttributeName attribute;
-            };
-            context thisContext{ false, attribute };
-
-            XmlVisitor visitor{ &thisContext,
-                [](void* c, const MSIX::ComPtr<IXmlElement>& element)
-            {
-                context& thisContext = *reinterpret_cast<context*>(c);
-
-                std::string attributeValue = element->GetAttributeValue(thisContext.attribute);
-
-                if (!attributeValue.empty())
-                {
-                    thisContext.result = true;
-                    return false;
-                }
-
-                return true;
-            } };
-            manifest->ForEachElementIn(query, visitor);
-            return thisContext.result;
-        }
+            const char* Parent;     // local name of the parent, empty for children of the root element
+            const char* LocalName;
+            XmlQueryName Query;     // the query that would have found this element, recorded as present
+            ElementCheck Check;     // optional
+        };
 
-#pragma region ValidateIdentifiers
+#pragma region ElementChecks
 
-        void ValidateIdentifier(const TargetAttribute& target, const MSIX::ComPtr<IXmlElement>& element)
+        void ValidateIdentifier(const ComPtr<IXmlElement>& element, XmlAttributeName attribute)
         {
-            std::string attributeValue = element->GetAttributeValue(target.AttributeName);
+            std::string attributeValue = element->GetAttributeValue(attribute);
 
             if (!attributeValue.empty())
             {
                 ThrowErrorIf(Error::AppxManifestSemanticError, !AppxManifestValidation::IsIdentifierValid(attributeValue),
-                    (std::string("Invalid Identifier ") + GetAttributeNameStringUtf8(target.AttributeName) + ": " + attributeValue).c_str());
-            }
-        }
-
-        const TargetAttribute Identifiers[] = {
-            { XmlQueryName::Child_Identity, XmlAttributeName::Name },
-            { XmlQueryName::Child_Identity, XmlAttributeName::ResourceId },
-            { XmlQueryName::Package_Dependencies_PackageDependency, XmlAttributeName::Name },
-            { XmlQueryName::Package_Dependencies_MainPackageDependency, XmlAttributeName::Name },
-        };
-
-        // Validates that all identifiers throughout the manifest are valid.
-        void ValidateIdentifiers(IXmlDom* manifest)
-        {
-            auto CallValidateIdentifier = [](void* target, const MSIX::ComPtr<IXmlElement>& element)
-            {
-                ValidateIdentifier(*reinterpret_cast<TargetAttribute*>(target), element);
-                return true;
-            };
-
-            for (const auto& identifier : Identifiers)
-            {
-                XmlVisitor visitor{ &identifier, CallValidateIdentifier };
-                manifest->ForEachElementIn(identifier.ElementQuery, visitor);
+                    (std::string("Invalid Identifier ") + GetAttributeNameStringUtf8(attribute) + ": " + attributeValue).c_str());
             }
         }
 
-#pragma endregion
-
-#pragma region ValidateDependencies
-
-        void ValidateDependency(const TargetAttributeComparison& target, const MSIX::ComPtr<IXmlElement>& element)
+        // Validates that the dependency doesn't have an inverted version declaration (min > max).
+        void ValidateDependency(const ComPtr<IXmlElement>& element, XmlAttributeName minAttribute, XmlAttributeName maxAttribute)
         {
-            std::string minValue = element->GetAttributeValue(target.FirstAttributeName);
-            std::string maxValue = element->GetAttributeValue(target.SecondAttributeName);
+            std::string minValue = element->GetAttributeValue(minAttribute);
+            std::string maxValue = element->GetAttributeValue(maxAttribute);
 
             if (maxValue.empty())
             {
@@ -146,43 +76,107 @@ namespace MSIX {
             }
         }
 
-        const TargetAttributeComparison Dependencies[] = {
-            { XmlQueryName::Package_Dependencies_TargetDeviceFamily, XmlAttributeName::MinVersion, XmlAttributeName::Dependencies_Tdf_MaxVersionTested },
-            { XmlQueryName::Package_Dependencies_PackageDependency, XmlAttributeName::MinVersion, XmlAttributeName::MaxMajorVersionTested },
-        };
+        void CheckIdentity(ManifestState& state, const ComPtr<IXmlElement>& element)
+        {
+            ValidateIdentifier(element, XmlAttributeName::Name);
+            ValidateIdentifier(element, XmlAttributeName::ResourceId);
+            state.hasProcessorArchitecture = !element->GetAttributeValue(XmlAttributeName::Identity_ProcessorArchitecture).empty();
+        }
 
-        // Validates that the dependencies don't have inverted version declarations (min > max).
-        void ValidateDependencies(IXmlDom* manifest)
+        void CheckFramework(ManifestState& state, const ComPtr<IXmlElement>& element)
         {
-            auto CallValidateDependency = [](void* target, const MSIX::ComPtr<IXmlElement>& element)
+            if (!state.IsPresent(XmlQueryName::Package_Properties_Framework))
             {
-                ValidateDependency(*reinterpret_cast<TargetAttributeComparison*>(target), element);
-                return true;
-            };
+                state.isFramework = (element->GetText() == "true");
+            }
+        }
 
-            for (const auto& dependency : Dependencies)
+        void CheckResourcePackage(ManifestState& state, const ComPtr<IXmlElement>& element)
+        {
+            if (!state.IsPresent(XmlQueryName::Package_Properties_ResourcePackage))
             {
-                XmlVisitor visitor{ &dependency, CallValidateDependency };
-                manifest->ForEachElementIn(dependency.ElementQuery, visitor);
+                state.isResource = (element->GetText() == "true");
             }
         }
 
+        void CheckTargetDeviceFamily(ManifestState&, const ComPtr<IXmlElement>& element)
+        {
+            ValidateDependency(element, XmlAttributeName::MinVersion, XmlAttributeName::Dependencies_Tdf_MaxVersionTested);
+        }
+
+        void CheckPackageDependency(ManifestState&, const ComPtr<IXmlElement>& element)
+        {
+            ValidateIdentifier(element, XmlAttributeName::Name);
+            ValidateDependency(element, XmlAttributeName::MinVersion, XmlAttributeName::MaxMajorVersionTested);
+        }
+
+        void CheckMainPackageDependency(ManifestState&, const ComPtr<IXmlElement>& element)
+        {
+            ValidateIdentifier(element, XmlAttributeName::Name);
+        }
+
 #pragma endregion
 
-        const XmlQueryName InvalidFrameworkQueries[] = {
-            XmlQueryName::Package_Applications,
-            XmlQueryName::Package_Capabilities,
+        // The elements validation cares about, dispatched by local name. Children of the root element that are the
+        // parent of another rule are descended into, everything else is skipped without looking at its children.
+        const ElementRule ElementRules[] = {
+            { "",             "Identity",              XmlQueryName::Package_Identity,                           CheckIdentity },
+            { "",             "Applications",          XmlQueryName::Package_Applications,                       nullptr },
+            { "",             "Capabilities",          XmlQueryName::Package_Capabilities,                       nullptr },
+            { "",             "Extensions",            XmlQueryName::Package_Extensions,                         nullptr },
+            { "Properties",   "Framework",             XmlQueryName::Package_Properties_Framework,               CheckFramework },
+            { "Properties",   "ResourcePackage",       XmlQueryName::Package_Properties_ResourcePackage,         CheckResourcePackage },
+            { "Properties",   "SupportedUsers",        XmlQueryName::Package_Properties_SupportedUsers,          nullptr },
+            { "Dependencies", "TargetDeviceFamily",    XmlQueryName::Package_Dependencies_TargetDeviceFamily,    CheckTargetDeviceFamily },
+            { "Dependencies", "PackageDependency",     XmlQueryName::Package_Dependencies_PackageDependency,     CheckPackageDependency },
+            { "Dependencies", "MainPackageDependency", XmlQueryName::Package_Dependencies_MainPackageDependency, CheckMainPackageDependency },
         };
 
-        // Validates that certain elements are not defined in a framework package.
-        void ValidateFrameworkPackage(IXmlDom* manifest)
+        bool IsParentOfRule(const std::string& localName)
         {
-            for (const auto& query : InvalidFrameworkQueries)
+            return std::any_of(std::begin(ElementRules), std::end(ElementRules), [&](const ElementRule& rule)
+                { return localName == rule.Parent; });
+        }
+
+        // Dispatches the children of an element to the rules for that parent.
+        class ElementRuleHandler final : public IXmlChildHandler
+        {
+        public:
+            ElementRuleHandler(IXmlDomWalker* walker, ManifestState& state, const std::string& parent) :
+                m_walker(walker), m_state(state), m_parent(parent) {}
+
+            bool Child(const std::string& localName, const ComPtr<IXmlElement>& element) override
             {
-                ThrowErrorIf(Error::AppxManifestSemanticError, AreAnyPresent(manifest, query),
-                    (std::string("A framework package cannot contain ") + GetQueryStringUtf8(query)).c_str());
+                for (const auto& rule : ElementRules)
+                {
+                    if ((m_parent == rule.Parent) && (localName == rule.LocalName))
+                    {
+                        if (rule.Check != nullptr)
+                        {
+                            rule.Check(m_state, element);
+                        }
+                        m_state.SetPresent(rule.Query);
+                        break;
+                    }
+                }
+                if (m_parent.empty() && IsParentOfRule(localName))
+                {
+                    ElementRuleHandler children(m_walker, m_state, localName);
+                    m_walker->ForEachChildElement(element, children);
+                }
+                return true;
             }
-        }
+
+        protected:
+            IXmlDomWalker* m_walker;
+            ManifestState& m_state;
+            std::string m_parent;
+        };
+
+        const XmlQueryName InvalidFrameworkQueries[] = {
+            XmlQueryName::Package_Applications,
+            XmlQueryName::Package_Capabilities,
+        };
 
         const XmlQueryName InvalidResourceElementQueries[] = {
             XmlQueryName::Package_Applications,
@@ -192,80 +186,65 @@ namespace MSIX {
             XmlQueryName::Package_Dependencies_MainPackageDependency,
         };
 
-        const TargetAttribute InvalidResourceAttributeQueries[] = {
-            { XmlQueryName::Package_Identity, XmlAttributeName::Identity_ProcessorArchitecture },
-        };
-
-        // Validates that certain elements are not defined in a resource package.
-        void ValidateResourcePackage(IXmlDom* manifest)
-        {
-            for (const auto& query : InvalidResourceElementQueries)
-            {
-                ThrowErrorIf(Error::AppxManifestSemanticError, AreAnyPresent(manifest, query),
-                    (std::string("A resource package cannot contain ") + GetQueryStringUtf8(query)).c_str());
-            }
-
-            for (const auto& query : InvalidResourceAttributeQueries)
-            {
-                ThrowErrorIf(Error::AppxManifestSemanticError, AreAnyPresent(manifest, query.ElementQuery, query.AttributeName),
-                    (std::string("A resource package cannot contain ") + GetAttributeNameStringUtf8(query.AttributeName)).c_str());
-            }
-        }
-
         const XmlQueryName InvalidOptionalQueries[] = {
             XmlQueryName::Package_Capabilities,
             XmlQueryName::Package_Properties_SupportedUsers,
         };
 
-        // Validates an optional package for it's unique constraints.
-        void ValidateOptionalPackage(IXmlDom* manifest)
+        // Validates that there are not conflicting package types and that certain elements are not defined for the type.
+        void ValidatePackageType(const ManifestState& state)
         {
-            for (const auto& query : InvalidOptionalQueries)
-            {
-                ThrowErrorIf(Error::AppxManifestSemanticError, AreAnyPresent(manifest, query),
-                    (std::string("An optional package cannot contain ") + GetQueryStringUtf8(query)).c_str());
-            }
-
-            // TODO: Ensure lowest version is >= TH2... for Windows targets only
-
-            // TODO: Ensure that there are not duplcate mainpackagedependencies
-        }
-
-        // Validates that there are not conflicting package types and then does specific validation for the type.
-        void ValidatePackageType(IXmlDom* manifest)
-        {
-            bool isFramework = GetPropertyAsBool(manifest, XmlQueryName::Package_Properties_Framework);
-            bool isResource = GetPropertyAsBool(manifest, XmlQueryName::Package_Properties_ResourcePackage);
-
-            ThrowErrorIf(Error::AppxManifestSemanticError, isFramework && isResource,
+            ThrowErrorIf(Error::AppxManifestSemanticError, state.isFramework && state.isResource,
                 "Package cannot be both a framework and a resource");
 
-            bool isOptional = AreAnyPresent(manifest, XmlQueryName::Package_Dependencies_MainPackageDependency);
+            bool isOptional = state.IsPresent(XmlQueryName::Package_Dependencies_MainPackageDependency);
 
-            ThrowErrorIf(Error::AppxManifestSemanticError, isOptional && (isFramework || isResource),
+            ThrowErrorIf(Error::AppxManifestSemanticError, isOptional && (state.isFramework || state.isResource),
                 "Package cannot be optional if it is a framework or resource");
 
-            if (isFramework)
+            if (state.isFramework)
             {
-                ValidateFrameworkPackage(manifest);
+                for (const auto& query : InvalidFrameworkQueries)
+                {
+                    ThrowErrorIf(Error::AppxManifestSemanticError, state.IsPresent(query),
+                        (std::string("A framework package cannot contain ") + GetQueryStringUtf8(query)).c_str());
+                }
             }
-            else if (isResource)
+            else if (state.isResource)
             {
-                ValidateResourcePackage(manifest);
+                for (const auto& query : InvalidResourceElementQueries)
+                {
+                    ThrowErrorIf(Error::AppxManifestSemanticError, state.IsPresent(query),
+                        (std::string("A resource package cannot contain ") + GetQueryStringUtf8(query)).c_str());
+                }
+                ThrowErrorIf(Error::AppxManifestSemanticError, state.hasProcessorArchitecture,
+                    (std::string("A resource package cannot contain ") + GetAttributeNameStringUtf8(XmlAttributeName::Identity_ProcessorArchitecture)).c_str());
             }
             else if (isOptional)
             {
-                ValidateOptionalPackage(manifest);
+                for (const auto& query : InvalidOptionalQueries)
+                {
+                    ThrowErrorIf(Error::AppxManifestSemanticError, state.IsPresent(query),
+                        (std::string("An optional package cannot contain ") + GetQueryStringUtf8(query)).c_str());
+                }
+
+                // TODO: Ensure lowest version is >= TH2... for Windows targets only
+
+                // TODO: Ensure that there are not duplcate mainpackagedependencies
             }
         }
+
+        bool IsIdentifierCharacter(char c)
+        {
+            return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')) || (c == '.') || (c == '-');
+        }
     }
 
     bool AppxManifestValidation::IsIdentifierValid(const std::string& identifier)
     {
 #if !VALIDATING
         // If the schema didn't check for us, do it now.
-        std::regex e("[a-zA-Z0-9\\.\\-]+"); // valid characters
-        if (!std::regex_match(identifier, e))
+        if (identifier.empty() || !std::all_of(identifier.begin(), identifier.end(), IsIdentifierCharacter))
         {
             return false;
         }
@@ -273,11 +252,18 @@ namespace MSIX {
         return FileNameValidation::IsIdentifierValid(identifier);
     }
 
+    // Walks the root element and the children of the elements in ElementRules once, checking identifiers and
+    // dependency versions as they are seen, then validates the package type from what was found.
     void AppxManifestValidation::ValidateManifest(IXmlDom* manifest)
     {
-        ValidateIdentifiers(manifest);
-        ValidateDependencies(manifest);
-        ValidatePackageType(manifest);
+        ComPtr<IXmlDomWalker> walker;
+        ThrowHrIfFailed(manifest->QueryInterface(UuidOfImpl<IXmlDomWalker>::iid, reinterpret_cast<void**>(&walker)));
+
+        ManifestState state;
+        ElementRuleHandler handler(walker.Get(), state, std::string());
+        walker->ForEachChildElement(manifest->GetDocument(), handler);
+
+        ValidatePackageType(state);
 
         //TODO
         //ValidateProperties(manifest);
@@ -0,0 +1,71 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "CompressionObjectPool.hpp"
+#include "Exceptions.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace MSIX {
+
+    CompressionObjectPool::CompressionObjectPool(CompressionOperation operation, std::size_t capacity) :
+        m_operation(operation), m_capacity(capacity)
+    {
+    }
+
+    CompressionObjectPool::~CompressionObjectPool()
+    {
+        for (auto& entry : m_objects)
+        {   entry.object->Cleanup();
+        }
+    }
+
+    std::unique_ptr<ICompressionObject> CompressionObjectPool::Acquire(int level)
+    {
+        auto error = (m_operation == CompressionOperation::Inflate) ? Error::InflateInitialize : Error::DeflateInitialize;
+        std::unique_ptr<ICompressionObject> object;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto entry = std::find_if(m_objects.rbegin(), m_objects.rend(), [level](const Entry& e) { return e.level == level; });
+            if (entry != m_objects.rend())
+            {
+                object = std::move(entry->object);
+                m_objects.erase(std::next(entry).base());
+            }
+        }
+        if (object)
+        {
+            if (object->Reset() == CompressionStatus::Ok)
+            {   return object;
+            }
+            // Start over with a new one
+            object->Cleanup();
+        }
+        object = CreateCompressionObject();
+        ThrowErrorIfNot(error, (object->Initialize(m_operation, level) == CompressionStatus::Ok), "Error initializing compression object");
+        return object;
+    }
+
+    void CompressionObjectPool::Release(std::unique_ptr<ICompressionObject>&& object, int level)
+    {
+        if (!object) { return; }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_objects.size() < m_capacity)
+            {
+                m_objects.push_back(Entry{ level, std::move(object) });
+                return;
+            }
+        }
+        object->Cleanup();
+    }
+
+    CompressionObjectPool& CompressionObjectPool::Inflate()
+    {
+        // Inflate state is small, keep enough for every thread extracting files.
+        static CompressionObjectPool pool(CompressionOperation::Inflate, std::max(4u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+}
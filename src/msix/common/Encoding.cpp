@@ -7,10 +7,24 @@
 #include <algorithm>
 #include <vector>
 #include <array>
+#include <cstring>
 
 #include "Encoding.hpp"
 #include "Exceptions.hpp"
 #include "UnicodeConversion.hpp"
+#include "Crypto.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define MSIX_BASE64_SSSE3
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define MSIX_BASE64_TARGET
+    #else
+        #include <cpuid.h>
+        #define MSIX_BASE64_TARGET __attribute__((target("ssse3")))
+    #endif
+#endif
 
 namespace MSIX { namespace Encoding {
 
@@ -416,36 +430,192 @@ namespace MSIX { namespace Encoding {
         /* 112-127 */   41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
     };
 
-    std::vector<std::uint8_t> GetBase64DecodedValue(const std::string& value)
-    {
-        std::vector<std::uint8_t> result;
+    const char base64EncoderRing[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-        ThrowErrorIfNot(Error::InvalidParameter, (0 == (value.length() % 4)), "invalid base64 encoding");
-        for(std::size_t index=0; index < value.length(); index += 4)
+    namespace {
+
+        // Decodes a group of four characters into up to three bytes and returns how many.
+        std::size_t DecodeQuad(const char* value, std::uint8_t* out)
         {
-            ThrowErrorIf(Error::InvalidParameter,(
-            (value[index+0] | value[index+1] | value[index+2] | value[index+3]) >= 128
-            ), "invalid base64 encoding");
+            auto c1 = static_cast<std::uint8_t>(value[0]);
+            auto c2 = static_cast<std::uint8_t>(value[1]);
+            auto c3 = static_cast<std::uint8_t>(value[2]);
+            auto c4 = static_cast<std::uint8_t>(value[3]);
+            ThrowErrorIf(Error::InvalidParameter, ((c1 | c2 | c3 | c4) >= 128), "invalid base64 encoding");
 
-            auto v1 = base64DecoderRing[value[index+0]];
-            auto v2 = base64DecoderRing[value[index+1]];
-            auto v3 = base64DecoderRing[value[index+2]];
-            auto v4 = base64DecoderRing[value[index+3]];
+            auto v1 = base64DecoderRing[c1];
+            auto v2 = base64DecoderRing[c2];
+            auto v3 = base64DecoderRing[c3];
+            auto v4 = base64DecoderRing[c4];
 
             ThrowErrorIf(Error::InvalidParameter,(((v1 | v2) >= 64) || ((v3 | v4) == 0xFF)), "first two chars of a four char base64 sequence can't be ==, and must be valid");
             ThrowErrorIf(Error::InvalidParameter,(v3 == 64 && v4 != 64), "if the third char is = then the fourth char must be =");
             std::size_t byteCount = (v4 != 64 ? 3 : (v3 != 64 ? 2 : 1));
-            result.push_back(static_cast<std::uint8_t>(((v1 << 2) | ((v2 >> 4) & 0x03))));
+            out[0] = static_cast<std::uint8_t>(((v1 << 2) | ((v2 >> 4) & 0x03)));
             if (byteCount >1)
             {
-                result.push_back(static_cast<std::uint8_t>(((v2 << 4) | ((v3 >> 2) & 0x0F)) & 0xFF));
+                out[1] = static_cast<std::uint8_t>(((v2 << 4) | ((v3 >> 2) & 0x0F)) & 0xFF);
                 if (byteCount >2)
                 {
-                    result.push_back(static_cast<std::uint8_t>(((v3 << 6) | ((v4 >> 0) & 0x3F)) & 0xFF));
+                    out[2] = static_cast<std::uint8_t>(((v3 << 6) | ((v4 >> 0) & 0x3F)) & 0xFF);
                 }
             }
+            return byteCount;
+        }
+
+#if defined(MSIX_BASE64_SSSE3)
+        bool HasSsse3()
+        {
+            static const bool supported = []()
+            {
+            #if defined(_MSC_VER) && !defined(__clang__)
+                int info[4];
+                __cpuid(info, 1);
+                return ((info[2] & (1 << 9)) != 0);
+            #else
+                unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+                return (__get_cpuid(1, &eax, &ebx, &ecx, &edx) != 0) && ((ecx & (1u << 9)) != 0);
+            #endif
+            }();
+            return supported;
+        }
+
+        // Translates and packs 16 characters at a time into 12 bytes. Each character is validated with a
+        // lookup by its low nibble of the set of high nibbles that are valid with it. Stops at the first
+        // group with anything else, including padding, and returns how many characters were consumed.
+        MSIX_BASE64_TARGET std::size_t DecodeGroups(const char* value, std::size_t length, std::uint8_t* out)
+        {
+            const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+            const __m128i shiftLut = _mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m128i validLut = _mm_setr_epi8(
+                static_cast<char>(0xA8), static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+                static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+                static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF0), 0x54, 0x50, 0x50, 0x50, 0x54);
+            const __m128i bitLut = _mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, static_cast<char>(0x80), 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+            std::size_t consumed = 0;
+            for (; consumed + 16 <= length; consumed += 16)
+            {
+                __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(value + consumed));
+                __m128i high = _mm_and_si128(_mm_srli_epi32(chars, 4), nibbleMask);
+                __m128i low = _mm_and_si128(chars, nibbleMask);
+                __m128i valid = _mm_and_si128(_mm_shuffle_epi8(validLut, low), _mm_shuffle_epi8(bitLut, high));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(valid, _mm_setzero_si128())) != 0) { break; }
+
+                // '+' and '/' share the high nibble, '/' needs 3 less.
+                __m128i shift = _mm_add_epi8(_mm_shuffle_epi8(shiftLut, high),
+                    _mm_and_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('/')), _mm_set1_epi8(-3)));
+                __m128i values = _mm_add_epi8(chars, shift);
+                __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+                merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+                merged = _mm_shuffle_epi8(merged, pack);
+                auto target = out + (consumed / 4) * 3;
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(target), merged);
+                std::uint32_t last = static_cast<std::uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(merged, 8)));
+                std::memcpy(target + 8, &last, sizeof(last));
+            }
+            return consumed;
+        }
+
+        // Spreads 12 bytes into 16 six bit indexes and translates them. Reads 16 bytes to do it, so the
+        // last 4 bytes of the input are always left to the caller. Returns how many bytes were consumed.
+        MSIX_BASE64_TARGET std::size_t EncodeGroups(const std::uint8_t* data, std::size_t size, char* out)
+        {
+            const __m128i spread = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+            const __m128i shiftLut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+            std::size_t consumed = 0;
+            for (; consumed + 16 <= size; consumed += 12)
+            {
+                __m128i bytes = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + consumed)), spread);
+                __m128i high = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+                __m128i low = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+                __m128i indexes = _mm_or_si128(high, low);
+
+                // Map 0-25 to 13, 26-51 to 0 and 52-63 to 1-12, then look up the offset to the character.
+                __m128i range = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+                range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indexes), _mm_set1_epi8(13)));
+                __m128i chars = _mm_add_epi8(_mm_shuffle_epi8(shiftLut, range), indexes);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (consumed / 3) * 4), chars);
+            }
+            return consumed;
+        }
+#endif
+
+        std::size_t DecodeWithSimd(const char* value, std::size_t length, std::uint8_t* out)
+        {
+        #if defined(MSIX_BASE64_SSSE3)
+            return HasSsse3() ? DecodeGroups(value, length, out) : 0;
+        #else
+            return 0;
+        #endif
+        }
+
+        std::size_t EncodeWithSimd(const std::uint8_t* data, std::size_t size, char* out)
+        {
+        #if defined(MSIX_BASE64_SSSE3)
+            return HasSsse3() ? EncodeGroups(data, size, out) : 0;
+        #else
+            return 0;
+        #endif
+        }
+    }
+
+    void GetBase64DecodedValue(const char* value, std::size_t length, std::uint8_t* out, std::size_t size)
+    {
+        ThrowErrorIfNot(Error::InvalidParameter, (0 == (length % 4)), "invalid base64 encoding");
+        std::size_t padding = 0;
+        if (length != 0)
+        {   padding = (value[length - 1] == '=') ? ((value[length - 2] == '=') ? 2 : 1) : 0;
+        }
+        ThrowErrorIfNot(Error::InvalidParameter, (((length / 4) * 3) - padding == size), "unexpected base64 decoded size");
+        if (length == 0) { return; }
+
+        // Everything except the last group, the only one that may be padded, can go through the vector path.
+        std::size_t index = DecodeWithSimd(value, length - 4, out);
+        for (; index < length - 4; index += 4)
+        {
+            ThrowErrorIf(Error::InvalidParameter, (DecodeQuad(value + index, out + (index / 4) * 3) != 3), "invalid base64 padding");
         }
+        std::uint8_t last[3];
+        std::size_t lastCount = DecodeQuad(value + index, last);
+        std::memcpy(out + (index / 4) * 3, last, lastCount);
+    }
+
+    std::vector<std::uint8_t> GetBase64DecodedValue(const std::string& value)
+    {
+        ThrowErrorIfNot(Error::InvalidParameter, (0 == (value.length() % 4)), "invalid base64 encoding");
+        std::size_t size = (value.length() / 4) * 3;
+        if (size != 0)
+        {   size -= (value.back() == '=') ? ((value[value.length() - 2] == '=') ? 2 : 1) : 0;
+        }
+        std::vector<std::uint8_t> result(size);
+        GetBase64DecodedValue(value.data(), value.length(), result.data(), result.size());
         return result;
     }
 
-} /*Encoding */ } /* MSIX */
+    std::string GetBase64EncodedValue(const std::uint8_t* data, std::size_t size)
+    {
+        std::string result(((size + 2) / 3) * 4, '=');
+        std::size_t index = EncodeWithSimd(data, size, &result[0]);
+        for (; index < size; index += 3)
+        {
+            auto out = &result[(index / 3) * 4];
+            std::uint32_t group = static_cast<std::uint32_t>(data[index]) << 16;
+            if (index + 1 < size) { group |= static_cast<std::uint32_t>(data[index + 1]) << 8; }
+            if (index + 2 < size) { group |= static_cast<std::uint32_t>(data[index + 2]); }
+            out[0] = base64EncoderRing[(group >> 18) & 0x3F];
+            out[1] = base64EncoderRing[(group >> 12) & 0x3F];
+            if (index + 1 < size) { out[2] = base64EncoderRing[(group >> 6) & 0x3F]; }
+            if (index + 2 < size) { out[3] = base64EncoderRing[group & 0x3F]; }
+        }
+        return result;
+    }
+
+} /*Encoding */
+
+    std::string Base64::ComputeBase64(const std::uint8_t* buffer, std::size_t size)
+    {
+        return Encoding::GetBase64EncodedValue(buffer, size);
+    }
+} /* MSIX */
@@ -0,0 +1,258 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "SHA256Hardware.hpp"
+#include "Exceptions.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define MSIX_SHA256_X86
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define MSIX_SHA256_TARGET
+    #else
+        #include <cpuid.h>
+        #define MSIX_SHA256_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+    #endif
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+    // Only when the compiler already targets the crypto extensions, which then are always there.
+    #define MSIX_SHA256_ARM
+    #include <arm_neon.h>
+#endif
+
+namespace MSIX { namespace SHA256Hardware {
+
+#if defined(MSIX_SHA256_X86) || defined(MSIX_SHA256_ARM)
+    namespace {
+
+        const std::uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+
+        const std::uint32_t InitialState[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+
+    #if defined(MSIX_SHA256_X86)
+        bool DetectSupport()
+        {
+        #if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) { return false; }
+            __cpuid(info, 1);
+            bool ssse3AndSse41 = ((info[2] & (1 << 9)) != 0) && ((info[2] & (1 << 19)) != 0);
+            __cpuidex(info, 7, 0);
+            return ssse3AndSse41 && ((info[1] & (1 << 29)) != 0);
+        #else
+            unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+            if (__get_cpuid_max(0, nullptr) < 7) { return false; }
+            __cpuid(1, eax, ebx, ecx, edx);
+            bool ssse3AndSse41 = ((ecx & (1u << 9)) != 0) && ((ecx & (1u << 19)) != 0);
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            return ssse3AndSse41 && ((ebx & (1u << 29)) != 0);
+        #endif
+        }
+
+        // Runs the compression function over the same number of blocks of Lanes independent messages.
+        // Interleaving the lanes lets the rounds of one message execute while another waits on its result.
+        template <std::size_t Lanes>
+        MSIX_SHA256_TARGET void Compress(std::uint32_t* const* states, const std::uint8_t* const* data, std::size_t blocks)
+        {
+            const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+            __m128i abef[Lanes], cdgh[Lanes];
+            for (std::size_t l = 0; l < Lanes; l++)
+            {   // The instructions want the state as ABEF/CDGH instead of ABCD/EFGH
+                __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&states[l][0])), 0xB1);
+                __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&states[l][4])), 0x1B);
+                abef[l] = _mm_alignr_epi8(cdab, efgh, 8);
+                cdgh[l] = _mm_blend_epi16(efgh, cdab, 0xF0);
+            }
+
+            for (std::size_t block = 0; block < blocks; block++)
+            {
+                __m128i abefSave[Lanes], cdghSave[Lanes], w[Lanes][4];
+                for (std::size_t l = 0; l < Lanes; l++)
+                {
+                    abefSave[l] = abef[l];
+                    cdghSave[l] = cdgh[l];
+                }
+                // 16 groups of 4 rounds, keeping the last 16 words of the message schedule in w
+                for (std::size_t i = 0; i < 16; i++)
+                {
+                    __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&K[i * 4]));
+                    for (std::size_t l = 0; l < Lanes; l++)
+                    {
+                        __m128i msg;
+                        if (i < 4)
+                        {   msg = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data[l] + block * 64 + i * 16)), byteSwap);
+                        }
+                        else
+                        {
+                            msg = _mm_sha256msg1_epu32(w[l][i & 3], w[l][(i + 1) & 3]);
+                            msg = _mm_add_epi32(msg, _mm_alignr_epi8(w[l][(i + 3) & 3], w[l][(i + 2) & 3], 4));
+                            msg = _mm_sha256msg2_epu32(msg, w[l][(i + 3) & 3]);
+                        }
+                        w[l][i & 3] = msg;
+                        msg = _mm_add_epi32(msg, k);
+                        cdgh[l] = _mm_sha256rnds2_epu32(cdgh[l], abef[l], msg);
+                        abef[l] = _mm_sha256rnds2_epu32(abef[l], cdgh[l], _mm_shuffle_epi32(msg, 0x0E));
+                    }
+                }
+                for (std::size_t l = 0; l < Lanes; l++)
+                {
+                    abef[l] = _mm_add_epi32(abef[l], abefSave[l]);
+                    cdgh[l] = _mm_add_epi32(cdgh[l], cdghSave[l]);
+                }
+            }
+
+            for (std::size_t l = 0; l < Lanes; l++)
+            {
+                __m128i feba = _mm_shuffle_epi32(abef[l], 0x1B);
+                __m128i dchg = _mm_shuffle_epi32(cdgh[l], 0xB1);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&states[l][0]), _mm_blend_epi16(feba, dchg, 0xF0));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&states[l][4]), _mm_alignr_epi8(dchg, feba, 8));
+            }
+        }
+    #elif defined(MSIX_SHA256_ARM)
+        bool DetectSupport() { return true; }
+
+        // Runs the compression function over the same number of blocks of Lanes independent messages.
+        // Interleaving the lanes lets the rounds of one message execute while another waits on its result.
+        template <std::size_t Lanes>
+        void Compress(std::uint32_t* const* states, const std::uint8_t* const* data, std::size_t blocks)
+        {
+            uint32x4_t abcd[Lanes], efgh[Lanes];
+            for (std::size_t l = 0; l < Lanes; l++)
+            {
+                abcd[l] = vld1q_u32(&states[l][0]);
+                efgh[l] = vld1q_u32(&states[l][4]);
+            }
+
+            for (std::size_t block = 0; block < blocks; block++)
+            {
+                uint32x4_t abcdSave[Lanes], efghSave[Lanes], w[Lanes][4];
+                for (std::size_t l = 0; l < Lanes; l++)
+                {
+                    abcdSave[l] = abcd[l];
+                    efghSave[l] = efgh[l];
+                }
+                // 16 groups of 4 rounds, keeping the last 16 words of the message schedule in w
+                for (std::size_t i = 0; i < 16; i++)
+                {
+                    uint32x4_t k = vld1q_u32(&K[i * 4]);
+                    for (std::size_t l = 0; l < Lanes; l++)
+                    {
+                        uint32x4_t msg;
+                        if (i < 4)
+                        {   msg = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data[l] + block * 64 + i * 16)));
+                        }
+                        else
+                        {   msg = vsha256su1q_u32(vsha256su0q_u32(w[l][i & 3], w[l][(i + 1) & 3]), w[l][(i + 2) & 3], w[l][(i + 3) & 3]);
+                        }
+                        w[l][i & 3] = msg;
+                        msg = vaddq_u32(msg, k);
+                        uint32x4_t previous = abcd[l];
+                        abcd[l] = vsha256hq_u32(abcd[l], efgh[l], msg);
+                        efgh[l] = vsha256h2q_u32(efgh[l], previous, msg);
+                    }
+                }
+                for (std::size_t l = 0; l < Lanes; l++)
+                {
+                    abcd[l] = vaddq_u32(abcd[l], abcdSave[l]);
+                    efgh[l] = vaddq_u32(efgh[l], efghSave[l]);
+                }
+            }
+
+            for (std::size_t l = 0; l < Lanes; l++)
+            {
+                vst1q_u32(&states[l][0], abcd[l]);
+                vst1q_u32(&states[l][4], efgh[l]);
+            }
+        }
+    #endif
+
+        // Hashes whole blocks of all the lanes together, then the rest and the padding of each lane on its own.
+        template <std::size_t Lanes>
+        void HashLanes(const std::uint8_t* const* buffers, const std::size_t* sizes, SHA256::Hash* hashes)
+        {
+            std::uint32_t state[Lanes][8];
+            std::uint32_t* states[Lanes];
+            std::size_t blocks = (std::numeric_limits<std::size_t>::max)();
+            for (std::size_t l = 0; l < Lanes; l++)
+            {
+                std::memcpy(state[l], InitialState, sizeof(InitialState));
+                states[l] = state[l];
+                blocks = std::min(blocks, sizes[l] / 64);
+            }
+            Compress<Lanes>(states, buffers, blocks);
+
+            for (std::size_t l = 0; l < Lanes; l++)
+            {
+                std::uint32_t* laneState[1] = { state[l] };
+                const std::uint8_t* rest = buffers[l] + blocks * 64;
+                std::size_t remaining = sizes[l] - blocks * 64;
+                Compress<1>(laneState, &rest, remaining / 64);
+                rest += (remaining / 64) * 64;
+                remaining %= 64;
+
+                // 0x80, zeros and the message length in bits as a big endian 64 bit value
+                std::uint8_t tail[128] = {};
+                if (remaining != 0) { std::memcpy(tail, rest, remaining); }
+                tail[remaining] = 0x80;
+                std::size_t tailBlocks = (remaining + 1 + 8 > 64) ? 2 : 1;
+                std::uint64_t bits = static_cast<std::uint64_t>(sizes[l]) * 8;
+                for (std::size_t i = 0; i < 8; i++)
+                {   tail[tailBlocks * 64 - 1 - i] = static_cast<std::uint8_t>(bits >> (i * 8));
+                }
+                const std::uint8_t* tailData = tail;
+                Compress<1>(laneState, &tailData, tailBlocks);
+
+                for (std::size_t i = 0; i < 8; i++)
+                {
+                    hashes[l][i * 4 + 0] = static_cast<std::uint8_t>(state[l][i] >> 24);
+                    hashes[l][i * 4 + 1] = static_cast<std::uint8_t>(state[l][i] >> 16);
+                    hashes[l][i * 4 + 2] = static_cast<std::uint8_t>(state[l][i] >> 8);
+                    hashes[l][i * 4 + 3] = static_cast<std::uint8_t>(state[l][i]);
+                }
+            }
+        }
+    }
+
+    bool IsSupported()
+    {
+        static const bool supported = DetectSupport();
+        return supported;
+    }
+
+    void ComputeHashes(const std::uint8_t* const* buffers, const std::size_t* sizes, SHA256::Hash* hashes, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 1 < count; i += 2)
+        {   HashLanes<2>(buffers + i, sizes + i, hashes + i);
+        }
+        if (i < count)
+        {   HashLanes<1>(buffers + i, sizes + i, hashes + i);
+        }
+    }
+#else
+    bool IsSupported() { return false; }
+
+    void ComputeHashes(const std::uint8_t* const*, const std::size_t*, SHA256::Hash*, std::size_t)
+    {
+        ThrowErrorAndLog(Error::NotSupported, "SHA-256 instructions not available");
+    }
+#endif
+} }
@@ -5,7 +5,10 @@
 #include <string>
 #include <memory>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
+#include <set>
+#include <vector>
 
 #include "Exceptions.hpp"
 #include "FileStream.hpp"
@@ -18,6 +21,7 @@
 #include "MsixFeatureSelector.hpp"
 #include "AppxPackageWriter.hpp"
 #include "ScopeExit.hpp"
+#include "StringHelper.hpp"
 
 #ifndef WIN32
 // on non-win32 platforms, compile with -fvisibility=hidden
@@ -252,6 +256,161 @@ MSIX_API HRESULT STDMETHODCALLTYPE UnpackBundleFromStream(
     return static_cast<HRESULT>(MSIX::Error::OK);
 } CATCH_RETURN();
 
+// Runs the verification and copies the failures into one allocation: the array followed by the names it points to.
+static HRESULT VerifyAndReturnFailures(
+    IUnknown* reader,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount)
+{
+    ThrowErrorIf(MSIX::Error::InvalidParameter,
+        (memalloc == nullptr || failures == nullptr || *failures != nullptr || failureCount == nullptr),
+        "Invalid parameters"
+    );
+    *failureCount = 0;
+
+    MSIX::ComPtr<IPackage> package;
+    ThrowHrIfFailed(reader->QueryInterface(UuidOfImpl<IPackage>::iid, reinterpret_cast<void**>(&package)));
+
+    std::vector<MSIX::VerificationFailure> found;
+    package->Verify(threadCount, found);
+    if (found.empty())
+    {
+        return static_cast<HRESULT>(MSIX::Error::OK);
+    }
+
+    std::size_t countBytes = sizeof(MSIX_VERIFICATION_FAILURE) * found.size();
+    for (const auto& failure : found)
+    {
+        countBytes += failure.fileName.size() + 1;
+    }
+    auto result = reinterpret_cast<MSIX_VERIFICATION_FAILURE*>(memalloc(countBytes));
+    ThrowErrorIfNot(MSIX::Error::OutOfMemory, result, "Allocation failed!");
+    auto names = reinterpret_cast<char*>(result + found.size());
+    for (std::size_t i = 0; i < found.size(); i++)
+    {
+        std::memcpy(names, found[i].fileName.c_str(), found[i].fileName.size() + 1);
+        result[i].fileName = names;
+        result[i].blockIndex = found[i].blockIndex;
+        result[i].error = found[i].error;
+        names += found[i].fileName.size() + 1;
+    }
+    *failures = result;
+    *failureCount = static_cast<UINT32>(found.size());
+    return found.front().error;
+}
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyPackage(
+    MSIX_VALIDATION_OPTION validationOption,
+    char* utf8SourcePackage,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount) noexcept try
+{
+    ThrowErrorIfNot(MSIX::Error::InvalidParameter, (utf8SourcePackage != nullptr), "Invalid parameters");
+
+    MSIX::ComPtr<IStream> stream;
+    ThrowHrIfFailed(CreateStreamOnFile(utf8SourcePackage, true, &stream));
+    return VerifyPackageFromStream(validationOption, stream.Get(), threadCount, memalloc, failures, failureCount);
+} CATCH_RETURN();
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyPackageFromPackageReader(
+    IAppxPackageReader* packageReader,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount) noexcept try
+{
+    ThrowErrorIfNot(MSIX::Error::InvalidParameter, (packageReader != nullptr), "Invalid parameters");
+    return VerifyAndReturnFailures(packageReader, threadCount, memalloc, failures, failureCount);
+} CATCH_RETURN();
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyPackageFromStream(
+    MSIX_VALIDATION_OPTION validationOption,
+    IStream* stream,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount) noexcept try
+{
+    ThrowErrorIfNot(MSIX::Error::InvalidParameter, (stream != nullptr), "Invalid parameters");
+
+    MSIX::ComPtr<IAppxFactory> factory;
+    ThrowHrIfFailed(CoCreateAppxFactoryWithHeap(InternalAllocate, InternalFree, validationOption, &factory));
+
+    MSIX::ComPtr<IAppxPackageReader> reader;
+    ThrowHrIfFailed(factory->CreatePackageReader(stream, &reader));
+    return VerifyPackageFromPackageReader(reader.Get(), threadCount, memalloc, failures, failureCount);
+} CATCH_RETURN();
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyBundle(
+    MSIX_VALIDATION_OPTION validationOption,
+    char* utf8SourcePackage,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount) noexcept try
+{
+    THROW_IF_BUNDLE_NOT_ENABLED
+    ThrowErrorIfNot(MSIX::Error::InvalidParameter, (utf8SourcePackage != nullptr), "Invalid parameters");
+
+    MSIX::ComPtr<IStream> stream;
+    ThrowHrIfFailed(CreateStreamOnFile(utf8SourcePackage, true, &stream));
+    return VerifyBundleFromStream(validationOption, stream.Get(), threadCount, memalloc, failures, failureCount);
+} CATCH_RETURN();
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyBundleFromBundleReader(
+    IAppxBundleReader* bundleReader,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount) noexcept try
+{
+    THROW_IF_BUNDLE_NOT_ENABLED
+    ThrowErrorIfNot(MSIX::Error::InvalidParameter, (bundleReader != nullptr), "Invalid parameters");
+    return VerifyAndReturnFailures(bundleReader, threadCount, memalloc, failures, failureCount);
+} CATCH_RETURN();
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyBundleFromStream(
+    MSIX_VALIDATION_OPTION validationOption,
+    IStream* stream,
+    UINT32 threadCount,
+    COTASKMEMALLOC* memalloc,
+    MSIX_VERIFICATION_FAILURE** failures,
+    UINT32* failureCount) noexcept try
+{
+    THROW_IF_BUNDLE_NOT_ENABLED
+    ThrowErrorIfNot(MSIX::Error::InvalidParameter, (stream != nullptr), "Invalid parameters");
+
+    // Every package in the bundle gets verified, so applicability doesn't matter.
+    MSIX::ComPtr<IAppxBundleFactory> factory;
+    ThrowHrIfFailed(CoCreateAppxBundleFactoryWithHeap(InternalAllocate, InternalFree, validationOption,
+        static_cast<MSIX_APPLICABILITY_OPTIONS>(MSIX_APPLICABILITY_NONE), &factory));
+
+    MSIX::ComPtr<IAppxBundleReader> reader;
+    ThrowHrIfFailed(factory->CreateBundleReader(stream, &reader));
+    return VerifyBundleFromBundleReader(reader.Get(), threadCount, memalloc, failures, failureCount);
+} CATCH_RETURN();
+
+MSIX_API HRESULT STDMETHODCALLTYPE GetPackageIdentityFromStream(
+    IAppxFactory* factory,
+    IStream* stream,
+    IAppxManifestPackageId** packageId) noexcept try
+{
+    ThrowErrorIf(MSIX::Error::InvalidParameter,
+        (factory == nullptr || stream == nullptr || packageId == nullptr || *packageId != nullptr),
+        "Invalid parameters"
+    );
+
+    MSIX::ComPtr<IMsixFactory> msixFactory;
+    ThrowHrIfFailed(factory->QueryInterface(UuidOfImpl<IMsixFactory>::iid, reinterpret_cast<void**>(&msixFactory)));
+    MSIX::ComPtr<IStream> input(stream);
+    *packageId = MSIX::GetPackageIdentity(msixFactory.Get(), input).Detach();
+    return static_cast<HRESULT>(MSIX::Error::OK);
+} CATCH_RETURN();
+
 #ifdef MSIX_PACK
 
 MSIX_API HRESULT STDMETHODCALLTYPE PackPackage(
@@ -259,6 +418,18 @@ MSIX_API HRESULT STDMETHODCALLTYPE PackPackage(
     MSIX_VALIDATION_OPTION validationOption,
     char* directoryPath,
     char* outputPackage
+) noexcept
+{
+    return PackPackageWithCompression(packUnpackOptions, validationOption, APPX_COMPRESSION_OPTION_NORMAL,
+        directoryPath, outputPackage);
+}
+
+MSIX_API HRESULT STDMETHODCALLTYPE PackPackageWithCompression(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    MSIX_VALIDATION_OPTION validationOption,
+    APPX_COMPRESSION_OPTION compressionOption,
+    char* directoryPath,
+    char* outputPackage
 ) noexcept try
 {
     ThrowErrorIfNot(MSIX::Error::InvalidParameter, 
@@ -282,7 +453,115 @@ MSIX_API HRESULT STDMETHODCALLTYPE PackPackage(
 
     MSIX::ComPtr<IAppxPackageWriter> writer;
     ThrowHrIfFailed(factory->CreatePackageWriter(stream.Get(), nullptr, &writer));
-    writer.As<IPackageWriter>()->PackPayloadFiles(from);
+    auto packageWriter = writer.As<IPackageWriter>();
+    packageWriter->SetStoreIncompressibleFiles((packUnpackOptions & MSIX_PACKUNPACK_OPTION_STOREINCOMPRESSIBLEFILES) != 0);
+    packageWriter->PackPayloadFiles(from, compressionOption);
+    ThrowHrIfFailed(writer->Close(manifest.Get()));
+    deleteFile.release();
+    return static_cast<HRESULT>(MSIX::Error::OK);
+} CATCH_RETURN();
+
+// Absolute path with no . or .. in it. The file doesn't need to exist, its directory is resolved instead.
+static std::string GetFullPath(const std::string& path)
+{
+    #ifdef WIN32
+    std::unique_ptr<char, decltype(&std::free)> fullPath(_fullpath(nullptr, path.c_str(), 0), &std::free);
+    // Paths aren't case sensitive on Windows
+    return fullPath ? MSIX::Helper::tolower(fullPath.get()) : MSIX::Helper::tolower(path);
+    #else
+    std::unique_ptr<char, decltype(&std::free)> fullPath(realpath(path.c_str(), nullptr), &std::free);
+    if (fullPath) { return fullPath.get(); }
+    auto separator = path.find_last_of('/');
+    std::string directory = (separator == std::string::npos) ? "." : ((separator == 0) ? "/" : path.substr(0, separator));
+    std::string name = (separator == std::string::npos) ? path : path.substr(separator + 1);
+    fullPath.reset(realpath(directory.c_str(), nullptr));
+    return fullPath ? std::string(fullPath.get()) + "/" + name : path;
+    #endif
+}
+
+MSIX_API HRESULT STDMETHODCALLTYPE RepackPackage(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    MSIX_VALIDATION_OPTION validationOption,
+    char* sourcePackage,
+    char* directoryPath,
+    UINT32 removedFileCount,
+    char** removedFiles,
+    char* outputPackage
+) noexcept try
+{
+    ThrowErrorIfNot(MSIX::Error::InvalidParameter,
+        (sourcePackage != nullptr && outputPackage != nullptr && (removedFileCount == 0 || removedFiles != nullptr)),
+        "Invalid parameters");
+    // The payload is read from the source while the output is written.
+    ThrowErrorIf(MSIX::Error::InvalidParameter, (GetFullPath(sourcePackage) == GetFullPath(outputPackage)),
+        "The output package can't be the source package");
+
+    MSIX::ComPtr<IAppxFactory> factory;
+    ThrowHrIfFailed(CoCreateAppxFactoryWithHeap(InternalAllocate, InternalFree, validationOption, &factory));
+
+    MSIX::ComPtr<IStream> sourceStream;
+    ThrowHrIfFailed(CreateStreamOnFile(sourcePackage, true, &sourceStream));
+    MSIX::ComPtr<IAppxPackageReader> reader;
+    ThrowHrIfFailed(factory->CreatePackageReader(sourceStream.Get(), &reader));
+
+    // Names are matched like the writer does when copying, the blockmap has them with the windows separator.
+    MSIX::ComPtr<IAppxBlockMapReader> blockMapReader;
+    ThrowHrIfFailed(reader->GetBlockMap(&blockMapReader));
+    std::set<std::string> sourceFiles;
+    for (const auto& name : blockMapReader.As<IAppxBlockMapInternal>()->GetFileNames())
+    {
+        sourceFiles.insert(MSIX::Helper::tolower(name));
+    }
+
+    std::set<std::string> excluded;
+    for (UINT32 i = 0; i < removedFileCount; i++)
+    {
+        ThrowErrorIfNot(MSIX::Error::InvalidParameter, removedFiles[i], "Invalid parameters");
+        ThrowErrorIf(MSIX::Error::FileNotFound,
+            (sourceFiles.find(MSIX::Helper::tolower(MSIX::Helper::toBackSlash(removedFiles[i]))) == sourceFiles.end()),
+            "Removed file not in the source package");
+        excluded.insert(removedFiles[i]);
+    }
+
+    MSIX::ComPtr<IDirectoryObject> from;
+    MSIX::ComPtr<IStream> manifest;
+    if (directoryPath != nullptr)
+    {
+        from = MSIX::ComPtr<IDirectoryObject>::Make<MSIX::DirectoryObject>(directoryPath);
+        for (const auto& file : from->GetFilesByLastModDate())
+        {
+            if (file.second == MSIX::footprintFiles[APPX_FOOTPRINT_FILE_TYPE_MANIFEST])
+            {
+                manifest = from.As<IStorageObject>()->GetFile(file.second);
+            }
+            // Files in the directory replace the ones in the source package.
+            excluded.insert(file.second);
+        }
+    }
+    if (!manifest)
+    {
+        MSIX::ComPtr<IAppxFile> manifestFile;
+        ThrowHrIfFailed(reader->GetFootprintFile(APPX_FOOTPRINT_FILE_TYPE_MANIFEST, &manifestFile));
+        ThrowHrIfFailed(manifestFile->GetStream(&manifest));
+    }
+
+    auto deleteFile = MSIX::scope_exit([&outputPackage]
+    {
+        remove(outputPackage);
+    });
+
+    MSIX::ComPtr<IStream> stream;
+    ThrowHrIfFailed(CreateStreamOnFile(outputPackage, false, &stream));
+
+    MSIX::ComPtr<IAppxPackageWriter> writer;
+    ThrowHrIfFailed(factory->CreatePackageWriter(stream.Get(), nullptr, &writer));
+    auto packageWriter = writer.As<IPackageWriter>();
+    packageWriter->SetStoreIncompressibleFiles((packUnpackOptions & MSIX_PACKUNPACK_OPTION_STOREINCOMPRESSIBLEFILES) != 0);
+    packageWriter->CopyPayloadFiles(reader, excluded);
+    if (from)
+    {
+        packageWriter->PackPayloadFiles(from, APPX_COMPRESSION_OPTION_NORMAL);
+    }
     ThrowHrIfFailed(writer->Close(manifest.Get()));
     deleteFile.release();
     return static_cast<HRESULT>(MSIX::Error::OK);
@@ -56,13 +56,15 @@ namespace MSIX {
     void BlockMapWriter::AddBlock(const std::vector<std::uint8_t>& block, ULONG size, bool isCompressed)
     {
         // hash block
-        std::vector<std::uint8_t> hash;
-        ThrowErrorIfNot(MSIX::Error::BlockMapInvalidData,
-            MSIX::SHA256::ComputeHash(const_cast<std::uint8_t*>(block.data()), static_cast<uint32_t>(block.size()), hash), 
-            "Failed computing hash");
+        MSIX::SHA256::Hash hash;
+        MSIX::SHA256::ComputeHash(block.data(), block.size(), hash);
+        AddBlock(hash, size, isCompressed);
+    }
 
+    void BlockMapWriter::AddBlock(const SHA256::Hash& hash, ULONG size, bool isCompressed)
+    {
         m_xmlWriter.StartElement(blockElement);
-        m_xmlWriter.AddAttribute(hashAttribute, Base64::ComputeBase64(hash));
+        m_xmlWriter.AddAttribute(hashAttribute, Base64::ComputeBase64(hash.data(), hash.size()));
         // We only add the size attribute for compressed files, we cannot just check for the 
         // size of the block because the last block is going to be smaller than the default.
         if(isCompressed)
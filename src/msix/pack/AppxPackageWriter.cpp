@@ -11,29 +11,230 @@
 #include "Encoding.hpp"
 #include "ZipObjectWriter.hpp"
 #include "AppxManifestObject.hpp"
+#include "AppxPackageObject.hpp"
 #include "ScopeExit.hpp"
 #include "FileNameValidation.hpp"
 #include "StringHelper.hpp"
+#include "DeflateStream.hpp"
+#include "Crypto.hpp"
 
 #include <string>
 #include <memory>
 #include <future>
 #include <algorithm>
 #include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 #include <zlib.h>
 
 namespace MSIX {
 
-    AppxPackageWriter::AppxPackageWriter(IMsixFactory* factory, const ComPtr<IZipWriter>& zip) : m_factory(factory), m_zipWriter(zip)
+    // Workers of the compression pool. Never less than two, so one block is compressed while another is read
+    // or written, even on a single core.
+    static std::uint32_t GetCompressionThreadCount()
+    {
+        return std::max(2u, std::thread::hardware_concurrency());
+    }
+
+    // Compresses, hashes and CRCs the blocks of payload files on a set of worker threads. Each block is
+    // deflated on its own and ends with a full flush, which is what DeflateStream produces for every block
+    // written to it, so the compressed blocks concatenated in order are the deflate stream of the file.
+    // Reading the source and writing to the zip stays on the calling thread.
+    class BlockCompressionPool
+    {
+    public:
+        struct Block
+        {
+            std::vector<std::uint8_t> data;     // uncompressed when submitted, what goes into the zip when done
+            std::uint32_t             size = 0; // uncompressed size
+            std::uint32_t             crc = 0;
+            SHA256::Hash              hash;
+        };
+
+        // The deflate state of the workers comes from deflatePool, which must outlive this.
+        BlockCompressionPool(std::uint32_t threadCount, CompressionObjectPool& deflatePool) : m_deflatePool(deflatePool)
+        {
+            if (threadCount == 0)
+            {   threadCount = GetCompressionThreadCount();
+            }
+            for (std::uint32_t i = 0; i < threadCount; i++)
+            {   m_threads.emplace_back([this]() { Worker(); });
+            }
+        }
+
+        ~BlockCompressionPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_done = true;
+            }
+            m_pending.notify_all();
+            for (auto& thread : m_threads)
+            {   thread.join();
+            }
+        }
+
+        std::size_t ThreadCount() const { return m_threads.size(); }
+
+        // The caller bounds the number of blocks in flight, the pool itself doesn't wait.
+        std::future<Block> Submit(std::vector<std::uint8_t>&& data, APPX_COMPRESSION_OPTION compressionOption)
+        {
+            Job job;
+            job.block.size = static_cast<std::uint32_t>(data.size());
+            job.block.data = std::move(data);
+            job.compressionOption = compressionOption;
+            auto result = job.result.get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_jobs.push_back(std::move(job));
+            }
+            m_pending.notify_one();
+            return result;
+        }
+
+    protected:
+        struct Job
+        {
+            Block                   block;
+            APPX_COMPRESSION_OPTION compressionOption = APPX_COMPRESSION_OPTION_NONE;
+            std::promise<Block>     result;
+        };
+
+        void Worker()
+        {
+            // Deflate state is taken from the pool for every block and reset, so the workers share
+            // it with the DeflateStreams of the writer.
+            std::vector<std::uint8_t> output;
+            while (true)
+            {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_pending.wait(lock, [this]() { return m_done || !m_jobs.empty(); });
+                    if (m_jobs.empty()) { return; }
+                    job = std::move(m_jobs.front());
+                    m_jobs.pop_front();
+                }
+                try
+                {
+                    auto& block = job.block;
+                    block.crc = static_cast<std::uint32_t>(crc32(0, block.data.data(), static_cast<uInt>(block.size)));
+                    SHA256::ComputeHash(block.data.data(), block.data.size(), block.hash);
+                    if (job.compressionOption != APPX_COMPRESSION_OPTION_NONE)
+                    {
+                        auto level = GetDeflateLevel(job.compressionOption);
+                        auto deflater = m_deflatePool.Acquire(level);
+                        auto release = MSIX::scope_exit([&]
+                        {
+                            m_deflatePool.Release(std::move(deflater), level);
+                        });
+                        Deflate(*deflater, block.data, output);
+                    }
+                    job.result.set_value(std::move(block));
+                }
+                catch (...)
+                {
+                    job.result.set_exception(std::current_exception());
+                }
+            }
+        }
+
+        // Compresses data in place. output is the scratch buffer of the worker, it is swapped with data when done
+        // so the compressed block isn't copied and the uncompressed buffer becomes the next scratch buffer.
+        static void Deflate(ICompressionObject& deflater, std::vector<std::uint8_t>& data, std::vector<std::uint8_t>& output)
+        {
+            // deflateBound doesn't account for the empty stored block of the full flush.
+            auto bound = deflater.GetDeflateBound(data.size()) + 16;
+            if (output.size() < bound)
+            {   output.resize(bound);
+            }
+            deflater.SetInput(data.data(), data.size());
+            std::size_t have = 0;
+            do
+            {
+                if (have == output.size())
+                {   output.resize(output.size() * 2);
+                }
+                deflater.SetOutput(output.data() + have, output.size() - have);
+                auto result = deflater.Deflate(CompressionFlush::Full);
+                ThrowErrorIf(Error::DeflateWrite, result != CompressionStatus::Ok, "Error deflating stream");
+                have = output.size() - deflater.GetAvailableDestinationSize();
+            } while (deflater.GetAvailableDestinationSize() == 0);
+            output.resize(have);
+            data.swap(output);
+        }
+
+        CompressionObjectPool&      m_deflatePool;
+        std::vector<std::thread>    m_threads;
+        std::mutex                  m_mutex;
+        std::condition_variable     m_pending;
+        std::deque<Job>             m_jobs;
+        bool                        m_done = false;
+    };
+
+    namespace {
+        // This might be called with external IStream implementations. Don't rely on internal implementation of FileStream
+        std::uint64_t GetStreamSize(IStream* stream)
+        {
+            LARGE_INTEGER start = { 0 };
+            ULARGE_INTEGER end = { 0 };
+            ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::END, &end));
+            ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::START, nullptr));
+            return static_cast<std::uint64_t>(end.QuadPart);
+        }
+
+        std::vector<std::uint8_t> ReadBlock(IStream* stream, std::uint32_t blockSize, std::vector<std::uint8_t>&& block)
+        {
+            block.resize(blockSize);
+            ULONG bytesRead;
+            ThrowHrIfFailed(stream->Read(static_cast<void*>(block.data()), static_cast<ULONG>(blockSize), &bytesRead));
+            ThrowErrorIfNot(Error::FileRead, (static_cast<ULONG>(blockSize) == bytesRead), "Read stream file failed");
+            return block;
+        }
+
+        // Writes a block done by the pool to the zip, adds it to the blockmap unless blockMap is null and
+        // combines its crc into the crc of the file.
+        void WriteBlock(const ComPtr<IStream>& zipFileStream, const BlockCompressionPool::Block& block,
+            APPX_COMPRESSION_OPTION compressionOpt, BlockMapWriter* blockMap, std::uint32_t& crc)
+        {
+            ULONG bytesWritten = 0;
+            ThrowHrIfFailed(zipFileStream->Write(block.data.data(), static_cast<ULONG>(block.data.size()), &bytesWritten));
+            crc = static_cast<std::uint32_t>(crc32_combine(crc, block.crc, static_cast<z_off_t>(block.size)));
+            if (blockMap != nullptr)
+            {
+                blockMap->AddBlock(block.hash, bytesWritten, compressionOpt != APPX_COMPRESSION_OPTION_NONE);
+            }
+        }
+
+        // Puts the stream termination on after the blocks done by the pool. This is a final block with fixed huffman
+        // codes that only has the end of block code, the same DeflateStream writes when finishing after a full flush.
+        void WriteEndOfStream(const ComPtr<IStream>& zipFileStream)
+        {
+            const std::uint8_t endOfStream[] = { 0x03, 0x00 };
+            ThrowHrIfFailed(zipFileStream->Write(endOfStream, static_cast<ULONG>(sizeof(endOfStream)), nullptr));
+        }
+    }
+
+    // Deflate state is big, keep enough for every compression thread and the writer itself at two levels,
+    // which is what packing the payload and then the footprint files takes.
+    AppxPackageWriter::AppxPackageWriter(IMsixFactory* factory, const ComPtr<IZipWriter>& zip) : m_factory(factory), m_zipWriter(zip),
+        m_deflatePool(CompressionOperation::Deflate, 2 * (GetCompressionThreadCount() + 1))
     {
         m_state = WriterState::Open;
     }
 
+    AppxPackageWriter::~AppxPackageWriter()
+    {
+    }
+
     // IPackageWriter
-    void AppxPackageWriter::PackPayloadFiles(const ComPtr<IDirectoryObject>& from)
+    void AppxPackageWriter::PackPayloadFiles(const ComPtr<IDirectoryObject>& from, APPX_COMPRESSION_OPTION compressionOption)
     {
         ThrowErrorIf(Error::InvalidState, m_state != WriterState::Open, "Invalid package writer state");
+        ValidateCompressionOption(compressionOption);
         auto failState = MSIX::scope_exit([this]
         {
             this->m_state = WriterState::Failed;
@@ -49,12 +250,57 @@ namespace MSIX {
                 std::string ext = Helper::tolower(file.second.substr(file.second.find_last_of(".") + 1));
                 auto contentType = ContentType::GetContentTypeByExtension(ext);
                 auto stream = from.As<IStorageObject>()->GetFile(file.second);
-                ValidateAndAddPayloadFile(file.second, stream.Get(), contentType.GetCompressionOpt(), contentType.GetContentType().c_str());
+                // The content type decides whether the file is compressed, compressionOption how much.
+                auto fileCompressionOption = contentType.GetCompressionOpt();
+                if (fileCompressionOption != APPX_COMPRESSION_OPTION_NONE)
+                {
+                    fileCompressionOption = compressionOption;
+                }
+                ValidateAndAddPayloadFile(file.second, stream.Get(), fileCompressionOption, contentType.GetContentType().c_str());
             }
         }
         failState.release();
     }
 
+    void AppxPackageWriter::CopyPayloadFiles(const ComPtr<IAppxPackageReader>& from, const std::set<std::string>& excluded)
+    {
+        ThrowErrorIf(Error::InvalidState, m_state != WriterState::Open, "Invalid package writer state");
+        auto failState = MSIX::scope_exit([this]
+        {
+            this->m_state = WriterState::Failed;
+        });
+
+        auto zipReader = from.As<IPackage>()->GetZipReader();
+        ThrowErrorIfNot(Error::NotSupported, zipReader, "Payload files can only be copied from a package in a zip file");
+        ComPtr<IAppxBlockMapReader> blockMapReader;
+        ThrowHrIfFailed(from->GetBlockMap(&blockMapReader));
+        auto blockMap = blockMapReader.As<IAppxBlockMapInternal>();
+
+        std::set<std::string> excludedNames;
+        for (const auto& name : excluded)
+        {
+            excludedNames.insert(Helper::tolower(Helper::toBackSlash(name)));
+        }
+
+        // The blockmap has the names with the windows separator.
+        for (const auto& name : blockMap->GetFileNames())
+        {
+            if (FileNameValidation::IsFootPrintFile(name) || FileNameValidation::IsReservedFolder(name) ||
+                (excludedNames.find(Helper::tolower(name)) != excludedNames.end()))
+            {
+                continue;
+            }
+            std::uint32_t crc = 0;
+            std::uint64_t uncompressedSize = 0;
+            auto rawStream = zipReader->GetRawFile(Encoding::EncodeFileName(name), crc, uncompressedSize);
+            ThrowErrorIfNot(Error::FileNotFound, rawStream, "File described in blockmap not contained in OPC container");
+            std::string ext = Helper::tolower(name.substr(name.find_last_of(".") + 1));
+            auto contentType = ContentType::GetContentTypeByExtension(ext);
+            CopyFileToPackage(name, rawStream.Get(), crc, uncompressedSize, blockMap->GetBlocks(name), contentType.GetContentType().c_str());
+        }
+        failState.release();
+    }
+
     // IAppxPackageWriter
     HRESULT STDMETHODCALLTYPE AppxPackageWriter::AddPayloadFile(LPCWSTR fileName, LPCWSTR contentType,
         APPX_COMPRESSION_OPTION compressionOption, IStream *inputStream) noexcept try
@@ -77,18 +323,18 @@ namespace MSIX {
         // If the creating the AppxManifestObject succeeds, then the stream is valid.
         auto manifestObj = ComPtr<IAppxManifestReader>::Make<AppxManifestObject>(m_factory.Get(), manifestStream.Get());
         auto manifestContentType = ContentType::GetPayloadFileContentType(APPX_FOOTPRINT_FILE_TYPE_MANIFEST);
-        AddFileToPackage(APPXMANIFEST_XML, manifestStream.Get(), true, true, manifestContentType.c_str());
+        AddFileToPackage(APPXMANIFEST_XML, manifestStream.Get(), APPX_COMPRESSION_OPTION_NORMAL, true, manifestContentType.c_str());
 
         // Close blockmap and add it to package
         m_blockMapWriter.Close();
         auto blockMapStream = m_blockMapWriter.GetStream();
         auto blockMapContentType = ContentType::GetPayloadFileContentType(APPX_FOOTPRINT_FILE_TYPE_BLOCKMAP);
-        AddFileToPackage(APPXBLOCKMAP_XML, blockMapStream.Get(), true, false, blockMapContentType.c_str());
+        AddFileToPackage(APPXBLOCKMAP_XML, blockMapStream.Get(), APPX_COMPRESSION_OPTION_NORMAL, false, blockMapContentType.c_str());
 
         // Close content types and add it to package
         m_contentTypeWriter.Close();
         auto contentTypeStream = m_contentTypeWriter.GetStream();
-        AddFileToPackage(CONTENT_TYPES_XML, contentTypeStream.Get(), true, false, nullptr);
+        AddFileToPackage(CONTENT_TYPES_XML, contentTypeStream.Get(), APPX_COMPRESSION_OPTION_NORMAL, false, nullptr);
 
         m_zipWriter->Close();
         failState.release();
@@ -120,14 +366,17 @@ namespace MSIX {
         {
             this->m_state = WriterState::Failed;
         });
-        // TODO: use memoryLimit for how many files are going to be added
+        std::vector<PayloadFile> files(fileCount);
         for(UINT32 i = 0; i < fileCount; i++)
         {
-            std::string fileName = wstring_to_utf8(payloadFiles[i].fileName);
-            ComPtr<IStream> stream(payloadFiles[i].inputStream);
-            std::string contentType = wstring_to_utf8(payloadFiles[i].contentType);
-            ValidateAndAddPayloadFile(fileName, stream.Get(), payloadFiles[i].compressionOption, contentType.c_str());
+            ThrowErrorIf(Error::InvalidParameter, (payloadFiles[i].fileName == nullptr || payloadFiles[i].contentType == nullptr ||
+                payloadFiles[i].inputStream == nullptr), "Invalid payload file");
+            files[i].name = wstring_to_utf8(payloadFiles[i].fileName);
+            files[i].stream = ComPtr<IStream>(payloadFiles[i].inputStream);
+            files[i].contentType = wstring_to_utf8(payloadFiles[i].contentType);
+            files[i].compressionOpt = payloadFiles[i].compressionOption;
         }
+        AddPayloadFilesInParallel(files, memoryLimit);
         failState.release();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
@@ -141,28 +390,61 @@ namespace MSIX {
         {
             this->m_state = WriterState::Failed;
         });
-        // TODO: use memoryLimit for how many files are going to be added
+        std::vector<PayloadFile> files(fileCount);
         for(UINT32 i = 0; i < fileCount; i++)
         {
-            ComPtr<IStream> stream(payloadFiles[i].inputStream);
-            ValidateAndAddPayloadFile(payloadFiles[i].fileName, stream.Get(), payloadFiles[i].compressionOption, payloadFiles[i].contentType);
+            ThrowErrorIf(Error::InvalidParameter, (payloadFiles[i].fileName == nullptr || payloadFiles[i].contentType == nullptr ||
+                payloadFiles[i].inputStream == nullptr), "Invalid payload file");
+            files[i].name = payloadFiles[i].fileName;
+            files[i].stream = ComPtr<IStream>(payloadFiles[i].inputStream);
+            files[i].contentType = payloadFiles[i].contentType;
+            files[i].compressionOpt = payloadFiles[i].compressionOption;
         }
+        AddPayloadFilesInParallel(files, memoryLimit);
         failState.release();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
     void AppxPackageWriter::ValidateAndAddPayloadFile(const std::string& name, IStream* stream,
         APPX_COMPRESSION_OPTION compressionOpt, const char* contentType)
+    {
+        ValidatePayloadFile(name, compressionOpt);
+        compressionOpt = SampleCompression(stream, GetStreamSize(stream), compressionOpt);
+        AddFileToPackage(name, stream, compressionOpt, true, contentType);
+    }
+
+    void AppxPackageWriter::ValidatePayloadFile(const std::string& name, APPX_COMPRESSION_OPTION compressionOpt)
     {
         ThrowErrorIfNot(Error::InvalidParameter, FileNameValidation::IsFileNameValid(name), "Invalid file name");
         ThrowErrorIf(Error::InvalidParameter, FileNameValidation::IsFootPrintFile(name), "Trying to add footprint file to package");
         ThrowErrorIf(Error::InvalidParameter, FileNameValidation::IsReservedFolder(name), "Trying to add file in reserved folder");
         ValidateCompressionOption(compressionOpt);
-        AddFileToPackage(name, stream, compressionOpt != APPX_COMPRESSION_OPTION_NONE, true, contentType);
     }
 
-    void AppxPackageWriter::AddFileToPackage(const std::string& name, IStream* stream, bool toCompress,
+    void AppxPackageWriter::AddFileToPackage(const std::string& name, IStream* stream, APPX_COMPRESSION_OPTION compressionOpt,
         bool addToBlockMap, const char* contentType, bool forceContentTypeOverride)
+    {
+        std::uint64_t uncompressedSize = GetStreamSize(stream);
+        auto zipFileStream = StartFile(name, uncompressedSize, compressionOpt, addToBlockMap, contentType, forceContentTypeOverride);
+
+        // Files with more than one block always go through the pool.
+        std::uint32_t crc = 0;
+        if (uncompressedSize > DefaultBlockSize)
+        {
+            crc = AddBlocksInParallel(stream, uncompressedSize, zipFileStream, compressionOpt, addToBlockMap);
+        }
+        else
+        {
+            crc = AddBlocks(stream, uncompressedSize, zipFileStream, compressionOpt, addToBlockMap);
+        }
+
+        EndFile(zipFileStream, crc, uncompressedSize, addToBlockMap);
+    }
+
+    // Writes the lfh, adds the file to [Content_Types].xml and the blockmap and returns the stream for the
+    // data of the file.
+    ComPtr<IStream> AppxPackageWriter::StartFile(const std::string& name, std::uint64_t uncompressedSize,
+        APPX_COMPRESSION_OPTION compressionOpt, bool addToBlockMap, const char* contentType, bool forceContentTypeOverride)
     {
         std::string opcFileName;
         // Don't encode [Content Type].xml
@@ -174,7 +456,7 @@ namespace MSIX {
         {
             opcFileName = name;
         }
-        auto fileInfo = m_zipWriter->PrepareToAddFile(opcFileName, toCompress);
+        auto fileInfo = m_zipWriter->PrepareToAddFile(opcFileName, compressionOpt);
 
         // Add content type to [Content Types].xml
         if (contentType != nullptr)
@@ -182,22 +464,69 @@ namespace MSIX {
             m_contentTypeWriter.AddContentType(name, contentType, forceContentTypeOverride);
         }
 
-        // This might be called with external IStream implementations. Don't rely on internal implementation of FileStream
-        LARGE_INTEGER start = { 0 };
-        ULARGE_INTEGER end = { 0 };
-        ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::END, &end));
-        ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::START, nullptr));
-        std::uint64_t uncompressedSize = static_cast<std::uint64_t>(end.QuadPart);
-
         // Add file to block map.
         if (addToBlockMap)
         {
             m_blockMapWriter.AddFile(name, uncompressedSize, fileInfo.first);
         }
+        return fileInfo.second;
+    }
+
+    void AppxPackageWriter::EndFile(const ComPtr<IStream>& zipFileStream, std::uint32_t crc, std::uint64_t uncompressedSize, bool addToBlockMap)
+    {
+        // Close File element
+        if (addToBlockMap)
+        {
+            m_blockMapWriter.CloseFile();
+        }
 
-        auto& zipFileStream = fileInfo.second;
+        // This could be the compressed or uncompressed size
+        auto streamSize = zipFileStream.As<IStreamInternal>()->GetSize();
+        m_zipWriter->EndFile(crc, streamSize, uncompressedSize, true);
+    }
 
-        std::uint64_t bytesToRead = uncompressedSize;
+    // Copies the data of a file from another zip as it is and adds the blocks from the blockmap it came with.
+    void AppxPackageWriter::CopyFileToPackage(const std::string& name, IStream* rawStream, std::uint32_t crc,
+        std::uint64_t uncompressedSize, const BlockView& blocks, const char* contentType)
+    {
+        bool isCompressed = ComPtr<IStream>(rawStream).As<IStreamInternal>()->IsCompressed();
+        // The level doesn't matter, the data is already compressed
+        auto zipFileStream = StartFile(name, uncompressedSize, isCompressed ? APPX_COMPRESSION_OPTION_NORMAL : APPX_COMPRESSION_OPTION_NONE,
+            true, contentType);
+
+        const std::uint32_t copySize = 16 * DefaultBlockSize;
+        auto& buffer = m_readBuffer;
+        buffer.resize(copySize);
+        std::uint64_t bytesToCopy = GetStreamSize(rawStream);
+        while (bytesToCopy > 0)
+        {
+            std::uint32_t size = (bytesToCopy > copySize) ? copySize : static_cast<std::uint32_t>(bytesToCopy);
+            bytesToCopy -= size;
+            ULONG bytesRead;
+            ThrowHrIfFailed(rawStream->Read(static_cast<void*>(buffer.data()), static_cast<ULONG>(size), &bytesRead));
+            ThrowErrorIfNot(Error::FileRead, (static_cast<ULONG>(size) == bytesRead), "Read stream file failed");
+            ThrowHrIfFailed(zipFileStream->Write(buffer.data(), static_cast<ULONG>(size), nullptr));
+        }
+
+        for (std::size_t i = 0; i < blocks.size(); i++)
+        {
+            m_blockMapWriter.AddBlock(blocks.Hash(i), static_cast<ULONG>(blocks.CompressedSize(i)), isCompressed);
+        }
+        EndFile(zipFileStream, crc, uncompressedSize, true);
+    }
+
+    // Reads, compresses and hashes the blocks of the file one after another and returns the crc of the file.
+    std::uint32_t AppxPackageWriter::AddBlocks(IStream* stream, std::uint64_t size, const ComPtr<IStream>& zipFileStream,
+        APPX_COMPRESSION_OPTION compressionOpt, bool addToBlockMap)
+    {
+        bool toCompress = (compressionOpt != APPX_COMPRESSION_OPTION_NONE);
+        ComPtr<IStream> output = zipFileStream;
+        if (toCompress)
+        {
+            output = ComPtr<IStream>::Make<DeflateStream>(zipFileStream, compressionOpt, m_deflatePool, m_deflateBuffer);
+        }
+
+        std::uint64_t bytesToRead = size;
         std::uint32_t crc = 0;
         while (bytesToRead > 0)
         {
@@ -205,8 +534,8 @@ namespace MSIX {
             std::uint32_t blockSize = (bytesToRead > DefaultBlockSize) ? DefaultBlockSize : static_cast<std::uint32_t>(bytesToRead);
             bytesToRead -= blockSize;
 
-            // read block from stream
-            std::vector<std::uint8_t> block;
+            // read block from stream, the buffer is reused for every block
+            auto& block = m_readBuffer;
             block.resize(blockSize);
             ULONG bytesRead;
             ThrowHrIfFailed(stream->Read(static_cast<void*>(block.data()), static_cast<ULONG>(blockSize), &bytesRead));
@@ -215,7 +544,7 @@ namespace MSIX {
 
             // Write block and compress if needed
             ULONG bytesWritten = 0;
-            ThrowHrIfFailed(zipFileStream->Write(block.data(), static_cast<ULONG>(block.size()), &bytesWritten));
+            ThrowHrIfFailed(output->Write(block.data(), static_cast<ULONG>(block.size()), &bytesWritten));
 
             // Add block to blockmap
             if (addToBlockMap)
@@ -230,18 +559,215 @@ namespace MSIX {
             // Put the stream termination on
             std::vector<std::uint8_t> buffer;
             ULONG bytesWritten = 0;
-            ThrowHrIfFailed(zipFileStream->Write(buffer.data(), static_cast<ULONG>(buffer.size()), &bytesWritten));
+            ThrowHrIfFailed(output->Write(buffer.data(), static_cast<ULONG>(buffer.size()), &bytesWritten));
         }
+        return crc;
+    }
 
-        // Close File element
-        if (addToBlockMap)
+    // Same as AddBlocks, but the blocks are compressed and hashed by the pool while the next ones are read.
+    // The blocks are written in order as they complete and their crcs combined into the crc of the file.
+    std::uint32_t AppxPackageWriter::AddBlocksInParallel(IStream* stream, std::uint64_t size, const ComPtr<IStream>& zipFileStream,
+        APPX_COMPRESSION_OPTION compressionOpt, bool addToBlockMap)
+    {
+        if (!m_compressionPool)
+        {   m_compressionPool = std::make_unique<BlockCompressionPool>(0, m_deflatePool);
+        }
+        BlockMapWriter* blockMap = addToBlockMap ? &m_blockMapWriter : nullptr;
+
+        // Keep every thread busy while the next block is written, but not more blocks than that in memory.
+        const std::size_t maxInFlight = m_compressionPool->ThreadCount() * 2;
+        std::deque<std::future<BlockCompressionPool::Block>> inFlight;
+        std::uint32_t crc = 0;
+        auto writeNextBlock = [&]()
         {
-            m_blockMapWriter.CloseFile();
+            auto block = inFlight.front().get();
+            inFlight.pop_front();
+            WriteBlock(zipFileStream, block, compressionOpt, blockMap, crc);
+            RecycleBlockBuffer(std::move(block.data));
+        };
+
+        std::uint64_t bytesToRead = size;
+        while (bytesToRead > 0)
+        {
+            std::uint32_t blockSize = (bytesToRead > DefaultBlockSize) ? DefaultBlockSize : static_cast<std::uint32_t>(bytesToRead);
+            bytesToRead -= blockSize;
+            inFlight.push_back(m_compressionPool->Submit(ReadBlock(stream, blockSize, GetBlockBuffer()), compressionOpt));
+            if (inFlight.size() >= maxInFlight)
+            {
+                writeNextBlock();
+            }
+        }
+        while (!inFlight.empty())
+        {
+            writeNextBlock();
         }
 
-        // This could be the compressed or uncompressed size
-        auto streamSize = zipFileStream.As<IStreamInternal>()->GetSize();
-        m_zipWriter->EndFile(crc, streamSize, uncompressedSize, true);
+        if (compressionOpt != APPX_COMPRESSION_OPTION_NONE)
+        {
+            WriteEndOfStream(zipFileStream);
+        }
+        return crc;
+    }
+
+    // Adds the payload files in order, but instead of one block at a time the pool works on the blocks of
+    // as many files as fit in memoryLimit, so many small files are compressed and hashed concurrently too.
+    // The files are read on the calling thread, as the same stream might be used for more than one file,
+    // and each file is committed to the zip once its first block is done. If memoryLimit is 0 the blocks
+    // read ahead are bounded the same way as for a single file.
+    void AppxPackageWriter::AddPayloadFilesInParallel(std::vector<PayloadFile>& files, UINT64 memoryLimit)
+    {
+        for (const auto& file : files)
+        {
+            ValidatePayloadFile(file.name, file.compressionOpt);
+        }
+
+        if (!m_compressionPool)
+        {   m_compressionPool = std::make_unique<BlockCompressionPool>(0, m_deflatePool);
+        }
+        std::uint64_t maxBytesInFlight = memoryLimit;
+        if (maxBytesInFlight == 0)
+        {   maxBytesInFlight = m_compressionPool->ThreadCount() * 2 * DefaultBlockSize;
+        }
+
+        struct InFlightBlock
+        {
+            std::size_t                               file;
+            std::future<BlockCompressionPool::Block>  block; // not valid for empty files
+        };
+        std::deque<InFlightBlock> inFlight;
+        std::uint64_t bytesInFlight = 0;
+
+        // The file being committed to the zip
+        std::size_t current = files.size();
+        ComPtr<IStream> zipFileStream;
+        std::uint64_t remaining = 0;
+        std::uint32_t crc = 0;
+        auto writeNextBlock = [&]()
+        {
+            auto next = std::move(inFlight.front());
+            inFlight.pop_front();
+            const auto& file = files[next.file];
+            if (next.file != current)
+            {
+                current = next.file;
+                remaining = file.size;
+                crc = 0;
+                zipFileStream = StartFile(file.name, file.size, file.compressionOpt, true, file.contentType.c_str());
+            }
+            if (next.block.valid())
+            {
+                auto block = next.block.get();
+                bytesInFlight -= block.size;
+                remaining -= block.size;
+                WriteBlock(zipFileStream, block, file.compressionOpt, &m_blockMapWriter, crc);
+                RecycleBlockBuffer(std::move(block.data));
+            }
+            if (remaining == 0)
+            {
+                if (file.compressionOpt != APPX_COMPRESSION_OPTION_NONE)
+                {
+                    WriteEndOfStream(zipFileStream);
+                }
+                EndFile(zipFileStream, crc, file.size, true);
+            }
+        };
+
+        for (std::size_t i = 0; i < files.size(); i++)
+        {
+            auto& file = files[i];
+            file.size = GetStreamSize(file.stream.Get());
+            file.compressionOpt = SampleCompression(file.stream.Get(), file.size, file.compressionOpt);
+            if (file.size == 0)
+            {
+                inFlight.push_back(InFlightBlock{ i, std::future<BlockCompressionPool::Block>() });
+                continue;
+            }
+
+            std::uint64_t bytesToRead = file.size;
+            while (bytesToRead > 0)
+            {
+                std::uint32_t blockSize = (bytesToRead > DefaultBlockSize) ? DefaultBlockSize : static_cast<std::uint32_t>(bytesToRead);
+                bytesToRead -= blockSize;
+                // Make room before reading the block, but always let at least one block through.
+                while (!inFlight.empty() && (bytesInFlight + blockSize > maxBytesInFlight))
+                {
+                    writeNextBlock();
+                }
+                bytesInFlight += blockSize;
+                auto block = ReadBlock(file.stream.Get(), blockSize, GetBlockBuffer());
+                inFlight.push_back(InFlightBlock{ i, m_compressionPool->Submit(std::move(block), file.compressionOpt) });
+            }
+        }
+        while (!inFlight.empty())
+        {
+            writeNextBlock();
+        }
+    }
+
+    // Buffers of blocks written to the zip are kept to read the next blocks into, as many as a single
+    // file can have in flight. They go back and forth with the scratch buffers of the compression workers,
+    // so new ones have room for a deflated block and the workers never need to grow them.
+    std::vector<std::uint8_t> AppxPackageWriter::GetBlockBuffer()
+    {
+        std::vector<std::uint8_t> buffer;
+        if (!m_freeBlockBuffers.empty())
+        {
+            buffer = std::move(m_freeBlockBuffers.back());
+            m_freeBlockBuffers.pop_back();
+        }
+        else
+        {   buffer.reserve(DefaultBlockSize + (DefaultBlockSize / 8));
+        }
+        return buffer;
+    }
+
+    void AppxPackageWriter::RecycleBlockBuffer(std::vector<std::uint8_t>&& buffer)
+    {
+        if (m_freeBlockBuffers.size() < m_compressionPool->ThreadCount() * 2)
+        {
+            m_freeBlockBuffers.push_back(std::move(buffer));
+        }
+    }
+
+    // Returns the compression option to add the file with. If the writer stores incompressible files, the start
+    // of the file is deflated at the fastest level and the file is stored when that saves less than 1/16 of it,
+    // as most such files are already compressed media or archives. Small files are left alone, sampling them
+    // would cost as much as compressing them. The stream is back at the start afterwards.
+    APPX_COMPRESSION_OPTION AppxPackageWriter::SampleCompression(IStream* stream, std::uint64_t size, APPX_COMPRESSION_OPTION compressionOpt)
+    {
+        const std::uint64_t minSampledSize = 4096;
+        if (!m_storeIncompressibleFiles || (compressionOpt == APPX_COMPRESSION_OPTION_NONE) || (size < minSampledSize))
+        {   return compressionOpt;
+        }
+
+        std::uint32_t sampleSize = (size > DefaultBlockSize) ? DefaultBlockSize : static_cast<std::uint32_t>(size);
+        auto& sample = m_readBuffer;
+        sample.resize(sampleSize);
+        ULONG bytesRead;
+        ThrowHrIfFailed(stream->Read(static_cast<void*>(sample.data()), static_cast<ULONG>(sampleSize), &bytesRead));
+        ThrowErrorIfNot(Error::FileRead, (static_cast<ULONG>(sampleSize) == bytesRead), "Read stream file failed");
+        LARGE_INTEGER start = { 0 };
+        ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::START, nullptr));
+
+        auto level = GetDeflateLevel(APPX_COMPRESSION_OPTION_SUPERFAST);
+        auto deflater = m_deflatePool.Acquire(level);
+        auto release = MSIX::scope_exit([&]
+        {
+            m_deflatePool.Release(std::move(deflater), level);
+        });
+        auto bound = deflater->GetDeflateBound(sampleSize);
+        if (m_deflateBuffer.size() < bound)
+        {   m_deflateBuffer.resize(bound);
+        }
+        deflater->SetInput(sample.data(), sample.size());
+        deflater->SetOutput(m_deflateBuffer.data(), m_deflateBuffer.size());
+        ThrowErrorIf(Error::DeflateWrite, deflater->Deflate(CompressionFlush::Finish) != CompressionStatus::End, "Error deflating stream");
+        auto compressedSize = m_deflateBuffer.size() - deflater->GetAvailableDestinationSize();
+
+        if (compressedSize > sampleSize - (sampleSize / 16))
+        {   return APPX_COMPRESSION_OPTION_NONE;
+        }
+        return compressionOpt;
     }
 
     void AppxPackageWriter::ValidateCompressionOption(APPX_COMPRESSION_OPTION compressionOpt)
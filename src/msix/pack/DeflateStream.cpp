@@ -7,21 +7,39 @@
 #include "Exceptions.hpp"
 
 #include <vector>
+#include <zlib.h>
 
 namespace MSIX {
 
-    DeflateStream::DeflateStream(const ComPtr<IStream>& stream) : m_stream(stream)
+    int GetDeflateLevel(APPX_COMPRESSION_OPTION compressionOption)
     {
-        m_zstrm.zalloc = Z_NULL;
-        m_zstrm.zfree = Z_NULL;
-        m_zstrm.opaque = Z_NULL;
-        auto result = deflateInit2(&m_zstrm, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
-        ThrowErrorIf(Error::DeflateInitialize, result != Z_OK, "Error calling deflateinit2");
+        // Levels 1 to 3 don't look for lazy matches and are several times faster than the higher ones. All of them
+        // use the default strategy, Z_HUFFMAN_ONLY and Z_RLE are faster still but barely compress anything in a package.
+        switch (compressionOption)
+        {
+        case APPX_COMPRESSION_OPTION_MAXIMUM:
+            return Z_BEST_COMPRESSION;
+        case APPX_COMPRESSION_OPTION_NORMAL:
+            return Z_DEFAULT_COMPRESSION;
+        case APPX_COMPRESSION_OPTION_FAST:
+            return 3;
+        case APPX_COMPRESSION_OPTION_SUPERFAST:
+            return Z_BEST_SPEED;
+        default:
+            ThrowErrorAndLog(Error::InvalidParameter, "Invalid compression option.");
+        }
+    }
+
+    DeflateStream::DeflateStream(const ComPtr<IStream>& stream, APPX_COMPRESSION_OPTION compressionOption,
+        CompressionObjectPool& pool, std::vector<std::uint8_t>& buffer) :
+        m_stream(stream), m_pool(pool), m_level(GetDeflateLevel(compressionOption)), m_buffer(buffer)
+    {
+        m_compressionObject = m_pool.Acquire(m_level);
     }
 
     DeflateStream::~DeflateStream()
     {
-        deflateEnd(&m_zstrm);
+        m_pool.Release(std::move(m_compressionObject), m_level);
     }
 
     // IStream
@@ -47,37 +65,43 @@ namespace MSIX {
         ThrowErrorIf(Error::DeflateWrite, m_state == State::Closed, "DeflateStream is already closed");
         // Important! If this stream is asked to write with 0 bytes, then it means that we are done.
         // We need to terminate the stream and call deflate with Z_FINISH.
-        int disposition = Z_FULL_FLUSH;
+        auto flush = CompressionFlush::Full;
         if (countBytes == 0)
         {
-            disposition = Z_FINISH;
+            flush = CompressionFlush::Finish;
             m_state = State::Closed;
         }
-        m_zstrm.next_in = reinterpret_cast<Bytef *>(const_cast<void*>(buffer));
-        m_zstrm.avail_in = static_cast<std::uint32_t>(countBytes);
-        auto toWrite = Deflate(disposition);
-        ThrowHrIfFailed(m_stream->Write(toWrite.data(), static_cast<ULONG>(toWrite.size()), bytesWritten));
+        m_compressionObject->SetInput(reinterpret_cast<std::uint8_t*>(const_cast<void*>(buffer)), countBytes);
+        auto written = Deflate(flush);
+        if (bytesWritten) { *bytesWritten = written; }
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
-    std::vector<std::uint8_t> DeflateStream::Deflate(int disposition)
+    // Compresses the pending input and writes it to the underlying stream. The buffer is sized from deflateBound,
+    // plus room for the empty stored block of the full flush, so the loop normally runs once.
+    ULONG DeflateStream::Deflate(CompressionFlush flush)
     {
-        std::vector<std::uint8_t> compressedBuffer;
-        std::vector<std::uint8_t> deflateBuffer(1024);
+        auto bound = m_compressionObject->GetDeflateBound(m_compressionObject->GetAvailableSourceSize()) + 16;
+        if (m_buffer.size() < bound)
+        {
+            m_buffer.resize(bound);
+        }
+        ULONG total = 0;
         do
         {
-            m_zstrm.next_out = deflateBuffer.data();
-            m_zstrm.avail_out = static_cast<std::uint32_t>(deflateBuffer.size());
-            auto result = deflate(&m_zstrm, disposition);
-            if (disposition == Z_FINISH && result == Z_STREAM_END)
+            m_compressionObject->SetOutput(m_buffer.data(), m_buffer.size());
+            auto result = m_compressionObject->Deflate(flush);
+            if (flush == CompressionFlush::Finish && result == CompressionStatus::End)
             {
-                result = Z_OK;
+                result = CompressionStatus::Ok;
             }
-            ThrowErrorIf(Error::DeflateWrite, result != Z_OK, "Error deflating stream");
-            auto have = deflateBuffer.size() - m_zstrm.avail_out;
-            compressedBuffer.insert(compressedBuffer.end(), deflateBuffer.data(), deflateBuffer.data() + have);
-       } while (m_zstrm.avail_out == 0);
-       return compressedBuffer;
+            ThrowErrorIf(Error::DeflateWrite, result != CompressionStatus::Ok, "Error deflating stream");
+            auto have = static_cast<ULONG>(m_buffer.size() - m_compressionObject->GetAvailableDestinationSize());
+            ULONG written = 0;
+            ThrowHrIfFailed(m_stream->Write(m_buffer.data(), have, &written));
+            total += written;
+        } while (m_compressionObject->GetAvailableDestinationSize() == 0);
+        return total;
     }
 
 }
\ No newline at end of file
@@ -8,7 +8,6 @@
 #include "MsixErrors.hpp"
 #include "Exceptions.hpp"
 #include "ZipFileStream.hpp"
-#include "DeflateStream.hpp"
 #include "StreamHelper.hpp"
 #include "Encoding.hpp"
 
@@ -65,8 +64,9 @@ namespace MSIX {
     }
 
     // IZipWriter
-    std::pair<std::uint32_t, ComPtr<IStream>> ZipObjectWriter::PrepareToAddFile(const std::string& name, bool isCompressed)
+    std::pair<std::uint32_t, ComPtr<IStream>> ZipObjectWriter::PrepareToAddFile(const std::string& name, APPX_COMPRESSION_OPTION compressionOption)
     {
+        bool isCompressed = (compressionOption != APPX_COMPRESSION_OPTION_NONE);
         ThrowErrorIf(Error::InvalidState, m_state != ZipObjectWriter::State::ReadyForLfhOrClose, "Invalid zip writer state");
 
         auto result = m_centralDirectories.find(name);
@@ -88,12 +88,7 @@ namespace MSIX {
         m_lastLFH = std::make_pair(static_cast<std::uint64_t>(pos.QuadPart), std::move(lfh));
         m_state = ZipObjectWriter::State::ReadyForFile;
 
-        ComPtr<IStream> zipStream = ComPtr<IStream>::Make<ZipFileStream>(name, isCompressed, m_stream.Get());
-        if (isCompressed)
-        {
-            zipStream = ComPtr<IStream>::Make<DeflateStream>(zipStream);
-        }
-
+        auto zipStream = ComPtr<IStream>::Make<ZipFileStream>(name, isCompressed, m_stream.Get());
         return std::make_pair(static_cast<std::uint32_t>(m_lastLFH.second.Size()), std::move(zipStream));
     }
 
@@ -31,82 +31,143 @@
 
 namespace MSIX {
 
-    static Block GetBlock(const ComPtr<IXmlElement>& element, std::uint64_t fallbackSize)
+    constexpr std::uint64_t BlockView::NoSize;
+
+    AppxBlockMapObject::AppxBlockMapObject(IMsixFactory* factory, const ComPtr<IStream>& stream) : m_factory(factory), m_stream(stream)
     {
-        Block result {0};
-        auto sizeAttr = GetNumber<std::uint64_t>(element, XmlAttributeName::Size, -1);
-        if (sizeAttr == -1)
+        // A blockmap can have hundreds of thousands of blocks, don't build a DOM for it if the xml implementation
+        // can parse it as a stream.
+        ComPtr<IXmlStreamFactory> xmlStreamFactory;
+        ThrowHrIfFailed(factory->QueryInterface(UuidOfImpl<IXmlStreamFactory>::iid, reinterpret_cast<void**>(&xmlStreamFactory)));
+        if (!ParseStream(xmlStreamFactory.Get(), stream))
         {
-            result.blockSize = BLOCKMAP_BLOCK_SIZE;
-            result.compressedSize = fallbackSize;
+            ComPtr<IXmlFactory> xmlFactory;
+            ThrowHrIfFailed(factory->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));
+            ParseDom(xmlFactory.Get(), stream);
         }
-        else
+        ThrowErrorIf(Error::XmlError, m_blockMap.empty(), "Empty AppxBlockMap.xml");
+
+        // The arrays don't move anymore, hand out views into them.
+        m_hashes.shrink_to_fit();
+        m_blockSizes.shrink_to_fit();
+        for (const auto& file : m_blockMap)
         {
-            result.blockSize = sizeAttr;
-            result.compressedSize = sizeAttr;
+            m_blockMapFiles.insert(std::make_pair(file.first,
+                ComPtr<IAppxBlockMapFile>::Make<AppxBlockMapFile>(
+                    factory,
+                    GetBlockView(file.second),
+                    file.second.localFileHeaderSize,
+                    file.first,
+                    file.second.size
+                )));
         }
-        result.hash = element->GetBase64DecodedAttributeValue(XmlAttributeName::BlockMap_File_Block_Hash);
-        return result;
     }
 
-    AppxBlockMapObject::AppxBlockMapObject(IMsixFactory* factory, const ComPtr<IStream>& stream) : m_factory(factory), m_stream(stream)
+    bool AppxBlockMapObject::ParseStream(IXmlStreamFactory* xmlStreamFactory, const ComPtr<IStream>& stream)
+    {
+        // <BlockMap> at depth 0, <File> at depth 1 and <Block> at depth 2
+        class Handler final : public IXmlStreamHandler
+        {
+        public:
+            Handler(AppxBlockMapObject* self) : m_self(self) {}
+
+            bool StartElement(std::size_t depth, IXmlStreamElement& element) override
+            {
+                if (depth == 0)
+                {
+                    ThrowErrorIfNot(Error::XmlFatal, element.HasLocalName("BlockMap"), "Invalid root element");
+                }
+                else if (depth == 1 && element.HasLocalName("File"))
+                {
+                    m_name = element.GetAttributeValue(XmlAttributeName::Name);
+                    m_file = m_self->StartFile(m_name,
+                        GetNumber<std::uint64_t>(element, XmlAttributeName::Size, BLOCKMAP_BLOCK_SIZE),
+                        GetNumber<std::uint32_t>(element, XmlAttributeName::BlockMap_File_LocalFileHeaderSize, 0));
+                    m_inFile = true;
+                }
+                else if (depth == 2 && m_inFile && element.HasLocalName("Block"))
+                {
+                    auto& hash = m_self->AddBlock(GetNumber<std::uint64_t>(element, XmlAttributeName::Size, BlockView::NoSize));
+                    element.GetBase64DecodedAttributeValue(XmlAttributeName::BlockMap_File_Block_Hash, hash.data(), hash.size());
+                }
+                return true;
+            }
+
+            void EndElement(std::size_t depth) override
+            {
+                if (depth == 1 && m_inFile)
+                {
+                    m_self->EndFile(m_name, m_file);
+                    m_inFile = false;
+                }
+            }
+
+        private:
+            AppxBlockMapObject* m_self;
+            std::string         m_name;
+            FileBlocks          m_file = {};
+            bool                m_inFile = false;
+        };
+
+        Handler handler(this);
+        return xmlStreamFactory->ParseStream(XmlContentType::AppxBlockMapXml, stream, handler);
+    }
+
+    void AppxBlockMapObject::ParseDom(IXmlFactory* xmlFactory, const ComPtr<IStream>& stream)
     {
-        ComPtr<IXmlFactory> xmlFactory;
-        ThrowHrIfFailed(factory->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));
         auto dom = xmlFactory->CreateDomFromStream(XmlContentType::AppxBlockMapXml, stream);
 
         struct _context
         {
             AppxBlockMapObject* self;
-            IMsixFactory*       factory;
-            size_t              countFilesFound;
             IXmlDom*            dom;
         };
-        _context context = { this, factory, 0, dom.Get() };
+        _context context = { this, dom.Get() };
 
         XmlVisitor visitor(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& fileNode)->bool
         {
-            const auto& name = fileNode->GetAttributeValue(XmlAttributeName::Name);
-            ThrowErrorIf(Error::BlockMapSemanticError, (name == "[Content_Types].xml"), "[Content_Types].xml cannot be in the AppxBlockMap.xml file");
-
             _context* context = reinterpret_cast<_context*>(c);
-            std::ostringstream builder;
-            builder << "Duplicate file: '" << name << "' specified in AppxBlockMap.xml.";
-            ThrowErrorIf(Error::BlockMapSemanticError, (context->self->m_blockMap.find(name) != context->self->m_blockMap.end()), builder.str().c_str());
-
-            std::uint64_t sizeAttribute = GetNumber<std::uint64_t>(fileNode, XmlAttributeName::Size, BLOCKMAP_BLOCK_SIZE);
+            const auto& name = fileNode->GetAttributeValue(XmlAttributeName::Name);
+            auto file = context->self->StartFile(name,
+                GetNumber<std::uint64_t>(fileNode, XmlAttributeName::Size, BLOCKMAP_BLOCK_SIZE),
+                GetNumber<std::uint32_t>(fileNode, XmlAttributeName::BlockMap_File_LocalFileHeaderSize, 0));
 
-            std::vector<Block> blocks;
-            struct _contextBlock
+            XmlVisitor visitor(static_cast<void*>(context->self), [](void* c, const ComPtr<IXmlElement>& blockNode)->bool
             {
-                std::vector<Block>* blocks;
-                std::uint64_t fallbackSize;
-            };
-            _contextBlock contextBlock = { &blocks, sizeAttribute};
-            XmlVisitor visitor(static_cast<void*>(&contextBlock), [](void* c, const ComPtr<IXmlElement>& blockNode)->bool
-            {
-                _contextBlock* contextBlock = reinterpret_cast<_contextBlock*>(c);
-                contextBlock->blocks->push_back(GetBlock(blockNode, contextBlock->fallbackSize));
+                AppxBlockMapObject* self = reinterpret_cast<AppxBlockMapObject*>(c);
+                auto& hash = self->AddBlock(GetNumber<std::uint64_t>(blockNode, XmlAttributeName::Size, BlockView::NoSize));
+                blockNode->GetBase64DecodedAttributeValue(XmlAttributeName::BlockMap_File_Block_Hash, hash.data(), hash.size());
                 return true;
             });
             context->dom->ForEachElementIn(fileNode, XmlQueryName::Child_Block, visitor);
 
-            ThrowErrorIf(Error::BlockMapSemanticError, (0 == blocks.size() && 0 != sizeAttribute), "If size is non-zero, then there must be 1+ blocks.");
-
-            context->self->m_blockMap.insert(std::make_pair(name, std::move(blocks)));
-            context->self->m_blockMapFiles.insert(std::make_pair(name,
-                ComPtr<IAppxBlockMapFile>::Make<AppxBlockMapFile>(
-                    context->factory,
-                    &(context->self->m_blockMap[name]),
-                    GetNumber<std::uint32_t>(fileNode, XmlAttributeName::BlockMap_File_LocalFileHeaderSize, 0),
-                    name,
-                    sizeAttribute
-                )));
-            context->countFilesFound++;
+            context->self->EndFile(name, file);
             return true;
         });
         dom->ForEachElementIn(dom->GetDocument(), XmlQueryName::BlockMap_File, visitor);
-        ThrowErrorIf(Error::XmlError, (0 == context.countFilesFound), "Empty AppxBlockMap.xml");
+    }
+
+    AppxBlockMapObject::FileBlocks AppxBlockMapObject::StartFile(const std::string& name, std::uint64_t size, std::uint32_t localFileHeaderSize)
+    {
+        ThrowErrorIf(Error::BlockMapSemanticError, (name == "[Content_Types].xml"), "[Content_Types].xml cannot be in the AppxBlockMap.xml file");
+        std::ostringstream builder;
+        builder << "Duplicate file: '" << name << "' specified in AppxBlockMap.xml.";
+        ThrowErrorIf(Error::BlockMapSemanticError, (m_blockMap.find(name) != m_blockMap.end()), builder.str().c_str());
+        return { m_hashes.size(), 0, size, localFileHeaderSize };
+    }
+
+    SHA256::Hash& AppxBlockMapObject::AddBlock(std::uint64_t size)
+    {
+        m_blockSizes.push_back(size);
+        m_hashes.emplace_back();
+        return m_hashes.back();
+    }
+
+    void AppxBlockMapObject::EndFile(const std::string& name, FileBlocks& file)
+    {
+        file.count = m_hashes.size() - file.first;
+        ThrowErrorIf(Error::BlockMapSemanticError, (0 == file.count && 0 != file.size), "If size is non-zero, then there must be 1+ blocks.");
+        m_blockMap.insert(std::make_pair(name, file));
     }
 
     // IVerifierObject
@@ -117,7 +178,7 @@ namespace MSIX {
         std::ostringstream builder;
         builder << "file: '" << part << "' not tracked by blockmap.";
         ThrowErrorIf(Error::BlockMapSemanticError, item == m_blockMap.end(), builder.str().c_str());
-        return ComPtr<IStream>::Make<BlockMapStream>(m_factory, part, stream, item->second);
+        return ComPtr<IStream>::Make<BlockMapStream>(m_factory, part, stream, GetBlockView(item->second));
     }
 
     // IAppxBlockMapReader
@@ -168,11 +229,11 @@ namespace MSIX {
         return fileNames;
     }
 
-    std::vector<Block> AppxBlockMapObject::GetBlocks(const std::string& fileName)
+    BlockView AppxBlockMapObject::GetBlocks(const std::string& fileName)
     {
         auto index = m_blockMap.find(fileName);
         ThrowErrorIf(Error::FileNotFound, (index == m_blockMap.end()), "File not in blockmap");
-        return index->second;
+        return GetBlockView(index->second);
     }
 
     ComPtr<IAppxBlockMapFile> AppxBlockMapObject::GetFile(const std::string& fileName)
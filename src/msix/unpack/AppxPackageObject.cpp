@@ -32,6 +32,11 @@
 #include <limits>
 #include <algorithm>
 #include <array>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 namespace MSIX {
 
@@ -52,6 +57,12 @@ namespace MSIX {
         }
         m_appxSignature = ComPtr<IVerifierObject>::Make<AppxSignatureObject>(factory, validation, file);
 
+        // The signature also has digests over the zip records themselves. Those can only be checked when the
+        // package comes from a zip file; the file records are hashed as they get read and verified in Unpack.
+        if (SUCCEEDED(m_container->QueryInterface(UuidOfImpl<IZipReader>::iid, reinterpret_cast<void**>(&m_zipReader))))
+        {   m_appxSignature.As<IZipDigestVerifier>()->ValidateCentralDirectory(m_zipReader);
+        }
+
         // 2. Get content type using signature object for validation
         file = m_container->GetFile(CONTENT_TYPES_XML);
         ThrowErrorIfNot(Error::MissingContentTypesXML, file, "[Content_Types].xml not in archive!");
@@ -354,12 +365,12 @@ namespace MSIX {
 
         auto blocks = blockMapInternal->GetBlocks(fileName);
         std::uint64_t blocksSize = 0;
-        for(auto& block : blocks)
+        for (std::size_t index = 0; index < blocks.size(); index++)
         {   // For Block elements that don't have a Size attribute, we always set its size as BLOCKMAP_BLOCK_SIZE
             // (even for the last one). The Size attribute isn't specified if the file is not compressed.
-            ThrowErrorIf(Error::BlockMapSemanticError, (!isCompressed) && (block.blockSize != BLOCKMAP_BLOCK_SIZE),
+            ThrowErrorIf(Error::BlockMapSemanticError, (!isCompressed) && (blocks.BlockSize(index) != BLOCKMAP_BLOCK_SIZE),
                 "An uncompressed file has a size attribute in its Block elements");
-            blocksSize += block.blockSize;
+            blocksSize += blocks.BlockSize(index);
         }
 
         if(isCompressed)
@@ -393,6 +404,263 @@ namespace MSIX {
         }
     }
 
+    namespace {
+
+    // Hashes blocks of payload files on a set of worker threads while the caller keeps reading the package.
+    // The reading (and inflating) stays on the calling thread because all the file streams of a package
+    // share the package stream.
+    class BlockHashPool
+    {
+    public:
+        static constexpr std::size_t BlocksPerBatch = 16;
+
+        struct Batch
+        {
+            std::string                             fileName;
+            std::uint32_t                           firstBlock = 0;
+            std::vector<std::uint8_t>               data; // blocks are BLOCKMAP_BLOCK_SIZE apart
+            std::vector<std::size_t>                sizes;
+            std::vector<SHA256::Hash>               expected;
+        };
+
+        BlockHashPool(std::uint32_t threadCount)
+        {
+            if (threadCount == 0)
+            {   threadCount = std::max(1u, std::thread::hardware_concurrency());
+            }
+            m_maxQueued = threadCount * 2;
+            for (std::uint32_t i = 0; i < threadCount; i++)
+            {   m_threads.emplace_back([this]() { Work(); });
+            }
+        }
+
+        ~BlockHashPool() { Finish(); }
+
+        // Waits while the queue is full, so only a few batches are in memory at any time.
+        void Submit(Batch&& batch)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready.wait(lock, [this]() { return m_queue.size() < m_maxQueued; });
+            m_queue.push_back(std::move(batch));
+            m_pending.notify_one();
+        }
+
+        std::vector<VerificationFailure> Finish()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_done = true;
+            }
+            m_pending.notify_all();
+            for (auto& thread : m_threads)
+            {   thread.join();
+            }
+            m_threads.clear();
+            return std::move(m_failures);
+        }
+
+    protected:
+        void Work()
+        {
+            std::array<const std::uint8_t*, BlocksPerBatch> buffers;
+            std::array<SHA256::Hash, BlocksPerBatch> hashes;
+            for (;;)
+            {
+                Batch batch;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_pending.wait(lock, [this]() { return m_done || !m_queue.empty(); });
+                    if (m_queue.empty()) { return; }
+                    batch = std::move(m_queue.front());
+                    m_queue.pop_front();
+                }
+                m_ready.notify_one();
+
+                std::size_t count = batch.sizes.size();
+                for (std::size_t i = 0; i < count; i++)
+                {   buffers[i] = batch.data.data() + (i * BLOCKMAP_BLOCK_SIZE);
+                }
+                std::vector<VerificationFailure> failures;
+                try
+                {
+                    SHA256::ComputeHashes(buffers.data(), batch.sizes.data(), hashes.data(), count);
+                    for (std::size_t i = 0; i < count; i++)
+                    {
+                        if (batch.expected[i] != hashes[i])
+                        {   failures.push_back({ batch.fileName, batch.firstBlock + static_cast<std::uint32_t>(i), static_cast<HRESULT>(Error::SignatureInvalid) });
+                        }
+                    }
+                }
+                // Nothing can leave a worker thread, whatever went wrong is reported for the file like any other failure.
+                catch (Exception& e)
+                {   failures.push_back({ batch.fileName, MSIX_VERIFICATION_FILE, static_cast<HRESULT>(e.Code()) });
+                }
+                catch (const std::bad_alloc&)
+                {   failures.push_back({ batch.fileName, MSIX_VERIFICATION_FILE, static_cast<HRESULT>(Error::OutOfMemory) });
+                }
+                catch (...)
+                {   failures.push_back({ batch.fileName, MSIX_VERIFICATION_FILE, static_cast<HRESULT>(Error::Unexpected) });
+                }
+                if (!failures.empty())
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_failures.insert(m_failures.end(), failures.begin(), failures.end());
+                }
+            }
+        }
+
+        std::vector<std::thread>            m_threads;
+        std::mutex                          m_mutex;
+        std::condition_variable             m_pending;  // signaled when a batch is queued or there are no more
+        std::condition_variable             m_ready;    // signaled when a batch is taken off the queue
+        std::deque<Batch>                   m_queue;
+        std::size_t                         m_maxQueued = 0;
+        bool                                m_done = false;
+        std::vector<VerificationFailure>    m_failures;
+    };
+
+    constexpr std::size_t BlockHashPool::BlocksPerBatch;
+
+    // Reads a payload file block by block and hands the blocks with their expected hashes to the pool.
+    void SubmitFileBlocks(BlockHashPool& pool, const ComPtr<IStream>& stream, const std::string& fileName, const std::string& reportedName,
+        const ComPtr<IAppxBlockMapInternal>& blockMapInternal)
+    {
+        UINT64 remaining = 0;
+        ThrowHrIfFailed(blockMapInternal->GetFile(fileName)->GetUncompressedSize(&remaining));
+        auto blocks = blockMapInternal->GetBlocks(fileName);
+        ThrowErrorIf(Error::BlockMapSemanticError, (blocks.size() != ((remaining + BLOCKMAP_BLOCK_SIZE - 1) / BLOCKMAP_BLOCK_SIZE)),
+            "Number of blocks doesn't match the size of the file in the block map");
+
+        LARGE_INTEGER start = { 0 };
+        ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::START, nullptr));
+
+        BlockHashPool::Batch batch;
+        for (std::uint32_t index = 0; index < blocks.size(); index++)
+        {
+            if (batch.sizes.empty())
+            {
+                batch.fileName = reportedName;
+                batch.firstBlock = index;
+                batch.data.resize(BlockHashPool::BlocksPerBatch * BLOCKMAP_BLOCK_SIZE);
+            }
+            auto buffer = batch.data.data() + (batch.sizes.size() * BLOCKMAP_BLOCK_SIZE);
+            ULONG size = static_cast<ULONG>(std::min(static_cast<std::uint64_t>(remaining), BLOCKMAP_BLOCK_SIZE));
+            ULONG total = 0;
+            while (total < size)
+            {
+                ULONG read = 0;
+                ThrowHrIfFailed(stream->Read(buffer + total, size - total, &read));
+                ThrowErrorIf(Error::BlockMapSemanticError, (read == 0), "File is smaller than described in the block map");
+                total += read;
+            }
+            remaining -= size;
+            batch.sizes.push_back(size);
+            batch.expected.push_back(blocks.Hash(index));
+            if (batch.sizes.size() == BlockHashPool::BlocksPerBatch)
+            {   pool.Submit(std::move(batch));
+                batch = BlockHashPool::Batch();
+            }
+        }
+        if (!batch.sizes.empty())
+        {   pool.Submit(std::move(batch));
+        }
+
+        std::uint8_t extra = 0;
+        ULONG read = 0;
+        ThrowHrIfFailed(stream->Read(&extra, 1, &read));
+        ThrowErrorIf(Error::BlockMapSemanticError, (read != 0), "File is larger than described in the block map");
+    }
+
+    }
+
+    void AppxPackageObject::Verify(std::uint32_t threadCount, std::vector<VerificationFailure>& failures)
+    {
+        #ifdef BUNDLE_SUPPORT
+        if (m_isBundle)
+        {   // The blockmap of a bundle only describes AppxBundleManifest.xml, which was validated when the bundle was opened.
+            VerifyBundlePackages(threadCount, failures);
+        }
+        #endif
+
+        auto blockMapInternal = m_appxBlockMap.As<IAppxBlockMapInternal>();
+        BlockHashPool pool(threadCount);
+        for (const auto& fileName : (m_isBundle ? std::vector<std::string>() : blockMapInternal->GetFileNames()))
+        {
+            auto opcFileName = Encoding::EncodeFileName(fileName);
+            if (std::find(m_footprintFiles.begin(), m_footprintFiles.end(), opcFileName) != m_footprintFiles.end())
+            {   continue;
+            }
+            auto reportedName = Encoding::DecodeFileName(opcFileName);
+            try
+            {   // Go to the container directly, the streams in m_files validate each block as it is read.
+                auto stream = m_container->GetFile(opcFileName);
+                ThrowErrorIfNot(Error::FileNotFound, stream, "File described in blockmap not contained in OPC container");
+                SubmitFileBlocks(pool, stream, fileName, reportedName, blockMapInternal);
+            }
+            catch (Exception& e)
+            {   failures.push_back({ reportedName, MSIX_VERIFICATION_FILE, static_cast<HRESULT>(e.Code()) });
+            }
+        }
+        auto blockFailures = pool.Finish();
+        failures.insert(failures.end(), blockFailures.begin(), blockFailures.end());
+
+        if (m_zipReader)
+        {
+            try
+            {   m_appxSignature.As<IZipDigestVerifier>()->ValidateFileRecords(m_zipReader);
+            }
+            catch (Exception& e)
+            {   failures.push_back({ APPXSIGNATURE_P7X, MSIX_VERIFICATION_FILE, static_cast<HRESULT>(e.Code()) });
+            }
+        }
+
+        std::sort(failures.begin(), failures.end(), [](const VerificationFailure& a, const VerificationFailure& b)
+        {
+            return (a.fileName < b.fileName) || ((a.fileName == b.fileName) && (a.blockIndex < b.blockIndex));
+        });
+    }
+
+    #ifdef BUNDLE_SUPPORT
+    void AppxPackageObject::VerifyBundlePackages(std::uint32_t threadCount, std::vector<VerificationFailure>& failures)
+    {
+        auto appxFactory = m_factory.As<IAppxFactory>();
+        for (const auto& package : m_appxBundleManifest.As<IBundleInfo>()->GetPackages())
+        {
+            auto packageName = package.As<IAppxBundleManifestPackageInfoInternal>()->GetFileName();
+            try
+            {
+                // The applicable packages are already open, the others are opened only for as long as they are verified.
+                ComPtr<IAppxPackageReader> reader;
+                auto applicable = std::find(m_applicablePackagesNames.begin(), m_applicablePackagesNames.end(), packageName);
+                if (applicable != m_applicablePackagesNames.end())
+                {
+                    reader = m_applicablePackages[std::distance(m_applicablePackagesNames.begin(), applicable)];
+                }
+                else
+                {
+                    auto file = m_files.find(packageName);
+                    ThrowErrorIf(Error::FileNotFound, (file == m_files.end()), "Package is not in container");
+                    ComPtr<IStream> stream;
+                    ThrowHrIfFailed(file->second->GetStream(&stream));
+                    ThrowHrIfFailed(stream->Seek({0}, StreamBase::Reference::START, nullptr));
+                    ThrowHrIfFailed(appxFactory->CreatePackageReader(stream.Get(), &reader));
+                }
+
+                std::vector<VerificationFailure> packageFailures;
+                reader.As<IPackage>()->Verify(threadCount, packageFailures);
+                for (auto& failure : packageFailures)
+                {
+                    failure.fileName = packageName + "/" + failure.fileName;
+                    failures.push_back(std::move(failure));
+                }
+            }
+            catch (Exception& e)
+            {   failures.push_back({ packageName, MSIX_VERIFICATION_FILE, static_cast<HRESULT>(e.Code()) });
+            }
+        }
+    }
+    #endif
+
     void AppxPackageObject::Unpack(MSIX_PACKUNPACK_OPTION options, const ComPtr<IDirectoryObject>& to)
     {
         auto fileNames = GetFileNames(FileNameOptions::All);
@@ -463,6 +731,10 @@ namespace MSIX {
             }
         }
 #endif
+
+        if (m_zipReader)
+        {   m_appxSignature.As<IZipDigestVerifier>()->ValidateFileRecords(m_zipReader);
+        }
     }
 
     // IStorageObject
@@ -644,4 +916,91 @@ namespace MSIX {
         *payloadPackage = result.Detach();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
+
+    namespace
+    {
+        // The attributes of the Identity element. Bundles don't have a ResourceId attribute or an architecture in
+        // their manifest, see AppxBundleManifestObject.
+        struct PackageIdentity
+        {
+            bool isBundle = false;
+            bool found = false;
+            std::string name;
+            std::string version;
+            std::string resourceId;
+            std::string architecture;
+            std::string publisher;
+
+            // Element is either an IXmlStreamElement or an IXmlElement
+            template <class Element>
+            void Read(Element& element)
+            {
+                name = element.GetAttributeValue(XmlAttributeName::Name);
+                version = element.GetAttributeValue(XmlAttributeName::Version);
+                publisher = element.GetAttributeValue(XmlAttributeName::Publisher);
+                resourceId = isBundle ? "~" : element.GetAttributeValue(XmlAttributeName::ResourceId);
+                architecture = isBundle ? "neutral" : element.GetAttributeValue(XmlAttributeName::Identity_ProcessorArchitecture);
+                found = true;
+            }
+        };
+
+        // <Package> or <Bundle> at depth 0 and <Identity> at depth 1, stops right after the Identity element.
+        class PackageIdentityHandler final : public IXmlStreamHandler
+        {
+        public:
+            PackageIdentityHandler(PackageIdentity& identity) : m_identity(identity) {}
+
+            bool StartElement(std::size_t depth, IXmlStreamElement& element) override
+            {
+                if (depth == 0)
+                {
+                    ThrowErrorIfNot(Error::XmlFatal, element.HasLocalName(m_identity.isBundle ? "Bundle" : "Package"), "Invalid root element");
+                }
+                else if (depth == 1 && element.HasLocalName("Identity"))
+                {
+                    m_identity.Read(element);
+                    return false;
+                }
+                return true;
+            }
+
+            void EndElement(std::size_t depth) override {}
+
+        private:
+            PackageIdentity& m_identity;
+        };
+    }
+
+    ComPtr<IAppxManifestPackageId> GetPackageIdentity(IMsixFactory* factory, const ComPtr<IStream>& stream)
+    {
+        auto zip = ComPtr<IStorageObject>::Make<ZipObjectReader>(stream);
+        PackageIdentity identity;
+        auto manifest = zip->GetFile(APPXMANIFEST_XML);
+        if (!manifest)
+        {
+            manifest = zip->GetFile(APPXBUNDLEMANIFEST_XML);
+            identity.isBundle = true;
+        }
+        ThrowErrorIfNot(Error::MissingAppxManifestXML, manifest, "AppxManifest.xml not in archive!");
+        auto footPrintType = identity.isBundle ? XmlContentType::AppxBundleManifestXml : XmlContentType::AppxManifestXml;
+
+        ComPtr<IXmlStreamFactory> xmlStreamFactory;
+        ThrowHrIfFailed(factory->QueryInterface(UuidOfImpl<IXmlStreamFactory>::iid, reinterpret_cast<void**>(&xmlStreamFactory)));
+        PackageIdentityHandler handler(identity);
+        if (!xmlStreamFactory->ScanStream(footPrintType, manifest, handler))
+        {   // The XML implementation can't parse as a stream, read the identity from the whole document.
+            ComPtr<IXmlFactory> xmlFactory;
+            ThrowHrIfFailed(factory->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));
+            auto dom = xmlFactory->CreateDomFromStream(footPrintType, manifest);
+            XmlVisitor visitor(static_cast<void*>(&identity), [](void* c, const ComPtr<IXmlElement>& identityNode)->bool
+            {
+                reinterpret_cast<PackageIdentity*>(c)->Read(*identityNode.Get());
+                return false;
+            });
+            dom->ForEachElementIn(dom->GetDocument(), identity.isBundle ? XmlQueryName::Bundle_Identity : XmlQueryName::Package_Identity, visitor);
+        }
+        ThrowErrorIf(Error::AppxManifestSemanticError, (!identity.found || identity.publisher.empty()), "Invalid Identity element");
+        return ComPtr<IAppxManifestPackageId>::Make<AppxManifestPackageId>(factory, identity.name, identity.version,
+            identity.resourceId, identity.architecture, identity.publisher);
+    }
 }
\ No newline at end of file
@@ -94,9 +94,29 @@ ComPtr<IStream>  AppxSignatureObject::GetValidationStream(const std::string& par
         {   // This stream implementation will throw if the underlying stream does not match the digest
             return ComPtr<IStream>::Make<HashStream>(stream, this->GetCodeIntegrityDigest());
         }
-        // TODO: unnamed stream for central directory?
     }
     return stream;
 }
 
+void AppxSignatureObject::ValidateCentralDirectory(const ComPtr<IZipReader>& zip)
+{
+    if (m_hasDigests)
+    {
+        ThrowErrorIf(Error::SignatureInvalid, (zip->GetCentralDirectoryDigest(APPXSIGNATURE_P7X) != GetCentralDirectoryDigest()),
+            "Central directory digest mismatch");
+        zip->StartFileRecordsDigest(APPXSIGNATURE_P7X);
+    }
+}
+
+void AppxSignatureObject::ValidateFileRecords(const ComPtr<IZipReader>& zip)
+{
+    if (m_hasDigests)
+    {
+        ThrowErrorIf(Error::SignatureInvalid, (zip->GetFileRecordsDigest() != GetFileRecordsDigest()),
+            "File records digest mismatch");
+        // Keep tracking in case the package gets read again.
+        zip->StartFileRecordsDigest(APPXSIGNATURE_P7X);
+    }
+}
+
 } // namespace MSIX
@@ -6,6 +6,7 @@
 #include "ZipFileStream.hpp"
 #include "InflateStream.hpp"
 #include "StreamBase.hpp"
+#include "CompressionObjectPool.hpp"
 
 #include <cassert>
 #include <algorithm>
@@ -35,8 +36,9 @@ namespace MSIX {
             self->m_fileCurrentPosition = 0;
             self->m_fileCurrentWindowPositionEnd = 0;
 
-            self->m_compressionStatus = self->m_compressionObject->Initialize(CompressionOperation::Inflate);
-            ThrowErrorIfNot(Error::InflateInitialize, (self->m_compressionStatus == CompressionStatus::Ok), "compression_stream_init failed");
+            // The state is only held while inflating, Cleanup gives it back to the pool.
+            self->m_compressionObject = CompressionObjectPool::Inflate().Acquire();
+            self->m_compressionStatus = CompressionStatus::Ok;
             return std::make_pair(true, InflateStream::State::READY_TO_READ);
         }), // State::UNINITIALIZED
 
@@ -137,7 +139,6 @@ namespace MSIX {
         m_state(State::UNINITIALIZED),
         m_uncompressedSize(uncompressedSize)
     {
-        m_compressionObject = CreateCompressionObject();
     }
 
     InflateStream::~InflateStream()
@@ -206,7 +207,7 @@ namespace MSIX {
     {
         if (m_state != State::UNINITIALIZED)
         {
-            m_compressionObject->Cleanup();
+            CompressionObjectPool::Inflate().Release(std::move(m_compressionObject));
             m_state = State::UNINITIALIZED;
         }
     }
@@ -0,0 +1,253 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "Exceptions.hpp"
+#include "ReadAheadStream.hpp"
+#include "StreamBase.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace MSIX {
+
+    constexpr std::uint32_t ReadAheadStream::PageSize;
+    constexpr size_t ReadAheadStream::MaxPages;
+    constexpr size_t ReadAheadStream::MaxReadAheadPages;
+    constexpr size_t ReadAheadStream::MaxPendingDigest;
+
+    ReadAheadStream::ReadAheadStream(const ComPtr<IStream>& stream) : m_stream(stream)
+    {
+        ThrowErrorIfNot(Error::InvalidParameter, m_stream, "Invalid stream");
+        LARGE_INTEGER start = { 0 };
+        ULARGE_INTEGER end = { 0 };
+        ThrowHrIfFailed(m_stream->Seek(start, StreamBase::Reference::END, &end));
+        ThrowHrIfFailed(m_stream->Seek(start, StreamBase::Reference::START, nullptr));
+        m_size = end.QuadPart;
+    }
+
+    HRESULT ReadAheadStream::Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER *newPosition) noexcept try
+    {
+        LARGE_INTEGER newPos = { 0 };
+        switch (origin)
+        {
+        case Reference::CURRENT:
+            newPos.QuadPart = m_position + move.QuadPart;
+            break;
+        case Reference::START:
+            newPos.QuadPart = move.QuadPart;
+            break;
+        case Reference::END:
+            newPos.QuadPart = m_size + move.QuadPart;
+            break;
+        default:
+            ThrowErrorAndLog(Error::InvalidParameter, "Invalid seek origin");
+        }
+        if (newPos.QuadPart < 0)
+        {   // Let the underlying stream decide whether this is an error or gets clamped.
+            ULARGE_INTEGER pos = { 0 };
+            ThrowHrIfFailed(m_stream->Seek(newPos, StreamBase::Reference::START, &pos));
+            newPos.QuadPart = static_cast<LONGLONG>(pos.QuadPart);
+        }
+        // Seeking is free otherwise; the underlying stream is only positioned when we actually need to read from it.
+        m_position = static_cast<std::uint64_t>(newPos.QuadPart);
+        if (newPosition) { newPosition->QuadPart = m_position; }
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    HRESULT ReadAheadStream::Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept try
+    {
+        if (bytesRead) { *bytesRead = 0; }
+        ThrowErrorIf(Error::InvalidParameter, (buffer == nullptr && countBytes != 0), "Invalid buffer");
+
+        // Grow the read ahead window while the caller keeps reading where it left off and
+        // fall back to a single page as soon as it jumps somewhere else.
+        if (m_position == m_lastReadEnd)
+        {   m_readAheadPages = std::min(m_readAheadPages * 2, MaxReadAheadPages);
+        }
+        else
+        {   m_readAheadPages = 1;
+        }
+
+        auto out = reinterpret_cast<std::uint8_t*>(buffer);
+        ULONG total = 0;
+        while ((total < countBytes) && (m_position < m_size))
+        {
+            std::uint64_t index = m_position / PageSize;
+            const Page* page = FindPage(index);
+            if (page == nullptr)
+            {
+                ULONG remaining = countBytes - total;
+                if (remaining >= PageSize)
+                {   // Reads of a page or more gain nothing from the cache, hand them straight to the source.
+                    ULONG read = ReadFromSource(m_position, out + total, remaining);
+                    total += read;
+                    m_position += read;
+                    break;
+                }
+                page = FillPages(index);
+            }
+            ULONG offsetInPage = static_cast<ULONG>(m_position - (index * PageSize));
+            ULONG toCopy = std::min(countBytes - total, static_cast<ULONG>(page->data.size() - offsetInPage));
+            std::memcpy(out + total, page->data.data() + offsetInPage, toCopy);
+            total += toCopy;
+            m_position += toCopy;
+        }
+        m_lastReadEnd = m_position;
+        if (bytesRead) { *bytesRead = total; }
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    const ReadAheadStream::Page* ReadAheadStream::FindPage(std::uint64_t index)
+    {
+        auto page = std::find_if(m_pages.begin(), m_pages.end(), [index](const Page& p) { return p.index == index; });
+        if (page == m_pages.end()) { return nullptr; }
+        m_pages.splice(m_pages.begin(), m_pages, page);
+        return &m_pages.front();
+    }
+
+    // Reads the requested page plus as many of the following pages as the current read ahead
+    // window allows with a single call into the underlying stream. Stops early at the end of
+    // the stream or at a page that is already cached.
+    const ReadAheadStream::Page* ReadAheadStream::FillPages(std::uint64_t index)
+    {
+        std::uint64_t lastPage = (m_size - 1) / PageSize;
+        std::uint64_t count = std::min(static_cast<std::uint64_t>(m_readAheadPages), lastPage - index + 1);
+        for (std::uint64_t i = 1; i < count; i++)
+        {
+            auto cached = std::find_if(m_pages.begin(), m_pages.end(), [&](const Page& p) { return p.index == index + i; });
+            if (cached != m_pages.end())
+            {
+                count = i;
+                break;
+            }
+        }
+
+        std::uint64_t start = index * PageSize;
+        ULONG length = static_cast<ULONG>(std::min(count * PageSize, m_size - start));
+        std::vector<std::uint8_t> data(length);
+        ULONG read = ReadFromSource(start, data.data(), length);
+        ThrowErrorIf(Error::FileRead, (read != length), "Did not read as much as requested.");
+
+        // Insert in reverse so the requested page ends up being the most recently used.
+        for (std::uint64_t i = count; i-- > 0;)
+        {
+            Page page;
+            if (m_pages.size() >= MaxPages)
+            {   // Recycle the least recently used page
+                page = std::move(m_pages.back());
+                m_pages.pop_back();
+            }
+            auto begin = data.begin() + static_cast<std::ptrdiff_t>(i * PageSize);
+            auto end = data.begin() + static_cast<std::ptrdiff_t>(std::min(static_cast<std::uint64_t>(length), (i + 1) * PageSize));
+            page.index = index + i;
+            page.data.assign(begin, end);
+            m_pages.push_front(std::move(page));
+        }
+        return &m_pages.front();
+    }
+
+    ULONG ReadAheadStream::ReadFromSource(std::uint64_t position, void* buffer, ULONG countBytes)
+    {
+        LARGE_INTEGER pos = { 0 };
+        pos.QuadPart = static_cast<LONGLONG>(position);
+        ThrowHrIfFailed(m_stream->Seek(pos, StreamBase::Reference::START, nullptr));
+        auto out = reinterpret_cast<std::uint8_t*>(buffer);
+        ULONG total = 0;
+        while (total < countBytes)
+        {
+            ULONG read = 0;
+            ThrowHrIfFailed(m_stream->Read(out + total, countBytes - total, &read));
+            if (read == 0) { break; }
+            total += read;
+        }
+        UpdatePrefixDigest(position, out, total);
+        return total;
+    }
+
+    void ReadAheadStream::StartPrefixDigest(std::uint64_t length)
+    {
+        ThrowErrorIf(Error::InvalidParameter, (length > m_size), "Digest past the end of the stream");
+        m_prefixDigest = std::make_unique<SHA256>();
+        m_prefixDigestLength = length;
+        m_prefixDigestPosition = 0;
+        m_pendingDigest.clear();
+        m_pendingDigestSize = 0;
+        // Pick up whatever is already cached, only what was read before and is gone by now has to be read again.
+        for (auto page = m_pages.rbegin(); page != m_pages.rend(); page++)
+        {
+            UpdatePrefixDigest(page->index * PageSize, page->data.data(), page->data.size());
+        }
+    }
+
+    std::vector<std::uint8_t> ReadAheadStream::GetPrefixDigest()
+    {
+        ThrowErrorIfNot(Error::Unexpected, m_prefixDigest, "Prefix digest not started");
+        if (m_prefixDigestPosition < m_prefixDigestLength)
+        {   // Read the gaps that were never read, like data descriptors and anything that was skipped, bypassing
+            // the cache. Each read continues the digest and lets it take the data held after the gap.
+            std::vector<std::uint8_t> buffer;
+            while (m_prefixDigestPosition < m_prefixDigestLength)
+            {
+                std::uint64_t gapEnd = m_pendingDigest.empty() ? m_prefixDigestLength :
+                    std::min(m_prefixDigestLength, m_pendingDigest.begin()->first);
+                ULONG count = static_cast<ULONG>(std::min(static_cast<std::uint64_t>(PageSize * MaxReadAheadPages), gapEnd - m_prefixDigestPosition));
+                buffer.resize(count);
+                ULONG read = ReadFromSource(m_prefixDigestPosition, buffer.data(), count);
+                ThrowErrorIf(Error::FileRead, (read != count), "Did not read as much as requested.");
+            }
+        }
+        std::vector<std::uint8_t> result;
+        m_prefixDigest->Get(result);
+        m_prefixDigest.reset();
+        m_pendingDigest.clear();
+        m_pendingDigestSize = 0;
+        return result;
+    }
+
+    // Adds data that was read at position to the prefix digest. Data past where the digest is at is held until
+    // the digest gets there, as long as what's held stays under MaxPendingDigest. Anything dropped is read again
+    // by GetPrefixDigest.
+    void ReadAheadStream::UpdatePrefixDigest(std::uint64_t position, const std::uint8_t* data, std::uint64_t count)
+    {
+        if (!m_prefixDigest || (position >= m_prefixDigestLength) || (position + count <= m_prefixDigestPosition))
+        {   return;
+        }
+        count = std::min(count, m_prefixDigestLength - position);
+        if (position > m_prefixDigestPosition)
+        {
+            auto pending = m_pendingDigest.find(position);
+            if ((pending != m_pendingDigest.end() && pending->second.size() >= count) ||
+                (m_pendingDigestSize + count > MaxPendingDigest))
+            {   return;
+            }
+            if (pending != m_pendingDigest.end())
+            {   m_pendingDigestSize -= pending->second.size();
+            }
+            m_pendingDigest[position].assign(data, data + count);
+            m_pendingDigestSize += static_cast<std::size_t>(count);
+            return;
+        }
+        AddToPrefixDigest(position, data, count);
+
+        // The digest may have reached data that came in earlier.
+        while (!m_pendingDigest.empty() && (m_pendingDigest.begin()->first <= m_prefixDigestPosition))
+        {
+            auto pending = m_pendingDigest.begin();
+            std::vector<std::uint8_t> held = std::move(pending->second);
+            std::uint64_t heldPosition = pending->first;
+            m_pendingDigestSize -= held.size();
+            m_pendingDigest.erase(pending);
+            AddToPrefixDigest(heldPosition, held.data(), held.size());
+        }
+    }
+
+    // Hashes the part of data, which starts at or before the digest position, that the digest doesn't have yet.
+    void ReadAheadStream::AddToPrefixDigest(std::uint64_t position, const std::uint8_t* data, std::uint64_t count)
+    {
+        std::uint64_t end = position + count;
+        if (end <= m_prefixDigestPosition) { return; }
+        m_prefixDigest->Add(data + (m_prefixDigestPosition - position), static_cast<std::size_t>(end - m_prefixDigestPosition));
+        m_prefixDigestPosition = end;
+    }
+}
@@ -8,11 +8,17 @@
 #include "ZipFileStream.hpp"
 #include "InflateStream.hpp"
 
+#include "Crypto.hpp"
+
+#include <limits>
 #include <vector>
 
 namespace MSIX {
 
-    ZipObjectReader::ZipObjectReader(const ComPtr<IStream>& stream) : ZipObject(stream)
+    // All the streams for the files in the package share the read ahead stream, so the many small reads done while
+    // parsing the zip headers and reading the files are served from a handful of larger reads to the package stream.
+    ZipObjectReader::ZipObjectReader(const ComPtr<IStream>& stream) : ZipObject(ComPtr<IStream>::Make<ReadAheadStream>(stream)),
+        m_readAheadStream(static_cast<ReadAheadStream*>(m_stream.Get()))
     {
         LARGE_INTEGER pos = {0};
         pos.QuadPart = m_endCentralDirectoryRecord.Size();
@@ -43,6 +49,9 @@ namespace MSIX {
             totalNumberOfEntries = m_zip64EndOfCentralDirectory.GetTotalNumberOfEntries();
         }
 
+        m_offsetStartOfCD = offsetStartOfCD;
+        m_totalNumberOfEntries = totalNumberOfEntries;
+
         // read the zip central directory
         pos.QuadPart = offsetStartOfCD;
         ThrowHrIfFailed(m_stream->Seek(pos, StreamBase::Reference::START, nullptr));
@@ -85,20 +94,7 @@ namespace MSIX {
             {
                 return ComPtr<IStream>();
             }
-            LARGE_INTEGER pos = {0};
-            pos.QuadPart = centralFileHeader->second.GetRelativeOffsetOfLocalHeader();
-            ThrowHrIfFailed(m_stream->Seek(pos, MSIX::StreamBase::Reference::START, nullptr));
-            LocalFileHeader lfh = LocalFileHeader();
-            lfh.Read(m_stream.Get(), centralFileHeader->second);
-
-            auto fileStream = ComPtr<IStream>::Make<ZipFileStream>(
-                centralFileHeader->first,
-                centralFileHeader->second.GetCompressionMethod() == CompressionType::Deflate,
-                centralFileHeader->second.GetRelativeOffsetOfLocalHeader() + lfh.Size(),
-                centralFileHeader->second.GetCompressedSize(),
-                m_stream.Get()
-            );
-
+            auto fileStream = MakeZipFileStream(centralFileHeader->first, centralFileHeader->second);
             if (centralFileHeader->second.GetCompressionMethod() == CompressionType::Deflate)
             {
                 fileStream = ComPtr<IStream>::Make<InflateStream>(std::move(fileStream), centralFileHeader->second.GetUncompressedSize());
@@ -110,8 +106,127 @@ namespace MSIX {
         return result->second;
     }
 
+    ComPtr<IStream> ZipObjectReader::GetRawFile(const std::string& fileName, std::uint32_t& crc, std::uint64_t& uncompressedSize)
+    {
+        auto centralFileHeader = m_centralDirectories.find(fileName);
+        if (centralFileHeader == m_centralDirectories.end())
+        {
+            return ComPtr<IStream>();
+        }
+        crc = centralFileHeader->second.GetCrc();
+        uncompressedSize = centralFileHeader->second.GetUncompressedSize();
+        return MakeZipFileStream(centralFileHeader->first, centralFileHeader->second);
+    }
+
+    // Reads the lfh of the file to find where its data starts and returns the stream over it.
+    ComPtr<IStream> ZipObjectReader::MakeZipFileStream(const std::string& name, CentralDirectoryFileHeader& centralFileHeader)
+    {
+        LARGE_INTEGER pos = {0};
+        pos.QuadPart = centralFileHeader.GetRelativeOffsetOfLocalHeader();
+        ThrowHrIfFailed(m_stream->Seek(pos, MSIX::StreamBase::Reference::START, nullptr));
+        LocalFileHeader lfh = LocalFileHeader();
+        lfh.Read(m_stream.Get(), centralFileHeader);
+
+        return ComPtr<IStream>::Make<ZipFileStream>(
+            name,
+            centralFileHeader.GetCompressionMethod() == CompressionType::Deflate,
+            centralFileHeader.GetRelativeOffsetOfLocalHeader() + lfh.Size(),
+            centralFileHeader.GetCompressedSize(),
+            m_stream.Get()
+        );
+    }
+
     std::string ZipObjectReader::GetFileName()
     {
         return m_stream.As<IStreamInternal>()->GetName();
     }
+
+    namespace {
+        std::uint64_t GetLE(const std::vector<std::uint8_t>& buffer, std::size_t offset, std::size_t bytes)
+        {
+            std::uint64_t value = 0;
+            for (std::size_t i = bytes; i-- > 0;) { value = (value << 8) | buffer[offset + i]; }
+            return value;
+        }
+
+        void SetLE(std::vector<std::uint8_t>& buffer, std::size_t offset, std::size_t bytes, std::uint64_t value)
+        {
+            for (std::size_t i = 0; i < bytes; i++, value >>= 8) { buffer[offset + i] = static_cast<std::uint8_t>(value & 0xFF); }
+        }
+    }
+
+    // IZipReader
+    // The signed digest covers the central directory without the signature's own entry, followed by
+    // the end of central directory records fixed up as if that entry and its file record weren't there.
+    std::vector<std::uint8_t> ZipObjectReader::GetCentralDirectoryDigest(const std::string& excludedFile)
+    {
+        auto excluded = m_centralDirectories.find(excludedFile);
+        ThrowErrorIf(Error::FileNotFound, (excluded == m_centralDirectories.end()), "file not in central directory");
+
+        auto size = m_readAheadStream->GetSize();
+        ThrowErrorIf(Error::ZipBadExtendedData, (m_offsetStartOfCD > size) || ((size - m_offsetStartOfCD) > std::numeric_limits<ULONG>::max()),
+            "central directory too large");
+        std::vector<std::uint8_t> buffer(static_cast<std::size_t>(size - m_offsetStartOfCD));
+        LARGE_INTEGER pos = {0};
+        pos.QuadPart = m_offsetStartOfCD;
+        ThrowHrIfFailed(m_stream->Seek(pos, StreamBase::Reference::START, nullptr));
+        ULONG read = 0;
+        ThrowHrIfFailed(m_stream->Read(buffer.data(), static_cast<ULONG>(buffer.size()), &read));
+        ThrowErrorIf(Error::FileRead, (read != buffer.size()), "Did not read as much as requested.");
+
+        SHA256 hash;
+        std::size_t offset = 0;
+        std::size_t excludedSize = 0;
+        for (std::uint64_t index = 0; index < m_totalNumberOfEntries; index++)
+        {   // Central directory file header: 46 bytes followed by the name, extra field and comment.
+            ThrowErrorIf(Error::ZipCentralDirectoryHeader, (offset + 46 > buffer.size()), "central directory truncated");
+            std::size_t nameLength = static_cast<std::size_t>(GetLE(buffer, offset + 28, 2));
+            std::size_t entrySize = 46 + nameLength + static_cast<std::size_t>(GetLE(buffer, offset + 30, 2) + GetLE(buffer, offset + 32, 2));
+            ThrowErrorIf(Error::ZipCentralDirectoryHeader, (offset + entrySize > buffer.size()), "central directory truncated");
+            std::string name(reinterpret_cast<const char*>(buffer.data() + offset + 46), nameLength);
+            if (name == excludedFile) { excludedSize = entrySize; }
+            else                      { hash.Add(buffer.data() + offset, entrySize); }
+            offset += entrySize;
+        }
+
+        std::uint64_t entries = m_totalNumberOfEntries - 1;
+        std::uint64_t sizeOfCD = offset - excludedSize;
+        std::uint64_t offsetStartOfCD = excluded->second.GetRelativeOffsetOfLocalHeader();
+        std::vector<std::uint8_t> endRecords(buffer.begin() + offset, buffer.end());
+        std::size_t eocd = endRecords.size() - m_endCentralDirectoryRecord.Size();
+        if (m_endCentralDirectoryRecord.GetIsZip64())
+        {   // The EoCD only has placeholders, the zip64 EoCD record and its locator have the actual values.
+            std::size_t locator = eocd - m_zip64Locator.Size();
+            ThrowErrorIf(Error::ZipHiddenData, (locator < m_zip64EndOfCentralDirectory.Size()), "unexpected data in end of central directory");
+            SetLE(endRecords, 24, 8, entries);
+            SetLE(endRecords, 32, 8, entries);
+            SetLE(endRecords, 40, 8, sizeOfCD);
+            SetLE(endRecords, 48, 8, offsetStartOfCD);
+            SetLE(endRecords, locator + 8, 8, offsetStartOfCD + sizeOfCD);
+        }
+        else
+        {
+            SetLE(endRecords, eocd + 8, 2, entries);
+            SetLE(endRecords, eocd + 10, 2, entries);
+            SetLE(endRecords, eocd + 12, 4, sizeOfCD);
+            SetLE(endRecords, eocd + 16, 4, offsetStartOfCD);
+        }
+        hash.Add(endRecords.data(), endRecords.size());
+
+        std::vector<std::uint8_t> result;
+        hash.Get(result);
+        return result;
+    }
+
+    void ZipObjectReader::StartFileRecordsDigest(const std::string& lastFile)
+    {
+        auto centralFileHeader = m_centralDirectories.find(lastFile);
+        ThrowErrorIf(Error::FileNotFound, (centralFileHeader == m_centralDirectories.end()), "file not in central directory");
+        m_readAheadStream->StartPrefixDigest(centralFileHeader->second.GetRelativeOffsetOfLocalHeader());
+    }
+
+    std::vector<std::uint8_t> ZipObjectReader::GetFileRecordsDigest()
+    {
+        return m_readAheadStream->GetPrefixDigest();
+    }
 }
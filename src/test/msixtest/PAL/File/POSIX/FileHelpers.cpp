@@ -69,6 +69,11 @@ namespace MsixTest {
             return (std::remove(directory.c_str()) == 0);
         }
 
+        bool MakeDirectory(const std::string& directory)
+        {
+            return (mkdir(directory.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) == 0) || (errno == EEXIST);
+        }
+
         bool CompareDirectory(const std::string& directory, const std::map<std::string, std::uint64_t>& files)
         {
             auto filesCopy(files);
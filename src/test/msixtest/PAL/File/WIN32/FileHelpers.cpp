@@ -97,6 +97,12 @@ namespace MsixTest {
             return true;
         }
 
+        bool MakeDirectory(const std::string& directory)
+        {
+            auto dirUtf16 = String::utf8_to_utf16(MsixTest::Directory::PathAsCurrentPlatform(directory));
+            return CreateDirectory(dirUtf16.c_str(), nullptr) || (GetLastError() == ERROR_ALREADY_EXISTS);
+        }
+
         bool CompareDirectory(const std::string& directory, const std::map<std::string, std::uint64_t>& files)
         {
             auto dir = MsixTest::Directory::PathAsCurrentPlatform(directory);
@@ -85,3 +85,28 @@ TEST_CASE("Api_AppxBundleReader_PayloadPackages", "[api]")
     }
     REQUIRE(expectedPackages.size() == numOfPackages);
 }
+
+// Validates the identity read from the bundle manifest alone matches the one from the bundle reader
+TEST_CASE("Api_GetPackageIdentityFromStream_Bundle", "[api]")
+{
+    std::string bundle = "BundleWithIntlPackage.appxbundle";
+    MsixTest::ComPtr<IAppxBundleReader> bundleReader;
+    MsixTest::InitializeBundleReader(bundle, &bundleReader);
+    MsixTest::ComPtr<IAppxBundleManifestReader> bundleManifestReader;
+    REQUIRE_SUCCEEDED(bundleReader->GetManifest(&bundleManifestReader));
+    MsixTest::ComPtr<IAppxManifestPackageId> expected;
+    REQUIRE_SUCCEEDED(bundleManifestReader->GetPackageId(&expected));
+
+    auto bundlePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unbundle) + "/" + bundle;
+    auto inputStream = MsixTest::StreamFile(bundlePath, true);
+    MsixTest::ComPtr<IAppxFactory> factory;
+    REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &factory));
+    MsixTest::ComPtr<IAppxManifestPackageId> packageId;
+    REQUIRE_SUCCEEDED(GetPackageIdentityFromStream(factory.Get(), inputStream.Get(), &packageId));
+
+    MsixTest::Wrappers::Buffer<wchar_t> expectedFullName;
+    REQUIRE_SUCCEEDED(expected->GetPackageFullName(&expectedFullName));
+    MsixTest::Wrappers::Buffer<wchar_t> fullName;
+    REQUIRE_SUCCEEDED(packageId->GetPackageFullName(&fullName));
+    REQUIRE(expectedFullName.ToString() == fullName.ToString());
+}
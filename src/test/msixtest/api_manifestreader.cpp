@@ -10,6 +10,10 @@
 
 #include <iostream>
 #include <array>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <vector>
 
 // Validates IAppxManifestReader::GetStream
 TEST_CASE("Api_AppxManifestReader_Stream", "[api]")
@@ -512,6 +516,166 @@ TEST_CASE("Api_AppxManifestReader_MsixDocument", "[api]")
     REQUIRE(expectedCategories.size() == numOfElements);
 }
 
+#ifndef MSIX_MSXML6
+// Validates that queries that only differ on their prefixes return the elements of each namespace
+TEST_CASE("Api_AppxManifestReader_MsixDocument_Prefixes", "[api]")
+{
+    std::string manifest = "Sample_AppxManifest.xml";
+    MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+    MsixTest::InitializeManifestReader(manifest, &manifestReader);
+
+    MsixTest::ComPtr<IMsixDocumentElement> msixDocument;
+    REQUIRE_SUCCEEDED(manifestReader->QueryInterface(UuidOfImpl<IMsixDocumentElement>::iid, reinterpret_cast<void**>(&msixDocument)));
+    MsixTest::ComPtr<IMsixElement> manifestElement;
+    REQUIRE_SUCCEEDED(msixDocument->GetDocumentElement(&manifestElement));
+
+    std::map<std::string, std::vector<std::string>> expectedCapabilities =
+    {
+        { "/Package/Capabilities/uap:Capability", { "videosLibrary", "removableStorage" } },
+        { "/Package/Capabilities/rescap:Capability", { "enterpriseDataPolicy", "previewStore" } },
+    };
+
+    // Run the queries twice, the second time they are already compiled
+    for (int i = 0; i < 2; i++)
+    {
+        for (const auto& expected : expectedCapabilities)
+        {
+            MsixTest::ComPtr<IMsixElementEnumerator> elementEnum;
+            REQUIRE_SUCCEEDED(manifestElement->GetElementsUtf8(expected.first.c_str(), &elementEnum));
+            BOOL hasCurrent = FALSE;
+            size_t numOfElements = 0;
+            REQUIRE_SUCCEEDED(elementEnum->GetHasCurrent(&hasCurrent));
+            while(hasCurrent)
+            {
+                MsixTest::ComPtr<IMsixElement> element;
+                REQUIRE_SUCCEEDED(elementEnum->GetCurrent(&element));
+
+                MsixTest::Wrappers::Buffer<char> value;
+                REQUIRE_SUCCEEDED(element->GetAttributeValueUtf8("Name", &value));
+                REQUIRE(expected.second.at(numOfElements) == value.ToString());
+
+                REQUIRE_SUCCEEDED(elementEnum->MoveNext(&hasCurrent));
+                numOfElements++;
+            }
+            REQUIRE(expected.second.size() == numOfElements);
+        }
+    }
+}
+#endif
+
+// Measures XPath queries and attribute reads on the manifest DOM, which create an element wrapper for
+// every match. Hidden by default, run with msixtest "[benchmark]" to see the timings.
+TEST_CASE("Api_AppxManifestReader_Benchmark", "[api][.benchmark]")
+{
+    std::string manifest = "Sample_AppxManifest.xml";
+    MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+    MsixTest::InitializeManifestReader(manifest, &manifestReader);
+
+    MsixTest::ComPtr<IMsixDocumentElement> msixDocument;
+    REQUIRE_SUCCEEDED(manifestReader->QueryInterface(UuidOfImpl<IMsixDocumentElement>::iid, reinterpret_cast<void**>(&msixDocument)));
+
+    // xpath, attribute to read from each match and how many matches there are
+    std::array<std::tuple<std::string, std::string, std::size_t>, 5> queries =
+    {
+        std::make_tuple("/Package/Identity", "Name", 1),
+        std::make_tuple("/Package/Resources/Resource", "Language", 2),
+        std::make_tuple("/Package/Capabilities/Capability", "Name", 2),
+        std::make_tuple("/Package/Extensions/Extension", "Category", 3),
+        std::make_tuple("/Package/Extensions/Extension/InProcessServer/ActivatableClass", "ActivatableClassId", 3),
+    };
+    #ifdef MSIX_MSXML6
+    for (auto& query : queries)
+    {   // MSXML doesn't use the default namespace, match on local names.
+        std::string xpath;
+        std::istringstream steps(std::get<0>(query).substr(1));
+        std::string step;
+        while (std::getline(steps, step, '/'))
+        {   xpath += "/*[local-name()='" + step + "']";
+        }
+        std::get<0>(query) = xpath;
+    }
+    #endif
+
+    const std::size_t rounds = 1000;
+    std::size_t numOfElements = 0;
+    BENCHMARK("Query the manifest DOM")
+    {
+        numOfElements = 0;
+        for (std::size_t i = 0; i < rounds; i++)
+        {
+            MsixTest::ComPtr<IMsixElement> manifestElement;
+            REQUIRE_SUCCEEDED(msixDocument->GetDocumentElement(&manifestElement));
+            for (const auto& query : queries)
+            {
+                MsixTest::ComPtr<IMsixElementEnumerator> elementEnum;
+                REQUIRE_SUCCEEDED(manifestElement->GetElementsUtf8(std::get<0>(query).c_str(), &elementEnum));
+                BOOL hasCurrent = FALSE;
+                REQUIRE_SUCCEEDED(elementEnum->GetHasCurrent(&hasCurrent));
+                while (hasCurrent)
+                {
+                    MsixTest::ComPtr<IMsixElement> element;
+                    REQUIRE_SUCCEEDED(elementEnum->GetCurrent(&element));
+                    MsixTest::Wrappers::Buffer<char> value;
+                    REQUIRE_SUCCEEDED(element->GetAttributeValueUtf8(std::get<1>(query).c_str(), &value));
+                    REQUIRE_SUCCEEDED(elementEnum->MoveNext(&hasCurrent));
+                    numOfElements++;
+                }
+            }
+        }
+    }
+
+    std::size_t expected = 0;
+    for (const auto& query : queries) { expected += std::get<2>(query); }
+    REQUIRE(rounds * expected == numOfElements);
+}
+
+// Validates that the manifest reader keeps working after releasing its DOM
+TEST_CASE("Api_AppxManifestReader_ReleaseDom", "[api]")
+{
+    auto manifestPath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Manifest) + "/Sample_AppxManifest.xml";
+    auto inputStream = MsixTest::StreamFile(manifestPath, true);
+
+    MsixTest::ComPtr<IAppxFactory> factory;
+    REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free,
+        static_cast<MSIX_VALIDATION_OPTION>(MSIX_VALIDATION_OPTION_SKIPSIGNATURE | MSIX_VALIDATION_OPTION_RELEASEMANIFESTDOM), &factory));
+    MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+    REQUIRE_SUCCEEDED(factory->CreateManifestReader(inputStream.Get(), &manifestReader));
+
+    MsixTest::ComPtr<IAppxManifestProperties> properties;
+    REQUIRE_SUCCEEDED(manifestReader->GetProperties(&properties));
+    MsixTest::Wrappers::Buffer<wchar_t> displayName;
+    REQUIRE_SUCCEEDED(properties->GetStringValue(L"DisplayName", &displayName));
+    REQUIRE("Sample app manifest" == displayName.ToString());
+
+    MsixTest::ComPtr<IAppxManifestApplicationsEnumerator> applications;
+    REQUIRE_SUCCEEDED(manifestReader->GetApplications(&applications));
+    BOOL hasCurrent = FALSE;
+    REQUIRE_SUCCEEDED(applications->GetHasCurrent(&hasCurrent));
+    REQUIRE(hasCurrent);
+
+    // The DOM is parsed again for GetDocumentElement
+    MsixTest::ComPtr<IMsixDocumentElement> msixDocument;
+    REQUIRE_SUCCEEDED(manifestReader->QueryInterface(UuidOfImpl<IMsixDocumentElement>::iid, reinterpret_cast<void**>(&msixDocument)));
+    MsixTest::ComPtr<IMsixElement> manifestElement;
+    REQUIRE_SUCCEEDED(msixDocument->GetDocumentElement(&manifestElement));
+
+    #ifdef MSIX_MSXML6
+    std::string xpath = "/*[local-name()='Package']/*[local-name()='Extensions']/*[local-name()='Extension']";
+    #else
+    std::string xpath = "/Package/Extensions/Extension";
+    #endif
+    MsixTest::ComPtr<IMsixElementEnumerator> elementEnum;
+    REQUIRE_SUCCEEDED(manifestElement->GetElementsUtf8(xpath.c_str(), &elementEnum));
+    size_t numOfElements = 0;
+    REQUIRE_SUCCEEDED(elementEnum->GetHasCurrent(&hasCurrent));
+    while(hasCurrent)
+    {
+        REQUIRE_SUCCEEDED(elementEnum->MoveNext(&hasCurrent));
+        numOfElements++;
+    }
+    REQUIRE(3 == numOfElements);
+}
+
 TEST_CASE("Api_AppxManifestReader_PackageId", "[api]")
 {
     std::string manifest = "Sample_AppxManifest.xml";
@@ -141,3 +141,38 @@ TEST_CASE("Api_AppxPackageReader_FootprintFile", "[api]")
     std::replace(codeIntegrityName.begin(), codeIntegrityName.end(), '/', '\\');
     REQUIRE(codeIntegrityName == appxCodeIntegrityName.ToString());
 }
+
+// Validates the identity read from the manifest alone matches the one from the package reader
+TEST_CASE("Api_GetPackageIdentityFromStream", "[api]")
+{
+    std::string package = "TestAppxPackage_x64.appx";
+    MsixTest::ComPtr<IAppxPackageReader> packageReader;
+    MsixTest::InitializePackageReader(package, &packageReader);
+    MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+    REQUIRE_SUCCEEDED(packageReader->GetManifest(&manifestReader));
+    MsixTest::ComPtr<IAppxManifestPackageId> expected;
+    REQUIRE_SUCCEEDED(manifestReader->GetPackageId(&expected));
+
+    auto packagePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unpack) + "/" + package;
+    auto inputStream = MsixTest::StreamFile(packagePath, true);
+    MsixTest::ComPtr<IAppxFactory> factory;
+    REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &factory));
+    MsixTest::ComPtr<IAppxManifestPackageId> packageId;
+    REQUIRE_SUCCEEDED(GetPackageIdentityFromStream(factory.Get(), inputStream.Get(), &packageId));
+
+    MsixTest::Wrappers::Buffer<wchar_t> expectedFullName;
+    REQUIRE_SUCCEEDED(expected->GetPackageFullName(&expectedFullName));
+    MsixTest::Wrappers::Buffer<wchar_t> fullName;
+    REQUIRE_SUCCEEDED(packageId->GetPackageFullName(&fullName));
+    REQUIRE(expectedFullName.ToString() == fullName.ToString());
+
+    MsixTest::Wrappers::Buffer<wchar_t> expectedPublisher;
+    REQUIRE_SUCCEEDED(expected->GetPublisher(&expectedPublisher));
+    MsixTest::Wrappers::Buffer<wchar_t> publisher;
+    REQUIRE_SUCCEEDED(packageId->GetPublisher(&publisher));
+    REQUIRE(expectedPublisher.ToString() == publisher.ToString());
+
+    APPX_PACKAGE_ARCHITECTURE architecture = APPX_PACKAGE_ARCHITECTURE_NEUTRAL;
+    REQUIRE_SUCCEEDED(packageId->GetArchitecture(&architecture));
+    REQUIRE(APPX_PACKAGE_ARCHITECTURE_X64 == architecture);
+}
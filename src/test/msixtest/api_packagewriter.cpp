@@ -11,6 +11,7 @@
 #include "StreamBase.hpp"
 
 #include <iostream>
+#include <algorithm>
 
 using namespace MsixTest::Pack;
 
@@ -196,8 +197,7 @@ TEST_CASE("Api_AppxPackageWriter_payloadfiles", "[api]")
 
     auto packageWriter3 = packageWriter.As<IAppxPackageWriter3>();
 
-    // memoryLimist isn't implemented yet, but set a very small memory limit to force
-    // all the handling loops when we do: 320kb.
+    // Set a very small memory limit to force all the handling loops: 320kb.
     REQUIRE_SUCCEEDED(packageWriter3->AddPayloadFiles(
         static_cast<UINT32>(TestConstants::GoodFileNames.size()),
         payloadFiles.data(),
@@ -257,8 +257,7 @@ TEST_CASE("Api_AppxPackageWriter_payloadfiles_utf8", "[api]")
 
     auto packageWriter3utf8 = packageWriter.As<IAppxPackageWriter3Utf8>();
 
-    // memoryLimist isn't implemented yet, but set a very small memory limit to force
-    // all the handling loops when we do: 320kb.
+    // Set a very small memory limit to force all the handling loops: 320kb.
     REQUIRE_SUCCEEDED(packageWriter3utf8->AddPayloadFiles(
         static_cast<UINT32>(TestConstants::GoodFileNames.size()),
         payloadFiles.data(),
@@ -478,3 +477,123 @@ TEST_CASE("Api_AppxPackageWriter_file_over_4GB", "[api][.slow]")
     MsixTest::ComPtr<IAppxPackageReader> packageReader;
     MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
 }
+
+// Reads a payload file created from a GeneratedEasilyCompressedFileStream and compares it with what was generated
+void VerifyGeneratedPayloadFile(IAppxPackageReader* packageReader, const wchar_t* name, std::uint64_t size)
+{
+    MsixTest::ComPtr<IAppxFile> file;
+    REQUIRE_SUCCEEDED(packageReader->GetPayloadFile(name, &file));
+    MsixTest::ComPtr<IStream> fileStream;
+    REQUIRE_SUCCEEDED(file->GetStream(&fileStream));
+
+    GeneratedEasilyCompressedFileStream expectedStream(size);
+    std::vector<std::uint8_t> actual(DefaultBlockSize);
+    std::vector<std::uint8_t> expected(DefaultBlockSize);
+    std::uint64_t total = 0;
+    while (total < size)
+    {
+        ULONG toRead = static_cast<ULONG>(std::min(static_cast<std::uint64_t>(DefaultBlockSize), size - total));
+        ULONG read = 0;
+        ULONG expectedRead = 0;
+        REQUIRE_SUCCEEDED(fileStream->Read(actual.data(), toRead, &read));
+        REQUIRE_SUCCEEDED(expectedStream.Read(expected.data(), toRead, &expectedRead));
+        REQUIRE(read == toRead);
+        REQUIRE(std::equal(actual.begin(), actual.begin() + read, expected.begin()));
+        total += read;
+    }
+}
+
+// Test that files with many blocks come back intact. Files with more than one block are always compressed and
+// hashed by the writer's thread pool, which has at least two threads whatever the number of cores.
+TEST_CASE("Api_AppxPackageWriter_multiple_blocks", "[api]")
+{
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    InitializePackageWriter(outputStream.Get(), &packageWriter);
+
+    const std::uint64_t compressedSize = DefaultBlockSize * 100 + 1234;
+    auto compressedStream = MsixTest::ComPtr<IStream>::Make<GeneratedEasilyCompressedFileStream>(compressedSize);
+    REQUIRE_SUCCEEDED(packageWriter->AddPayloadFile(
+        L"compressed.bin",
+        TestConstants::ContentType.c_str(),
+        APPX_COMPRESSION_OPTION_NORMAL,
+        compressedStream.Get()));
+
+    auto storedStream = MsixTest::StreamFile("test_file.txt", false, true);
+    WriteContentToStream(618963, storedStream.Get());
+    REQUIRE_SUCCEEDED(packageWriter->AddPayloadFile(
+        L"stored.bin",
+        TestConstants::ContentType.c_str(),
+        APPX_COMPRESSION_OPTION_NONE,
+        storedStream.Get()));
+
+    MsixTest::ComPtr<IStream> manifestStream;
+    MakeManifestStream(&manifestStream);
+    REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(outputStream.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+    MsixTest::ComPtr<IAppxPackageReader> packageReader;
+    MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
+
+    VerifyGeneratedPayloadFile(packageReader.Get(), L"compressed.bin", compressedSize);
+
+    MsixTest::ComPtr<IAppxFile> file;
+    REQUIRE_SUCCEEDED(packageReader->GetPayloadFile(L"stored.bin", &file));
+}
+
+// Test adding many files at once with different memory limits, empty files and files of a few blocks
+// are committed to the package in order while their blocks are compressed concurrently.
+TEST_CASE("Api_AppxPackageWriter_payloadfiles_memory_limit", "[api]")
+{
+    const std::vector<std::pair<std::wstring, std::uint64_t>> files =
+    {
+        { L"empty_first.bin", 0 },
+        { L"small.bin", 10 },
+        { L"one_block.bin", DefaultBlockSize },
+        { L"empty_middle.bin", 0 },
+        { L"one_block_and_a_byte.bin", DefaultBlockSize + 1 },
+        { L"few_blocks.bin", DefaultBlockSize * 7 + 99 },
+        { L"stored_blocks.bin", DefaultBlockSize * 3 + 5 },
+        { L"empty_last.bin", 0 },
+    };
+
+    for (UINT64 memoryLimit : { static_cast<UINT64>(0), static_cast<UINT64>(1), static_cast<UINT64>(DefaultBlockSize * 4) })
+    {
+        auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(outputStream.Get(), &packageWriter);
+
+        std::vector<MsixTest::ComPtr<IStream>> streams;
+        std::vector<APPX_PACKAGE_WRITER_PAYLOAD_STREAM> payloadFiles(files.size());
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            streams.push_back(MsixTest::ComPtr<IStream>::Make<GeneratedEasilyCompressedFileStream>(files[i].second));
+            payloadFiles[i].fileName = files[i].first.c_str();
+            payloadFiles[i].contentType = TestConstants::ContentType.c_str();
+            payloadFiles[i].compressionOption = (files[i].first == L"stored_blocks.bin") ? APPX_COMPRESSION_OPTION_NONE : APPX_COMPRESSION_OPTION_NORMAL;
+            payloadFiles[i].inputStream = streams[i].Get();
+        }
+
+        REQUIRE_SUCCEEDED(packageWriter.As<IAppxPackageWriter3>()->AddPayloadFiles(
+            static_cast<UINT32>(payloadFiles.size()),
+            payloadFiles.data(),
+            memoryLimit));
+
+        MsixTest::ComPtr<IStream> manifestStream;
+        MakeManifestStream(&manifestStream);
+        REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+        LARGE_INTEGER zero = { 0 };
+        REQUIRE_SUCCEEDED(outputStream.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+        MsixTest::ComPtr<IAppxPackageReader> packageReader;
+        MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
+
+        for (const auto& file : files)
+        {
+            VerifyGeneratedPayloadFile(packageReader.Get(), file.first.c_str(), file.second);
+        }
+    }
+}
@@ -10,6 +10,8 @@ namespace MsixTest {
     namespace Directory
     {
         bool CleanDirectory(const std::string& directory);
+        // Creates the directory if it doesn't exist. Its parent must exist.
+        bool MakeDirectory(const std::string& directory);
         bool CompareDirectory(const std::string& directory, const std::map<std::string, std::uint64_t>& files);
 
         std::string PathAsCurrentPlatform(const std::string& path);
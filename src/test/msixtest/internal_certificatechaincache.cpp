@@ -0,0 +1,210 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+// Unit tests of the certificate chain cache used by the OpenSSL signature validation
+#include "catch.hpp"
+#include "CertificateChainCache.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+namespace {
+
+    struct unique_EVP_PKEY_deleter {
+        void operator()(EVP_PKEY *k) const { if (k) EVP_PKEY_free(k); };
+    };
+
+    struct unique_X509_deleter {
+        void operator()(X509 *x) const { if (x) X509_free(x); };
+    };
+
+    struct unique_X509_STORE_deleter {
+        void operator()(X509_STORE *xs) const { if (xs) X509_STORE_free(xs); };
+    };
+
+    struct unique_X509_STORE_CTX_deleter {
+        void operator()(X509_STORE_CTX *xsc) const { if (xsc) {X509_STORE_CTX_cleanup(xsc); X509_STORE_CTX_free(xsc);} };
+    };
+
+    struct unique_STACK_X509_deleter {
+        void operator()(STACK_OF(X509) *sx) const { if (sx) sk_X509_free(sx); };
+    };
+
+    typedef std::unique_ptr<EVP_PKEY, unique_EVP_PKEY_deleter> unique_EVP_PKEY;
+    typedef std::unique_ptr<X509, unique_X509_deleter> unique_X509;
+    typedef std::unique_ptr<X509_STORE, unique_X509_STORE_deleter> unique_X509_STORE;
+    typedef std::unique_ptr<X509_STORE_CTX, unique_X509_STORE_CTX_deleter> unique_X509_STORE_CTX;
+    typedef std::unique_ptr<STACK_OF(X509), unique_STACK_X509_deleter> unique_STACK_X509;
+
+    unique_EVP_PKEY MakeKey()
+    {
+        std::unique_ptr<BIGNUM, decltype(&BN_free)> exponent(BN_new(), &BN_free);
+        REQUIRE(BN_set_word(exponent.get(), RSA_F4));
+        RSA* rsa = RSA_new();
+        REQUIRE(RSA_generate_key_ex(rsa, 2048, exponent.get(), nullptr));
+        unique_EVP_PKEY key(EVP_PKEY_new());
+        REQUIRE(EVP_PKEY_assign_RSA(key.get(), rsa));
+        return key;
+    }
+
+    // Certificate for key with the given subject, signed by issuerKey. Without issuer it is self signed and a CA.
+    unique_X509 MakeCert(EVP_PKEY* key, const char* subject, long serial, X509* issuer, EVP_PKEY* issuerKey,
+        long notBefore = -60, long notAfter = 24 * 60 * 60)
+    {
+        unique_X509 cert(X509_new());
+        REQUIRE(X509_set_version(cert.get(), 2));
+        REQUIRE(ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), serial));
+        REQUIRE(X509_gmtime_adj(X509_get_notBefore(cert.get()), notBefore));
+        REQUIRE(X509_gmtime_adj(X509_get_notAfter(cert.get()), notAfter));
+        REQUIRE(X509_set_pubkey(cert.get(), key));
+        X509_NAME* name = X509_get_subject_name(cert.get());
+        REQUIRE(X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>(subject), -1, -1, 0));
+        REQUIRE(X509_set_issuer_name(cert.get(), issuer ? X509_get_subject_name(issuer) : name));
+        if (issuer == nullptr)
+        {
+            X509_EXTENSION* extension = X509V3_EXT_conf_nid(nullptr, nullptr, NID_basic_constraints, const_cast<char*>("critical,CA:TRUE"));
+            REQUIRE(extension != nullptr);
+            REQUIRE(X509_add_ext(cert.get(), extension, -1));
+            X509_EXTENSION_free(extension);
+        }
+        REQUIRE(X509_sign(cert.get(), issuerKey ? issuerKey : key, EVP_sha256()));
+        return cert;
+    }
+
+    // The certificates of a signature, as they come in its PKCS7 object.
+    unique_STACK_X509 MakeChain(X509* leaf, X509* root)
+    {
+        unique_STACK_X509 certs(sk_X509_new_null());
+        sk_X509_push(certs.get(), leaf);
+        sk_X509_push(certs.get(), root);
+        return certs;
+    }
+
+    // Mirrors what SignatureValidator::Validate does with the cache. Returns whether the chain was trusted and
+    // counts in verifications how many times it actually had to be verified.
+    bool ValidateChain(MSIX::CertificateChainCache& cache, X509_STORE* store, STACK_OF(X509)* certs,
+        std::string& publisher, int& verifications)
+    {
+        auto key = MSIX::CertificateChainCache::GetKey(certs);
+        if (cache.Find(key, publisher)) { return true; }
+
+        verifications++;
+        // What the OpenSSL initialization of the validator does, the signatures can't be checked without it.
+        OpenSSL_add_all_algorithms();
+        unique_X509_STORE_CTX context(X509_STORE_CTX_new());
+        REQUIRE(X509_STORE_CTX_init(context.get(), store, sk_X509_value(certs, 0), certs));
+        if (X509_verify_cert(context.get()) != 1) { return false; }
+
+        char name[256] = {};
+        X509_NAME_oneline(X509_get_subject_name(sk_X509_value(certs, 0)), name, sizeof(name));
+        publisher = name;
+        cache.Add(key, certs, publisher);
+        return true;
+    }
+}
+
+TEST_CASE("Internal_CertificateChainCache_TrustedChain", "[internal]")
+{
+    auto rootKey = MakeKey();
+    auto root = MakeCert(rootKey.get(), "Test Root", 1, nullptr, nullptr);
+    auto leafKey = MakeKey();
+    auto leafA = MakeCert(leafKey.get(), "Publisher A", 2, root.get(), rootKey.get());
+    auto leafB = MakeCert(leafKey.get(), "Publisher B", 3, root.get(), rootKey.get());
+    auto chainA = MakeChain(leafA.get(), root.get());
+    auto chainB = MakeChain(leafB.get(), root.get());
+
+    unique_X509_STORE store(X509_STORE_new());
+    REQUIRE(X509_STORE_add_cert(store.get(), root.get()));
+
+    MSIX::CertificateChainCache cache;
+    int verifications = 0;
+    std::string publisher;
+
+    // The first time the chain is verified, the second time it comes from the cache.
+    REQUIRE(ValidateChain(cache, store.get(), chainA.get(), publisher, verifications));
+    CHECK(verifications == 1);
+    const std::string publisherA = publisher;
+    CHECK(publisherA.find("Publisher A") != std::string::npos);
+
+    publisher.clear();
+    REQUIRE(ValidateChain(cache, store.get(), chainA.get(), publisher, verifications));
+    CHECK(verifications == 1);
+    CHECK(publisher == publisherA);
+
+    // Another leaf from the same issuer is its own entry, verified and with its own publisher.
+    REQUIRE(ValidateChain(cache, store.get(), chainB.get(), publisher, verifications));
+    CHECK(verifications == 2);
+    CHECK(publisher.find("Publisher B") != std::string::npos);
+
+    // and doesn't replace the first one
+    REQUIRE(ValidateChain(cache, store.get(), chainA.get(), publisher, verifications));
+    CHECK(verifications == 2);
+    CHECK(publisher == publisherA);
+}
+
+TEST_CASE("Internal_CertificateChainCache_UntrustedChain", "[internal]")
+{
+    auto rootKey = MakeKey();
+    auto root = MakeCert(rootKey.get(), "Test Root", 1, nullptr, nullptr);
+    auto leafKey = MakeKey();
+    auto leaf = MakeCert(leafKey.get(), "Publisher", 2, root.get(), rootKey.get());
+    auto chain = MakeChain(leaf.get(), root.get());
+
+    // The root is not in the store
+    unique_X509_STORE store(X509_STORE_new());
+
+    MSIX::CertificateChainCache cache;
+    int verifications = 0;
+    std::string publisher;
+    CHECK_FALSE(ValidateChain(cache, store.get(), chain.get(), publisher, verifications));
+    CHECK_FALSE(ValidateChain(cache, store.get(), chain.get(), publisher, verifications));
+    CHECK(verifications == 2);
+    CHECK_FALSE(cache.Find(MSIX::CertificateChainCache::GetKey(chain.get()), publisher));
+}
+
+TEST_CASE("Internal_CertificateChainCache_Expiry", "[internal]")
+{
+    auto rootKey = MakeKey();
+    auto root = MakeCert(rootKey.get(), "Test Root", 1, nullptr, nullptr);
+    auto leafKey = MakeKey();
+    // Expired an hour ago, the root is still valid.
+    auto leaf = MakeCert(leafKey.get(), "Publisher", 2, root.get(), rootKey.get(), -2 * 60 * 60, -60 * 60);
+    auto chain = MakeChain(leaf.get(), root.get());
+
+    MSIX::CertificateChainCache cache;
+    auto key = MSIX::CertificateChainCache::GetKey(chain.get());
+    cache.Add(key, chain.get(), "Publisher");
+    std::string publisher;
+    CHECK_FALSE(cache.Find(key, publisher));
+}
+
+TEST_CASE("Internal_CertificateChainCache_MaxEntries", "[internal]")
+{
+    auto rootKey = MakeKey();
+    auto root = MakeCert(rootKey.get(), "Test Root", 1, nullptr, nullptr);
+    unique_STACK_X509 chain(sk_X509_new_null());
+    sk_X509_push(chain.get(), root.get());
+
+    MSIX::CertificateChainCache cache;
+    std::string publisher;
+    for (std::size_t i = 0; i < MSIX::CertificateChainCache::MaxEntries; i++)
+    {
+        cache.Add(std::vector<std::uint8_t>(1, static_cast<std::uint8_t>(i)), chain.get(), std::to_string(i));
+    }
+    CHECK(cache.Find(std::vector<std::uint8_t>(1, 0), publisher));
+    CHECK(publisher == "0");
+
+    // One more than it holds starts over
+    cache.Add(std::vector<std::uint8_t>(2, 0), chain.get(), "new");
+    CHECK_FALSE(cache.Find(std::vector<std::uint8_t>(1, 0), publisher));
+    CHECK(cache.Find(std::vector<std::uint8_t>(2, 0), publisher));
+    CHECK(publisher == "new");
+}
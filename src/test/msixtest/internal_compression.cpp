@@ -0,0 +1,144 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+// Unit tests of the compression object pool
+#include "catch.hpp"
+#include "CompressionObjectPool.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace {
+
+    // Does nothing but count what the pool does with it.
+    class CountingCompressionObject final : public MSIX::ICompressionObject
+    {
+    public:
+        CountingCompressionObject(std::size_t& resets, std::size_t& cleanups) : m_resets(resets), m_cleanups(cleanups) {}
+
+        MSIX::CompressionStatus Initialize(MSIX::CompressionOperation, int) override { return MSIX::CompressionStatus::Ok; }
+        MSIX::CompressionStatus Inflate() override { return MSIX::CompressionStatus::Error; }
+        MSIX::CompressionStatus Deflate(MSIX::CompressionFlush) override { return MSIX::CompressionStatus::Error; }
+        MSIX::CompressionStatus Reset() override { m_resets++; return MSIX::CompressionStatus::Ok; }
+        MSIX::CompressionStatus Cleanup() override { m_cleanups++; return MSIX::CompressionStatus::Ok; }
+        std::size_t GetDeflateBound(std::size_t) override { return 0; }
+        std::size_t GetAvailableSourceSize() override { return 0; }
+        std::size_t GetAvailableDestinationSize() override { return 0; }
+        void SetInput(std::uint8_t*, std::size_t) override {}
+        void SetOutput(std::uint8_t*, std::size_t) override {}
+
+    private:
+        std::size_t& m_resets;
+        std::size_t& m_cleanups;
+    };
+
+    // Compressible, but not trivially so.
+    std::vector<std::uint8_t> MakeData(std::size_t size)
+    {
+        std::vector<std::uint8_t> data(size);
+        std::uint32_t value = 12345;
+        for (std::size_t i = 0; i < size; i++)
+        {
+            value = value * 1103515245 + 12345;
+            data[i] = static_cast<std::uint8_t>((value >> 16) % 16 + 'a');
+        }
+        return data;
+    }
+
+    // Deflates data as a single stream, or only the first half of it with a full flush when finish is false.
+    std::vector<std::uint8_t> Deflate(MSIX::ICompressionObject* object, std::vector<std::uint8_t>& data, bool finish = true)
+    {
+        std::vector<std::uint8_t> output(object->GetDeflateBound(data.size()));
+        object->SetInput(data.data(), finish ? data.size() : data.size() / 2);
+        object->SetOutput(output.data(), output.size());
+        auto status = object->Deflate(finish ? MSIX::CompressionFlush::Finish : MSIX::CompressionFlush::Full);
+        REQUIRE(status == (finish ? MSIX::CompressionStatus::End : MSIX::CompressionStatus::Ok));
+        output.resize(output.size() - object->GetAvailableDestinationSize());
+        return output;
+    }
+}
+
+TEST_CASE("Internal_CompressionObjectPool_Reuse", "[internal]")
+{
+    const int level = 6;
+    auto data = MakeData(100000);
+    MSIX::CompressionObjectPool pool(MSIX::CompressionOperation::Deflate, 2);
+
+    auto fresh = MSIX::CreateCompressionObject();
+    REQUIRE(fresh->Initialize(MSIX::CompressionOperation::Deflate, level) == MSIX::CompressionStatus::Ok);
+    auto expected = Deflate(fresh.get(), data);
+    fresh->Cleanup();
+
+    auto object = pool.Acquire(level);
+    CHECK(Deflate(object.get(), data) == expected);
+    auto first = object.get();
+    pool.Release(std::move(object), level);
+
+    // The same object comes back, reset
+    object = pool.Acquire(level);
+    CHECK(object.get() == first);
+    CHECK(Deflate(object.get(), data) == expected);
+
+    // Nothing of a stream that was left half done shows in the next one
+    pool.Release(std::move(object), level);
+    object = pool.Acquire(level);
+    Deflate(object.get(), data, false);
+    pool.Release(std::move(object), level);
+    object = pool.Acquire(level);
+    CHECK(object.get() == first);
+    CHECK(Deflate(object.get(), data) == expected);
+    pool.Release(std::move(object), level);
+}
+
+TEST_CASE("Internal_CompressionObjectPool_Levels", "[internal]")
+{
+    std::size_t resets = 0;
+    std::size_t cleanups = 0;
+    {
+        MSIX::CompressionObjectPool pool(MSIX::CompressionOperation::Deflate, 4);
+        std::unique_ptr<MSIX::ICompressionObject> fast = std::make_unique<CountingCompressionObject>(resets, cleanups);
+        std::unique_ptr<MSIX::ICompressionObject> maximum = std::make_unique<CountingCompressionObject>(resets, cleanups);
+        auto fastObject = fast.get();
+        auto maximumObject = maximum.get();
+        pool.Release(std::move(fast), 1);
+        pool.Release(std::move(maximum), 9);
+
+        // Each level gets back its own object, not the most recently released one
+        auto object = pool.Acquire(1);
+        CHECK(object.get() == fastObject);
+        pool.Release(std::move(object), 1);
+        object = pool.Acquire(9);
+        CHECK(object.get() == maximumObject);
+        pool.Release(std::move(object), 9);
+        CHECK(resets == 2);
+
+        // A level that isn't in the pool gets a new object
+        object = pool.Acquire(5);
+        CHECK(object.get() != fastObject);
+        CHECK(object.get() != maximumObject);
+        CHECK(resets == 2);
+        object->Cleanup();
+        CHECK(cleanups == 0);
+    }
+    // Whatever is left in the pool is cleaned up with it
+    CHECK(cleanups == 2);
+}
+
+TEST_CASE("Internal_CompressionObjectPool_Full", "[internal]")
+{
+    std::size_t resets = 0;
+    std::size_t cleanups = 0;
+    {
+        MSIX::CompressionObjectPool pool(MSIX::CompressionOperation::Deflate, 1);
+        pool.Release(std::make_unique<CountingCompressionObject>(resets, cleanups), 1);
+        CHECK(cleanups == 0);
+
+        // No room for the second one, it is cleaned up right away
+        pool.Release(std::make_unique<CountingCompressionObject>(resets, cleanups), 1);
+        CHECK(cleanups == 1);
+    }
+    CHECK(cleanups == 2);
+    CHECK(resets == 0);
+}
@@ -0,0 +1,119 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+// Unit tests of the internal crypto helpers
+#include "catch.hpp"
+#include "Crypto.hpp"
+#include "SHA256Hardware.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+    std::string ToHex(const std::uint8_t* data, std::size_t size)
+    {
+        const char* digits = "0123456789abcdef";
+        std::string result;
+        for (std::size_t i = 0; i < size; i++)
+        {
+            result.push_back(digits[data[i] >> 4]);
+            result.push_back(digits[data[i] & 0x0F]);
+        }
+        return result;
+    }
+
+    std::string ToHex(const MSIX::SHA256::Hash& hash) { return ToHex(hash.data(), hash.size()); }
+    std::string ToHex(const std::vector<std::uint8_t>& hash) { return ToHex(hash.data(), hash.size()); }
+
+    // The platform's crypto library, which never goes to the SHA-256 instructions.
+    std::string SoftwareHash(const std::vector<std::uint8_t>& data)
+    {
+        MSIX::SHA256 hash;
+        hash.Add(data.data(), data.size());
+        std::vector<std::uint8_t> result;
+        hash.Get(result);
+        return ToHex(result);
+    }
+
+    std::vector<std::uint8_t> MakeData(std::size_t size, std::uint32_t seed)
+    {
+        std::vector<std::uint8_t> data(size);
+        for (auto& byte : data)
+        {
+            seed = seed * 1103515245 + 12345;
+            byte = static_cast<std::uint8_t>(seed >> 16);
+        }
+        return data;
+    }
+}
+
+// FIPS 180-2 examples
+TEST_CASE("Internal_SHA256_Vectors", "[internal]")
+{
+    struct { std::string message; std::size_t repeat; const char* expected; } vectors[] = {
+        { "", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+        { "a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+    };
+
+    for (const auto& vector : vectors)
+    {
+        std::vector<std::uint8_t> data;
+        for (std::size_t i = 0; i < vector.repeat; i++) { data.insert(data.end(), vector.message.begin(), vector.message.end()); }
+        INFO("Message of " << data.size() << " bytes");
+
+        MSIX::SHA256::Hash hash;
+        MSIX::SHA256::ComputeHash(data.data(), data.size(), hash);
+        CHECK(ToHex(hash) == vector.expected);
+        CHECK(SoftwareHash(data) == vector.expected);
+
+        if (MSIX::SHA256Hardware::IsSupported())
+        {
+            const std::uint8_t* buffer = data.data();
+            const std::size_t size = data.size();
+            MSIX::SHA256Hardware::ComputeHashes(&buffer, &size, &hash, 1);
+            CHECK(ToHex(hash) == vector.expected);
+        }
+    }
+}
+
+TEST_CASE("Internal_SHA256_ComputeHashes", "[internal]")
+{
+    // Around the 64 byte block and the 56 byte padding limit, and an odd count so one buffer isn't paired.
+    const std::size_t sizes[] = { 0, 1, 55, 56, 57, 63, 64, 65, 119, 120, 128, 1000, 4099, 65536, 65536 + 63 };
+    const std::size_t count = sizeof(sizes) / sizeof(sizes[0]);
+
+    std::vector<std::vector<std::uint8_t>> data;
+    std::vector<const std::uint8_t*> buffers;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        data.push_back(MakeData(sizes[i], static_cast<std::uint32_t>(i + 1)));
+    }
+    for (const auto& buffer : data) { buffers.push_back(buffer.data()); }
+
+    std::vector<MSIX::SHA256::Hash> hashes(count);
+    MSIX::SHA256::ComputeHashes(buffers.data(), sizes, hashes.data(), count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        INFO("Buffer " << i << " of " << sizes[i] << " bytes");
+        CHECK(ToHex(hashes[i]) == SoftwareHash(data[i]));
+    }
+
+    if (MSIX::SHA256Hardware::IsSupported())
+    {
+        // Pairs in the other order, so each size is hashed next to a different one.
+        std::vector<const std::uint8_t*> reversedBuffers(buffers.rbegin(), buffers.rend());
+        std::vector<std::size_t> reversedSizes(std::rbegin(sizes), std::rend(sizes));
+        std::vector<MSIX::SHA256::Hash> reversed(count);
+        MSIX::SHA256Hardware::ComputeHashes(reversedBuffers.data(), reversedSizes.data(), reversed.data(), count);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            INFO("Buffer " << i << " of " << sizes[i] << " bytes");
+            CHECK(reversed[count - 1 - i] == hashes[i]);
+        }
+    }
+}
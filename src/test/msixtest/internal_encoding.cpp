@@ -0,0 +1,133 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+// Unit tests of the internal encoding helpers
+#include "catch.hpp"
+#include "Encoding.hpp"
+#include "Exceptions.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+    std::vector<std::uint8_t> MakeData(std::size_t size)
+    {
+        std::vector<std::uint8_t> data(size);
+        std::uint32_t value = 54321;
+        for (auto& byte : data)
+        {
+            value = value * 1103515245 + 12345;
+            byte = static_cast<std::uint8_t>(value >> 16);
+        }
+        return data;
+    }
+
+    // RFC 4648, a byte at a time
+    std::string ReferenceBase64(const std::vector<std::uint8_t>& data)
+    {
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string result;
+        std::uint32_t bits = 0;
+        std::size_t count = 0;
+        for (auto byte : data)
+        {
+            bits = (bits << 8) | byte;
+            count += 8;
+            while (count >= 6)
+            {
+                count -= 6;
+                result.push_back(alphabet[(bits >> count) & 0x3F]);
+            }
+        }
+        if (count > 0) { result.push_back(alphabet[(bits << (6 - count)) & 0x3F]); }
+        while (result.size() % 4 != 0) { result.push_back('='); }
+        return result;
+    }
+}
+
+TEST_CASE("Internal_Base64_RoundTrip", "[internal]")
+{
+    // Every length mod 3 around the vector widths, 12 bytes or 16 characters a step, and well past them.
+    std::vector<std::size_t> sizes;
+    for (std::size_t size = 0; size <= 100; size++) { sizes.push_back(size); }
+    for (std::size_t size = 1020; size <= 1030; size++) { sizes.push_back(size); }
+
+    for (auto size : sizes)
+    {
+        INFO("Size " << size);
+        auto data = MakeData(size);
+        auto encoded = MSIX::Encoding::GetBase64EncodedValue(data.data(), data.size());
+        CHECK(encoded == ReferenceBase64(data));
+        CHECK(MSIX::Encoding::GetBase64DecodedValue(encoded) == data);
+
+        std::vector<std::uint8_t> decoded(size);
+        MSIX::Encoding::GetBase64DecodedValue(encoded.data(), encoded.size(), decoded.data(), decoded.size());
+        CHECK(decoded == data);
+    }
+
+    // All the characters of the alphabet, in every position of a group.
+    std::vector<std::uint8_t> data;
+    for (std::size_t i = 0; i < 3 * 64; i++) { data.push_back(static_cast<std::uint8_t>(i * 85)); }
+    auto encoded = MSIX::Encoding::GetBase64EncodedValue(data.data(), data.size());
+    CHECK(encoded == ReferenceBase64(data));
+    CHECK(MSIX::Encoding::GetBase64DecodedValue(encoded) == data);
+}
+
+TEST_CASE("Internal_Base64_InvalidCharacters", "[internal]")
+{
+    // 48 bytes are 64 characters, the first 48 go through the vector path and the rest one group at a time.
+    auto data = MakeData(48);
+    const auto encoded = MSIX::Encoding::GetBase64EncodedValue(data.data(), data.size());
+    REQUIRE(encoded.size() == 64);
+
+    const char invalid[] = { '*', '-', '_', ' ', '\t', '\r', '\n', '\0', '@', '[', '`', '{', static_cast<char>(0x80), static_cast<char>(0xC3) };
+    for (std::size_t position = 0; position < encoded.size(); position++)
+    {
+        for (auto c : invalid)
+        {
+            INFO("Character " << static_cast<int>(c) << " at " << position);
+            auto value = encoded;
+            value[position] = c;
+            CHECK_THROWS_AS(MSIX::Encoding::GetBase64DecodedValue(value), MSIX::Exception);
+        }
+    }
+}
+
+TEST_CASE("Internal_Base64_Padding", "[internal]")
+{
+    auto data = MakeData(48);
+    const auto encoded = MSIX::Encoding::GetBase64EncodedValue(data.data(), data.size());
+
+    // Padding anywhere but at the end
+    for (std::size_t position = 0; position < encoded.size() - 1; position++)
+    {
+        INFO("Padding at " << position);
+        auto value = encoded;
+        value[position] = '=';
+        CHECK_THROWS_AS(MSIX::Encoding::GetBase64DecodedValue(value), MSIX::Exception);
+    }
+
+    const char* invalid[] = {
+        "=",  "==", "===", "====",      // nothing but padding
+        "Q===", "QQ=A", "Q=QQ",         // more than two, or followed by data
+        "QQ==QUJD", "QUI=QUJD",         // padded group before the last one
+        "QUJD=", "QUJDR", "QUJDRE",     // not a multiple of four
+        "QUJD REVG", "QUJD\nREVG",      // whitespace between groups
+        "QUJD\r\nREVG", " QUJD",
+    };
+    for (auto value : invalid)
+    {
+        INFO("Value \"" << value << "\"");
+        CHECK_THROWS_AS(MSIX::Encoding::GetBase64DecodedValue(std::string(value)), MSIX::Exception);
+    }
+
+    // The size has to be the one of the decoded value.
+    std::uint8_t out[4];
+    CHECK_THROWS_AS(MSIX::Encoding::GetBase64DecodedValue("QUI=", 4, out, 1), MSIX::Exception);
+    CHECK_THROWS_AS(MSIX::Encoding::GetBase64DecodedValue("QUI=", 4, out, 3), MSIX::Exception);
+    MSIX::Encoding::GetBase64DecodedValue("QUI=", 4, out, 2);
+    CHECK(out[0] == 'A');
+    CHECK(out[1] == 'B');
+}
@@ -0,0 +1,272 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+// Unit tests of the internal streams
+#include "catch.hpp"
+#include "macros.hpp"
+#include "StreamBase.hpp"
+#include "ReadAheadStream.hpp"
+#include "Crypto.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+    // In memory stream that counts in reads how many times ReadAheadStream goes to it.
+    class CountingStream final : public MSIX::StreamBase
+    {
+    public:
+        CountingStream(const std::vector<std::uint8_t>& data, std::size_t& reads) : m_data(data), m_reads(reads) {}
+
+        HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept override
+        {
+            m_reads++;
+            ULONG toRead = (m_offset < m_data.size()) ?
+                static_cast<ULONG>(std::min(static_cast<std::uint64_t>(countBytes), m_data.size() - m_offset)) : 0;
+            if (toRead > 0) { std::memcpy(buffer, m_data.data() + m_offset, toRead); }
+            m_offset += toRead;
+            if (bytesRead) { *bytesRead = toRead; }
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER* newPosition) noexcept override
+        {
+            LONGLONG base = (origin == Reference::START) ? 0 :
+                            (origin == Reference::CURRENT) ? static_cast<LONGLONG>(m_offset) : static_cast<LONGLONG>(m_data.size());
+            LONGLONG position = base + move.QuadPart;
+            m_offset = (position < 0) ? 0 : static_cast<std::uint64_t>(position);
+            if (newPosition) { newPosition->QuadPart = m_offset; }
+            return S_OK;
+        }
+
+        std::uint64_t GetSize() override { return m_data.size(); }
+
+    private:
+        const std::vector<std::uint8_t>& m_data;
+        std::uint64_t m_offset = 0;
+        std::size_t& m_reads;
+    };
+
+    // Content that doesn't repeat at any power of two, so data from the wrong offset never matches.
+    std::vector<std::uint8_t> MakeData(std::size_t size)
+    {
+        std::vector<std::uint8_t> data(size);
+        std::uint32_t value = 12345;
+        for (auto& byte : data)
+        {
+            value = value * 1103515245 + 12345;
+            byte = static_cast<std::uint8_t>(value >> 16);
+        }
+        return data;
+    }
+
+    void SeekTo(IStream* stream, LONGLONG offset, DWORD origin = MSIX::StreamBase::Reference::START)
+    {
+        LARGE_INTEGER move;
+        move.QuadPart = offset;
+        REQUIRE_SUCCEEDED(stream->Seek(move, origin, nullptr));
+    }
+
+    // Reads count bytes from the current position and checks them against the source data at expectedOffset.
+    void CheckRead(IStream* stream, const std::vector<std::uint8_t>& data, std::uint64_t expectedOffset, ULONG count)
+    {
+        std::vector<std::uint8_t> buffer(count);
+        ULONG bytesRead = 0;
+        REQUIRE_SUCCEEDED(stream->Read(buffer.data(), count, &bytesRead));
+        ULONG expectedRead = (expectedOffset < data.size()) ?
+            static_cast<ULONG>(std::min(static_cast<std::uint64_t>(count), data.size() - expectedOffset)) : 0;
+        REQUIRE(bytesRead == expectedRead);
+        CHECK(std::memcmp(buffer.data(), data.data() + expectedOffset, bytesRead) == 0);
+    }
+}
+
+constexpr ULONG PageSize = MSIX::ReadAheadStream::PageSize;
+
+TEST_CASE("Internal_ReadAheadStream_SequentialReads", "[internal]")
+{
+    auto data = MakeData(5 * PageSize + 123);
+    std::size_t reads = 0;
+    auto source = MSIX::ComPtr<IStream>::Make<CountingStream>(data, reads);
+    auto stream = MSIX::ComPtr<IStream>::Make<MSIX::ReadAheadStream>(source);
+    CHECK(stream.As<IStreamInternal>()->GetSize() == data.size());
+
+    // Odd sized reads, most of them crossing a page boundary at some point.
+    std::uint64_t offset = 0;
+    while (offset < data.size())
+    {
+        CheckRead(stream.Get(), data, offset, 1000);
+        offset += 1000;
+    }
+    // The read ahead window makes that a few reads of the source, not one per call.
+    CHECK(reads < 10);
+}
+
+TEST_CASE("Internal_ReadAheadStream_PageBoundaries", "[internal]")
+{
+    auto data = MakeData(8 * PageSize + 123);
+    std::size_t reads = 0;
+    auto source = MSIX::ComPtr<IStream>::Make<CountingStream>(data, reads);
+    auto stream = MSIX::ComPtr<IStream>::Make<MSIX::ReadAheadStream>(source);
+
+    // Straddles the first boundary
+    SeekTo(stream.Get(), PageSize - 10);
+    CheckRead(stream.Get(), data, PageSize - 10, 20);
+
+    // Exactly one page, starting in the middle of one
+    SeekTo(stream.Get(), 3 * PageSize + 7);
+    CheckRead(stream.Get(), data, 3 * PageSize + 7, PageSize);
+
+    // More than a page from where nothing is cached goes straight to the source
+    SeekTo(stream.Get(), 5 * PageSize + 100);
+    CheckRead(stream.Get(), data, 5 * PageSize + 100, 2 * PageSize + 5);
+    // and the position continues after it
+    CheckRead(stream.Get(), data, 7 * PageSize + 105, 50);
+}
+
+TEST_CASE("Internal_ReadAheadStream_Seek", "[internal]")
+{
+    auto data = MakeData(5 * PageSize + 123);
+    std::size_t reads = 0;
+    auto source = MSIX::ComPtr<IStream>::Make<CountingStream>(data, reads);
+    auto stream = MSIX::ComPtr<IStream>::Make<MSIX::ReadAheadStream>(source);
+
+    // Forward over pages that were never read
+    SeekTo(stream.Get(), 4 * PageSize + 1);
+    CheckRead(stream.Get(), data, 4 * PageSize + 1, 300);
+
+    // Backwards from the current position, into a page that isn't cached
+    SeekTo(stream.Get(), -static_cast<LONGLONG>(3 * PageSize), MSIX::StreamBase::Reference::CURRENT);
+    CheckRead(stream.Get(), data, PageSize + 301, 300);
+
+    // Backwards into a cached page
+    SeekTo(stream.Get(), -600, MSIX::StreamBase::Reference::CURRENT);
+    CheckRead(stream.Get(), data, PageSize + 1, 300);
+
+    // Relative to the end
+    SeekTo(stream.Get(), -200, MSIX::StreamBase::Reference::END);
+    CheckRead(stream.Get(), data, data.size() - 200, 100);
+
+    ULARGE_INTEGER position = { 0 };
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(stream->Seek(zero, MSIX::StreamBase::Reference::CURRENT, &position));
+    CHECK(position.QuadPart == data.size() - 100);
+}
+
+TEST_CASE("Internal_ReadAheadStream_EndOfStream", "[internal]")
+{
+    auto data = MakeData(2 * PageSize + 123);
+    std::size_t reads = 0;
+    auto source = MSIX::ComPtr<IStream>::Make<CountingStream>(data, reads);
+    auto stream = MSIX::ComPtr<IStream>::Make<MSIX::ReadAheadStream>(source);
+
+    // Asking for more than what's left returns what's left
+    SeekTo(stream.Get(), data.size() - 5);
+    CheckRead(stream.Get(), data, data.size() - 5, 100);
+
+    // At and past the end there is nothing to read
+    CheckRead(stream.Get(), data, data.size(), 100);
+    SeekTo(stream.Get(), data.size() + PageSize);
+    CheckRead(stream.Get(), data, data.size() + PageSize, 100);
+
+    // A large read that runs into the end
+    SeekTo(stream.Get(), PageSize + 1);
+    CheckRead(stream.Get(), data, PageSize + 1, 4 * PageSize);
+}
+
+TEST_CASE("Internal_ReadAheadStream_Eviction", "[internal]")
+{
+    const std::size_t pages = MSIX::ReadAheadStream::MaxPages + 2;
+    auto data = MakeData(pages * PageSize + 123);
+    std::size_t reads = 0;
+    auto source = MSIX::ComPtr<IStream>::Make<CountingStream>(data, reads);
+    auto stream = MSIX::ComPtr<IStream>::Make<MSIX::ReadAheadStream>(source);
+
+    // None of these continue where the previous one stopped, so each one brings in a single page.
+    for (std::size_t page = 0; page < pages; page++)
+    {
+        SeekTo(stream.Get(), page * PageSize + 1);
+        CheckRead(stream.Get(), data, page * PageSize + 1, 1);
+    }
+    CHECK(reads == pages);
+    const auto loaded = reads;
+
+    // The most recently used pages are still there
+    SeekTo(stream.Get(), (pages - 1) * PageSize + 10);
+    CheckRead(stream.Get(), data, (pages - 1) * PageSize + 10, 100);
+    SeekTo(stream.Get(), 2 * PageSize + 10);
+    CheckRead(stream.Get(), data, 2 * PageSize + 10, 100);
+    CHECK(reads == loaded);
+
+    // The least recently used ones were dropped and come back with the right content
+    SeekTo(stream.Get(), 10);
+    CheckRead(stream.Get(), data, 10, 100);
+    CHECK(reads == loaded + 1);
+    SeekTo(stream.Get(), PageSize + 10);
+    CheckRead(stream.Get(), data, PageSize + 10, 100);
+    CHECK(reads == loaded + 2);
+
+    // Bringing those two back pushed out pages 3 and 4, page 2 was used more recently.
+    SeekTo(stream.Get(), 2 * PageSize + 20);
+    CheckRead(stream.Get(), data, 2 * PageSize + 20, 100);
+    CHECK(reads == loaded + 2);
+    SeekTo(stream.Get(), 3 * PageSize + 20);
+    CheckRead(stream.Get(), data, 3 * PageSize + 20, 100);
+    CHECK(reads == loaded + 3);
+}
+
+TEST_CASE("Internal_ReadAheadStream_PrefixDigest", "[internal]")
+{
+    const std::size_t pages = MSIX::ReadAheadStream::MaxPages + 4;
+    auto data = MakeData(pages * PageSize + 123);
+    const std::uint64_t length = data.size() - 1000;
+    std::vector<std::uint8_t> expected;
+    REQUIRE(MSIX::SHA256::ComputeHash(data.data(), static_cast<std::uint32_t>(length), expected));
+
+    SECTION("Read out of order")
+    {
+        std::size_t reads = 0;
+        auto source = MSIX::ComPtr<IStream>::Make<CountingStream>(data, reads);
+        auto stream = MSIX::ComPtr<IStream>::Make<MSIX::ReadAheadStream>(source);
+        auto readAhead = static_cast<MSIX::ReadAheadStream*>(stream.Get());
+
+        // Like the footprint files, the end gets read before the digest starts and is still cached then.
+        SeekTo(stream.Get(), (pages - 1) * PageSize);
+        CheckRead(stream.Get(), data, (pages - 1) * PageSize, PageSize - 1);
+        readAhead->StartPrefixDigest(length);
+
+        // Every page, the even ones first, in chunks of different sizes.
+        for (std::size_t start : { 0, 1 })
+        {
+            for (std::size_t page = start; page < pages - 1; page += 2)
+            {
+                SeekTo(stream.Get(), page * PageSize + 1);
+                CheckRead(stream.Get(), data, page * PageSize + 1, PageSize - 1);
+                SeekTo(stream.Get(), page * PageSize);
+                CheckRead(stream.Get(), data, page * PageSize, 1);
+            }
+        }
+        auto readsBeforeDigest = reads;
+        CHECK(readAhead->GetPrefixDigest() == expected);
+        // Everything went by already, there's nothing left to read.
+        CHECK(reads == readsBeforeDigest);
+    }
+
+    SECTION("Gaps")
+    {
+        std::size_t reads = 0;
+        auto source = MSIX::ComPtr<IStream>::Make<CountingStream>(data, reads);
+        auto stream = MSIX::ComPtr<IStream>::Make<MSIX::ReadAheadStream>(source);
+        auto readAhead = static_cast<MSIX::ReadAheadStream*>(stream.Get());
+        readAhead->StartPrefixDigest(length);
+
+        // Only every other page is read, the rest has to be read for the digest.
+        for (std::size_t page = 1; page < pages; page += 2)
+        {
+            SeekTo(stream.Get(), page * PageSize + 10);
+            CheckRead(stream.Get(), data, page * PageSize + 10, 100);
+        }
+        CHECK(readAhead->GetPrefixDigest() == expected);
+    }
+}
@@ -11,6 +11,8 @@
 #include "PackValidation.hpp"
 
 #include <iostream>
+#include <map>
+#include <vector>
 
 static std::string outputPackage = "package.msix";
 
@@ -101,3 +103,226 @@ TEST_CASE("Pack_InvalidParameters", "[pack]")
                     const_cast<char*>(outputPackage.c_str()),
                     nullptr));
 }
+
+// Packs with every compression level and with an invalid one
+TEST_CASE("Pack_CompressionOptions", "[pack]")
+{
+    auto testData = MsixTest::TestPath::GetInstance();
+    auto directoryPath = testData->GetPath(MsixTest::TestPath::Directory::Pack) + "/input";
+    directoryPath = MsixTest::Directory::PathAsCurrentPlatform(directoryPath);
+
+    // TestAppxPackage.exe compresses, and differently at each level. Gets how it was added to the package and the
+    // sizes of its blocks in the package.
+    const std::string fileName = "TestAppxPackage.exe";
+    const UINT64 fileSize = 186368;
+    auto getCompressedFile = [&fileName, fileSize](APPX_COMPRESSION_OPTION& compressionOption, std::vector<UINT32>& blockSizes)
+    {
+        auto outputStream = MsixTest::StreamFile(outputPackage, true);
+        MsixTest::ComPtr<IAppxPackageReader> packageReader;
+        MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
+        auto fileNameW = MsixTest::String::utf8_to_utf16(fileName);
+        MsixTest::ComPtr<IAppxFile> appxFile;
+        REQUIRE_SUCCEEDED(packageReader->GetPayloadFile(fileNameW.c_str(), &appxFile));
+        REQUIRE_SUCCEEDED(appxFile->GetCompressionOption(&compressionOption));
+        UINT64 size = 0;
+        REQUIRE_SUCCEEDED(appxFile->GetSize(&size));
+        REQUIRE(fileSize == size);
+
+        MsixTest::ComPtr<IAppxBlockMapReader> blockMapReader;
+        REQUIRE_SUCCEEDED(packageReader->GetBlockMap(&blockMapReader));
+        MsixTest::ComPtr<IAppxBlockMapFile> blockMapFile;
+        REQUIRE_SUCCEEDED(blockMapReader->GetFile(fileNameW.c_str(), &blockMapFile));
+        MsixTest::ComPtr<IAppxBlockMapBlocksEnumerator> blocks;
+        REQUIRE_SUCCEEDED(blockMapFile->GetBlocks(&blocks));
+        blockSizes.clear();
+        BOOL hasCurrent = FALSE;
+        REQUIRE_SUCCEEDED(blocks->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            MsixTest::ComPtr<IAppxBlockMapBlock> block;
+            REQUIRE_SUCCEEDED(blocks->GetCurrent(&block));
+            UINT32 blockSize = 0;
+            REQUIRE_SUCCEEDED(block->GetCompressedSize(&blockSize));
+            blockSizes.push_back(blockSize);
+            REQUIRE_SUCCEEDED(blocks->MoveNext(&hasCurrent));
+        }
+    };
+
+    std::map<APPX_COMPRESSION_OPTION, UINT64> compressedSizes;
+    for (auto compressionOption : { APPX_COMPRESSION_OPTION_NONE, APPX_COMPRESSION_OPTION_SUPERFAST,
+        APPX_COMPRESSION_OPTION_FAST, APPX_COMPRESSION_OPTION_NORMAL, APPX_COMPRESSION_OPTION_MAXIMUM })
+    {
+        REQUIRE_SUCCEEDED(PackPackageWithCompression(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+            MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+            compressionOption,
+            const_cast<char*>(directoryPath.c_str()),
+            const_cast<char*>(outputPackage.c_str())));
+
+        APPX_COMPRESSION_OPTION fileCompression;
+        std::vector<UINT32> blockSizes;
+        getCompressedFile(fileCompression, blockSizes);
+        REQUIRE(((fileSize + 65535) / 65536) == blockSizes.size());
+        if (compressionOption == APPX_COMPRESSION_OPTION_NONE)
+        {   // Stored as it is. The blocks of stored files have no size in the block map and report the file size.
+            CHECK(APPX_COMPRESSION_OPTION_NONE == fileCompression);
+            for (auto blockSize : blockSizes)
+            {   CHECK(fileSize == blockSize);
+            }
+        }
+        else
+        {   // The zip only records that the file is deflated, not how hard.
+            CHECK(APPX_COMPRESSION_OPTION_NORMAL == fileCompression);
+            for (auto blockSize : blockSizes)
+            {   compressedSizes[compressionOption] += blockSize;
+            }
+            CHECK(fileSize > compressedSizes[compressionOption]);
+        }
+
+        auto outputStream = MsixTest::StreamFile(outputPackage, true, true);
+        auto outputDir = testData->GetPath(MsixTest::TestPath::Directory::Output);
+        REQUIRE_SUCCEEDED(UnpackPackageFromStream(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+            MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+            outputStream.Get(),
+            const_cast<char*>(outputDir.c_str())));
+        CHECK(MsixTest::Directory::CleanDirectory(outputDir));
+    }
+    CHECK(compressedSizes[APPX_COMPRESSION_OPTION_SUPERFAST] > compressedSizes[APPX_COMPRESSION_OPTION_MAXIMUM]);
+    CHECK(compressedSizes[APPX_COMPRESSION_OPTION_SUPERFAST] >= compressedSizes[APPX_COMPRESSION_OPTION_NORMAL]);
+    CHECK(compressedSizes[APPX_COMPRESSION_OPTION_NORMAL] >= compressedSizes[APPX_COMPRESSION_OPTION_MAXIMUM]);
+
+    REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::InvalidParameter),
+        PackPackageWithCompression(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+            MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+            static_cast<APPX_COMPRESSION_OPTION>(5),
+            const_cast<char*>(directoryPath.c_str()),
+            const_cast<char*>(outputPackage.c_str())));
+}
+
+// Stores files that are compressed by their extension but whose content doesn't compress
+TEST_CASE("Pack_StoreIncompressibleFiles", "[pack]")
+{
+    auto testData = MsixTest::TestPath::GetInstance();
+    auto directoryPath = testData->GetPath(MsixTest::TestPath::Directory::Pack) + "/input_incompressible";
+    directoryPath = MsixTest::Directory::PathAsCurrentPlatform(directoryPath);
+
+    // Packed.asset is a package, which has an unknown extension and is already compressed.
+    auto getCompressionOption = [](const std::string& fileName)
+    {
+        auto outputStream = MsixTest::StreamFile(outputPackage, true);
+        MsixTest::ComPtr<IAppxPackageReader> packageReader;
+        MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
+        MsixTest::ComPtr<IAppxFile> appxFile;
+        auto fileNameW = MsixTest::String::utf8_to_utf16(fileName);
+        REQUIRE_SUCCEEDED(packageReader->GetPayloadFile(fileNameW.c_str(), &appxFile));
+        APPX_COMPRESSION_OPTION fileCompression;
+        REQUIRE_SUCCEEDED(appxFile->GetCompressionOption(&fileCompression));
+        return fileCompression;
+    };
+
+    REQUIRE_SUCCEEDED(PackPackage(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+        const_cast<char*>(directoryPath.c_str()),
+        const_cast<char*>(outputPackage.c_str())));
+    CHECK(APPX_COMPRESSION_OPTION_NORMAL == getCompressionOption("Packed.asset"));
+
+    REQUIRE_SUCCEEDED(PackPackage(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_STOREINCOMPRESSIBLEFILES,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+        const_cast<char*>(directoryPath.c_str()),
+        const_cast<char*>(outputPackage.c_str())));
+    CHECK(APPX_COMPRESSION_OPTION_NONE == getCompressionOption("Packed.asset"));
+    CHECK(APPX_COMPRESSION_OPTION_NORMAL == getCompressionOption("TestAppxPackage.exe"));
+
+    auto outputStream = MsixTest::StreamFile(outputPackage, true, true);
+    auto outputDir = testData->GetPath(MsixTest::TestPath::Directory::Output);
+    REQUIRE_SUCCEEDED(UnpackPackageFromStream(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+        outputStream.Get(),
+        const_cast<char*>(outputDir.c_str())));
+    CHECK(MsixTest::Directory::CleanDirectory(outputDir));
+}
+
+TEST_CASE("Pack_Repack", "[pack]")
+{
+    auto testData = MsixTest::TestPath::GetInstance();
+    auto packPath = testData->GetPath(MsixTest::TestPath::Directory::Pack);
+    auto inputPath = MsixTest::Directory::PathAsCurrentPlatform(packPath + "/input");
+    auto repackPath = MsixTest::Directory::PathAsCurrentPlatform(packPath + "/repack");
+    std::string repackedPackage = "repackaged.msix";
+
+    REQUIRE_SUCCEEDED(PackPackage(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+        const_cast<char*>(inputPath.c_str()),
+        const_cast<char*>(outputPackage.c_str())));
+
+    // Removing a file that isn't in the package fails
+    std::string missing = "Assets\\Missing.png";
+    char* missingFiles[] = { const_cast<char*>(missing.c_str()) };
+    REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::FileNotFound),
+        RepackPackage(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+        const_cast<char*>(outputPackage.c_str()),
+        const_cast<char*>(repackPath.c_str()),
+        1, missingFiles,
+        const_cast<char*>(repackedPackage.c_str())));
+
+    // The output can't be the source, however it is spelled
+    std::string sameAsSource = "./" + outputPackage;
+    REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::InvalidParameter),
+        RepackPackage(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+        const_cast<char*>(outputPackage.c_str()),
+        const_cast<char*>(repackPath.c_str()),
+        0, nullptr,
+        const_cast<char*>(sameAsSource.c_str())));
+
+    // Replaces the manifest with one of a new version, adds Added.txt and removes the store logo.
+    std::string removed = "Assets\\StoreLogo.png";
+    char* removedFiles[] = { const_cast<char*>(removed.c_str()) };
+    REQUIRE_SUCCEEDED(RepackPackage(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+        const_cast<char*>(outputPackage.c_str()),
+        const_cast<char*>(repackPath.c_str()),
+        1, removedFiles,
+        const_cast<char*>(repackedPackage.c_str())));
+    MsixTest::StreamFile(outputPackage, true, true);
+
+    {
+        auto repackedStream = MsixTest::StreamFile(repackedPackage, true);
+        MsixTest::ComPtr<IAppxPackageReader> packageReader;
+        MsixTest::InitializePackageReader(repackedStream.Get(), &packageReader);
+        auto getPayloadFile = [&](const std::string& fileName, IAppxFile** appxFile)
+        {
+            auto fileNameW = MsixTest::String::utf8_to_utf16(fileName);
+            return packageReader->GetPayloadFile(fileNameW.c_str(), appxFile);
+        };
+        MsixTest::ComPtr<IAppxFile> appxFile;
+        REQUIRE_FAILED(getPayloadFile(removed, &appxFile));
+        REQUIRE_SUCCEEDED(getPayloadFile("Added.txt", &appxFile));
+        REQUIRE_SUCCEEDED(getPayloadFile("TestAppxPackage.exe", &appxFile));
+        APPX_COMPRESSION_OPTION fileCompression;
+        REQUIRE_SUCCEEDED(appxFile->GetCompressionOption(&fileCompression));
+        CHECK(APPX_COMPRESSION_OPTION_NORMAL == fileCompression);
+
+        MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+        REQUIRE_SUCCEEDED(packageReader->GetManifest(&manifestReader));
+        MsixTest::ComPtr<IAppxManifestPackageId> packageId;
+        REQUIRE_SUCCEEDED(manifestReader->GetPackageId(&packageId));
+        UINT64 expectedVersion = 562949953421312; // 2.0.0.0
+        UINT64 packageVersion;
+        REQUIRE_SUCCEEDED(packageId->GetVersion(&packageVersion));
+        CHECK(expectedVersion == packageVersion);
+        std::string expectedFullName = "20477fca-282d-49fb-b03e-371dca074f0f_2.0.0.0_x86__8wekyb3d8bbwe";
+        MsixTest::Wrappers::Buffer<wchar_t> fullName;
+        REQUIRE_SUCCEEDED(packageId->GetPackageFullName(&fullName));
+        CHECK(expectedFullName == fullName.ToString());
+    }
+
+    // Unpacking checks the copied data against the hashes of the blockmap.
+    auto repackedStream = MsixTest::StreamFile(repackedPackage, true, true);
+    auto outputDir = testData->GetPath(MsixTest::TestPath::Directory::Output);
+    REQUIRE_SUCCEEDED(UnpackPackageFromStream(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+        repackedStream.Get(),
+        const_cast<char*>(outputDir.c_str())));
+    CHECK(MsixTest::Directory::CleanDirectory(outputDir));
+}
@@ -409,3 +409,18 @@ TEST_CASE("Unbundle_FlatBundleWithAsset_MissingPackage", "[unbundle][flat]")
 
     RunUnbundleTest(expected, bundle, validation, packUnpack, applicability, MsixTest::TestPath::Directory::BadFlat);
 }
+
+TEST_CASE("Verify_BundleWithIntlPackage", "[unbundle][verify]")
+{
+    auto bundlePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unbundle) + "/BundleWithIntlPackage.appxbundle";
+    bundlePath = MsixTest::Directory::PathAsCurrentPlatform(bundlePath);
+
+    MsixTest::Wrappers::Buffer<MSIX_VERIFICATION_FAILURE> failures;
+    UINT32 failureCount = 0;
+    HRESULT actual = VerifyBundle(MSIX_VALIDATION_OPTION_SKIPSIGNATURE, const_cast<char*>(bundlePath.c_str()),
+        0, MsixTest::Allocators::Allocate, &failures, &failureCount);
+
+    CHECK(S_OK == actual);
+    MsixTest::Log::PrintMsixLog(S_OK, actual);
+    CHECK(0 == failureCount);
+}
@@ -8,6 +8,9 @@
 #include "FileHelpers.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <iterator>
+#include <vector>
 
 void RunUnpackTest(HRESULT expected, const std::string& package, MSIX_VALIDATION_OPTION validation,
     MSIX_PACKUNPACK_OPTION packUnpack, bool clean = true, bool absolutePaths = false)
@@ -206,6 +209,55 @@ TEST_CASE("Unpack_SignedTamperedCD-TRUST_E_BAD_DIGEST", "[unpack]")
     RunUnpackTest(expected, package, validation, packUnpack);
 }
 
+TEST_CASE("Unpack_SignedTamperedCD-TRUST_E_BAD_DIGEST_sv", "[unpack]")
+{
+    HRESULT expected                  = static_cast<HRESULT>(MSIX::Error::SignatureInvalid);
+    std::string package               = "SignedTamperedCD-TRUST_E_BAD_DIGEST.appx";
+    MSIX_VALIDATION_OPTION validation = MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN;
+    MSIX_PACKUNPACK_OPTION packUnpack = MSIX_PACKUNPACK_OPTION_NONE;
+
+    RunUnpackTest(expected, package, validation, packUnpack);
+}
+
+// The file records digest (AXPC) covers the local file headers, which aren't part of any block of the blockmap.
+TEST_CASE("Unpack_SignedTamperedLocalFileHeader_sv", "[unpack]")
+{
+    auto testData = MsixTest::TestPath::GetInstance();
+    auto packagePath = testData->GetPath(MsixTest::TestPath::Directory::Unpack) + "/TestAppxPackage_x64.appx";
+    packagePath = MsixTest::Directory::PathAsCurrentPlatform(packagePath);
+    auto outputDir = testData->GetPath(MsixTest::TestPath::Directory::Output);
+    outputDir = MsixTest::Directory::PathAsCurrentPlatform(outputDir);
+    REQUIRE(MsixTest::Directory::MakeDirectory(outputDir));
+    std::string tamperedPath = outputDir + "/TamperedLocalFileHeader.appx";
+    std::string unpackDir = outputDir + "/TamperedLocalFileHeader";
+
+    // Change the last modification time in the local file header of the first file, nothing checks it.
+    std::ifstream source(packagePath, std::ios::binary);
+    std::vector<char> content((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+    REQUIRE(content.size() > 30);
+    REQUIRE(content[0] == 'P');
+    REQUIRE(content[1] == 'K');
+    content[10] = ~content[10];
+    {
+        std::ofstream tampered(tamperedPath, std::ios::binary);
+        tampered.write(content.data(), content.size());
+    }
+
+    HRESULT expected = static_cast<HRESULT>(MSIX::Error::SignatureInvalid);
+    HRESULT actual = UnpackPackage(MSIX_PACKUNPACK_OPTION_NONE, MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN,
+        const_cast<char*>(tamperedPath.c_str()), const_cast<char*>(unpackDir.c_str()));
+    CHECK(expected == actual);
+    MsixTest::Log::PrintMsixLog(expected, actual);
+
+    // Same package without the change
+    actual = UnpackPackage(MSIX_PACKUNPACK_OPTION_NONE, MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN,
+        const_cast<char*>(packagePath.c_str()), const_cast<char*>(unpackDir.c_str()));
+    CHECK(S_OK == actual);
+    MsixTest::Log::PrintMsixLog(S_OK, actual);
+
+    CHECK(MsixTest::Directory::CleanDirectory(outputDir));
+}
+
 TEST_CASE("Unpack_SignedUntrustedCert", "[unpack]")
 {
     HRESULT expected                  = static_cast<HRESULT>(MSIX::Error::CertNotTrusted);
@@ -216,6 +268,18 @@ TEST_CASE("Unpack_SignedUntrustedCert", "[unpack]")
     RunUnpackTest(expected, package, validation, packUnpack);
 }
 
+TEST_CASE("Unpack_SignedUntrustedCert_CachedChain", "[unpack]")
+{
+    HRESULT expected                  = static_cast<HRESULT>(MSIX::Error::CertNotTrusted);
+    std::string package               = "SignedUntrustedCert-CERT_E_CHAINING.appx";
+    MSIX_VALIDATION_OPTION validation = MSIX_VALIDATION_OPTION_CACHECERTIFICATECHAIN;
+    MSIX_PACKUNPACK_OPTION packUnpack = MSIX_PACKUNPACK_OPTION_NONE;
+
+    // Chains that fail are never cached, so it fails the same way every time.
+    RunUnpackTest(expected, package, validation, packUnpack);
+    RunUnpackTest(expected, package, validation, packUnpack);
+}
+
 TEST_CASE("Unpack_TestAppxPackage_Win32", "[unpack]")
 {
     HRESULT expected                  = S_OK;
@@ -373,3 +437,55 @@ TEST_CASE("Unpack_To_Absolute_Path", "[unpack]")
     // Clean directory
     CHECK(MsixTest::Directory::CleanDirectory(outputDir));
 }
+
+TEST_CASE("Verify_TestAppxPackage_x64", "[unpack][verify]")
+{
+    auto packagePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unpack) + "/TestAppxPackage_x64.appx";
+    packagePath = MsixTest::Directory::PathAsCurrentPlatform(packagePath);
+
+    MsixTest::Wrappers::Buffer<MSIX_VERIFICATION_FAILURE> failures;
+    UINT32 failureCount = 0;
+    HRESULT actual = VerifyPackage(MSIX_VALIDATION_OPTION_SKIPSIGNATURE, const_cast<char*>(packagePath.c_str()),
+        2, MsixTest::Allocators::Allocate, &failures, &failureCount);
+
+    CHECK(S_OK == actual);
+    MsixTest::Log::PrintMsixLog(S_OK, actual);
+    CHECK(0 == failureCount);
+    CHECK(nullptr == failures.Get());
+}
+
+TEST_CASE("Verify_TamperedPayloadBlock", "[unpack][verify]")
+{
+    auto testData = MsixTest::TestPath::GetInstance();
+    auto packagePath = testData->GetPath(MsixTest::TestPath::Directory::Unpack) + "/TestAppxPackage_x64.appx";
+    packagePath = MsixTest::Directory::PathAsCurrentPlatform(packagePath);
+    auto outputDir = testData->GetPath(MsixTest::TestPath::Directory::Output);
+    outputDir = MsixTest::Directory::PathAsCurrentPlatform(outputDir);
+    REQUIRE(MsixTest::Directory::MakeDirectory(outputDir));
+    std::string tamperedPath = outputDir + "/TamperedPayloadBlock.appx";
+
+    // Assets/LockScreenLogo.scale-200.png is the first file in the package and is stored, flip a byte of its data.
+    std::ifstream source(packagePath, std::ios::binary);
+    std::vector<char> content((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+    REQUIRE(content.size() > 200);
+    content[200] = ~content[200];
+    {
+        std::ofstream tampered(tamperedPath, std::ios::binary);
+        tampered.write(content.data(), content.size());
+    }
+
+    MsixTest::Wrappers::Buffer<MSIX_VERIFICATION_FAILURE> failures;
+    UINT32 failureCount = 0;
+    HRESULT actual = VerifyPackage(MSIX_VALIDATION_OPTION_SKIPSIGNATURE, const_cast<char*>(tamperedPath.c_str()),
+        0, MsixTest::Allocators::Allocate, &failures, &failureCount);
+
+    HRESULT expected = static_cast<HRESULT>(MSIX::Error::SignatureInvalid);
+    CHECK(expected == actual);
+    MsixTest::Log::PrintMsixLog(expected, actual);
+    REQUIRE(1 == failureCount);
+    CHECK(std::string("Assets/LockScreenLogo.scale-200.png") == failures.Get()[0].fileName);
+    CHECK(0 == failures.Get()[0].blockIndex);
+    CHECK(expected == failures.Get()[0].error);
+
+    CHECK(MsixTest::Directory::CleanDirectory(outputDir));
+}